@@ -0,0 +1,31 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout(location = 0) in vec3 in_position;
+
+layout(std430, binding = 1) readonly buffer Instances 
+{
+    mat4 model_matrices[];
+};
+
+// Must match CascadedShadowMap::MAX_CASCADES
+const int MAX_CASCADES = 4;
+
+uniform mat4 cascade_matrices[MAX_CASCADES];
+
+// The instances are sorted by cascade, this is where each cascade's instances end (the last
+// one ends with the draw)
+uniform int cascade_ends[MAX_CASCADES - 1];
+
+void main() {
+    int cascade = 0;
+    for (int i = 0; i < MAX_CASCADES - 1; i++)
+    {
+        cascade += int(gl_InstanceID >= cascade_ends[i]);
+    }
+
+    // Every cascade is a layer of the shadow map, so they are all drawn at once
+    gl_Layer = cascade;
+    vec4 world_position = model_matrices[gl_InstanceID] * vec4(in_position, 1.0);
+    gl_Position = cascade_matrices[cascade] * world_position;
+}
@@ -0,0 +1,275 @@
+#version 450 core
+
+flat in int pass_light_index;
+
+out vec4 out_colour;
+
+struct LightBase 
+{
+    vec3 colour;
+    float ambient_intensity;
+    float diffuse_intensity;
+    float specular_intensity;
+};
+
+struct Attenuation
+{
+    float constant;
+    float linear;
+    float exponant;
+};
+
+struct DirectionalLight 
+{
+    LightBase base;
+    vec3 direction;
+};
+
+struct PointLight 
+{
+    LightBase base;
+    Attenuation att;
+    vec3 position;
+};
+
+struct SpotLight 
+{
+    LightBase base;
+    Attenuation att;
+    vec3 direction;
+    vec3 position;
+
+    float cutoff;
+};
+
+// Matches ClusterLight in SceneFragment.glsl
+struct ClusterLight
+{
+    vec3 position;
+    float range;
+    vec3 colour;
+    float intensity;
+    vec3 direction;
+    float cutoff;
+};
+
+layout(std430, binding = 2) readonly buffer Lights 
+{
+    ClusterLight lights[];
+};
+
+layout(std140, binding = 0) uniform Camera 
+{
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    vec3 eye_position;
+};
+
+layout(binding = 0) uniform sampler2D gbuffer_albedo;
+layout(binding = 1) uniform sampler2D gbuffer_normal;
+layout(binding = 2) uniform sampler2D gbuffer_depth;
+
+uniform DirectionalLight dir_light;
+uniform PointLight point_light;
+uniform SpotLight spot_light;
+uniform float shininess;
+
+// 0 for the lights covering the whole screen, otherwise a light volume
+uniform int volume_type;
+
+// Turns window coordinates and depth back into world space
+uniform mat4 inverse_view_projection;
+uniform vec2 viewport_size;
+
+// The shadow maps and their uniforms match SceneFragment.glsl
+layout(binding = 9) uniform sampler2DShadow spot_shadow_map;
+layout(binding = 10) uniform sampler2DShadow point_shadow_map;
+uniform mat4 spot_shadow_matrix;
+uniform mat4 point_shadow_matrices[6];
+uniform float spot_shadow_offset;
+uniform float point_shadow_offset;
+uniform bool spot_shadow;
+uniform int shadow_light;
+
+const int MAX_CASCADES = 4;
+layout(binding = 8) uniform sampler2DArrayShadow cascade_shadow_map;
+uniform mat4 cascade_matrices[MAX_CASCADES];
+uniform float cascade_splits[MAX_CASCADES];
+uniform float cascade_offsets[MAX_CASCADES];
+uniform int cascade_count;
+
+// Read from the G-buffer, used in place of the scene shader's inputs
+vec3 fragment_position;
+float specular_map;
+
+vec3 decode_normal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
+
+// The lighting below matches SceneFragment.glsl, so both paths light the scene the same
+
+vec3 calculate_base_lighting(LightBase light, vec3 normal, vec3 light_direction, vec3 eye_direction)
+{
+    vec3 ambient_light = light.colour * light.ambient_intensity;
+
+    float diff = max(dot(normal, light_direction), 0.0);
+    vec3 diffuse = light.colour * light.diffuse_intensity * diff;
+
+    vec3 reflect_direction  = reflect(-light_direction, normal);
+    float spec              = pow(max(dot(eye_direction, reflect_direction), 0.0), shininess);
+    vec3 specular           = light.specular_intensity * spec * vec3(specular_map);
+
+    return ambient_light + diffuse + specular;
+}
+
+float calculate_attenuation(Attenuation attenuation, vec3 light_position)
+{
+    float distance = length(light_position - fragment_position);
+    return 1.0 /  (
+        attenuation.constant + 
+        attenuation.linear * distance + 
+        attenuation.exponant * (distance * distance)
+    );
+}
+
+vec3 calculate_directional_light(DirectionalLight light, vec3 normal, vec3 eye_direction)
+{
+    return calculate_base_lighting(light.base, normalize(-light.direction), normal, eye_direction);
+}
+
+vec3 calculate_point_light(PointLight light, vec3 normal, vec3 eye_direction) 
+{
+    vec3 light_result = calculate_base_lighting(light.base, normalize(light.position - fragment_position), normal, eye_direction);
+    float attenuation = calculate_attenuation(light.att, light.position);
+
+    return light_result * attenuation;
+}
+
+vec3 calculate_cluster_light(ClusterLight light, vec3 normal, vec3 eye_direction)
+{
+    PointLight point = point_light;
+    point.position = light.position;
+    point.base.colour *= light.colour * light.intensity;
+    vec3 light_result = calculate_point_light(point, normal, eye_direction);
+
+    float distance = length(light.position - fragment_position) / light.range;
+    float fade = clamp(1.0 - distance * distance * distance * distance, 0.0, 1.0);
+    light_result *= fade * fade;
+
+    if (light.cutoff > -1.0)
+    {
+        vec3 light_direction = normalize(light.position - fragment_position);
+        float oco = cos(acos(light.cutoff) + radians(6));
+        float theta = dot(light_direction, -light.direction);
+        light_result *= clamp((theta - oco) / (light.cutoff - oco), 0.0, 1.0);
+    }
+    return light_result;
+}
+
+vec3 calculate_spot_light(SpotLight light, vec3 normal, vec3 eye_direction) 
+{
+    vec3 light_direction = normalize(light.position - fragment_position);
+    vec3 light_result = calculate_base_lighting(light.base, light_direction, normal, eye_direction);
+
+    float attenuation = calculate_attenuation(light.att, light.position);
+
+    float oco = cos(acos(light.cutoff) + radians(6));
+    float theta = dot(light_direction, -light.direction);
+    float epsilon = light.cutoff - oco;
+    float intensity = clamp((theta - oco) / epsilon, 0.0, 1.0);
+    
+    return light_result * intensity * attenuation;
+}
+
+float sample_shadow(sampler2DShadow shadow_map, mat4 shadow_matrix, vec3 position)
+{
+    vec4 coord = shadow_matrix * vec4(position, 1.0);
+    coord.xyz /= coord.w;
+    return texture(shadow_map, vec3(coord.xy, min(coord.z, 1.0)));
+}
+
+float calculate_spot_shadow(vec3 normal)
+{
+    if (!spot_shadow)
+    {
+        return 1.0;
+    }
+    float distance = length(spot_light.position - fragment_position);
+    vec3 position = fragment_position + normal * distance * spot_shadow_offset;
+    return sample_shadow(spot_shadow_map, spot_shadow_matrix, position);
+}
+
+float calculate_point_shadow(vec3 light_position, vec3 normal)
+{
+    vec3 to_fragment = fragment_position - light_position;
+    vec3 axis = abs(to_fragment);
+    int face = axis.x >= axis.y && axis.x >= axis.z ? (to_fragment.x > 0.0 ? 0 : 1)
+             : axis.y >= axis.z                     ? (to_fragment.y > 0.0 ? 2 : 3)
+                                                    : (to_fragment.z > 0.0 ? 4 : 5);
+
+    vec3 position = fragment_position + normal * length(to_fragment) * point_shadow_offset;
+    return sample_shadow(point_shadow_map, point_shadow_matrices[face], position);
+}
+
+float calculate_directional_shadow(vec3 normal)
+{
+    float depth = -(view_matrix * vec4(fragment_position, 1.0)).z;
+    for (int cascade = 0; cascade < cascade_count; cascade++)
+    {
+        if (depth < cascade_splits[cascade])
+        {
+            vec3 position = fragment_position + normal * cascade_offsets[cascade];
+            vec4 coord = cascade_matrices[cascade] * vec4(position, 1.0);
+            return texture(cascade_shadow_map, vec4(coord.xy, cascade, min(coord.z, 1.0)));
+        }
+    }
+    return 1.0;
+}
+
+void main()
+{
+    // Nothing was drawn here
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+    if (depth == 1.0)
+    {
+        discard;
+    }
+
+    vec4 clip_position = vec4(gl_FragCoord.xy / viewport_size, depth, 1.0) * 2.0 - 1.0;
+    vec4 world_position = inverse_view_projection * clip_position;
+    fragment_position = world_position.xyz / world_position.w;
+
+    vec4 albedo = texelFetch(gbuffer_albedo, pixel, 0);
+    specular_map = albedo.a;
+
+    vec3 normal = decode_normal(texelFetch(gbuffer_normal, pixel, 0).rg);
+    vec3 eye_direction = normalize(eye_position - fragment_position); 
+
+    vec3 total_light = vec3(0, 0, 0);
+    if (volume_type == 0)
+    {
+        vec3 ambient = dir_light.base.colour * dir_light.base.ambient_intensity;
+        vec3 directional = calculate_directional_light(dir_light, normal, eye_direction);
+        total_light += ambient + (directional - ambient) * calculate_directional_shadow(normal);
+        total_light += calculate_spot_light(spot_light, normal, eye_direction) * calculate_spot_shadow(normal);
+    }
+    else
+    {
+        ClusterLight light = lights[pass_light_index];
+        total_light += calculate_cluster_light(light, normal, eye_direction);
+        if (pass_light_index == shadow_light)
+        {
+            total_light *= calculate_point_shadow(light.position, normal);
+        }
+    }
+
+    // Each light is blended on additively, the target clamps the sum like the forward path
+    out_colour = vec4(albedo.rgb * total_light, 1.0);
+}
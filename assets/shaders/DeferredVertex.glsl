@@ -0,0 +1,68 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+
+flat out int pass_light_index;
+
+layout(std140, binding = 0) uniform Camera 
+{
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    vec3 eye_position;
+};
+
+// Matches ClusterLight in SceneFragment.glsl
+struct ClusterLight
+{
+    vec3 position;
+    float range;
+    vec3 colour;
+    float intensity;
+    vec3 direction;
+    float cutoff;
+};
+
+layout(std430, binding = 2) readonly buffer Lights 
+{
+    ClusterLight lights[];
+};
+
+// 0 for a triangle covering the screen, 1 for point light spheres and 2 for spot light cones
+uniform int volume_type;
+
+// The light of instance 0, the instance ID is added to it
+uniform int first_light;
+
+void main()
+{
+    if (volume_type == 0)
+    {
+        vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+        pass_light_index = 0;
+        return;
+    }
+
+    pass_light_index = first_light + gl_InstanceID;
+    ClusterLight light = lights[pass_light_index];
+
+    vec3 world_position;
+    if (volume_type == 1)
+    {
+        world_position = light.position + in_position * light.range;
+    }
+    else
+    {
+        // Stretch the cone to the range and to the soft edge past the cutoff. Cones wider than
+        // 80 degrees are clamped, as the base would reach out to infinity
+        float angle = min(acos(light.cutoff) + radians(6), radians(80));
+        float radius = light.range * tan(angle);
+
+        vec3 axis = light.direction;
+        vec3 side = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+        vec3 up = cross(axis, side);
+        world_position = light.position + side * in_position.x * radius +
+                         up * in_position.y * radius + axis * in_position.z * light.range;
+    }
+    gl_Position = projection_matrix * view_matrix * vec4(world_position, 1.0);
+}
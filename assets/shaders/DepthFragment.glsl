@@ -0,0 +1,5 @@
+#version 450 core
+
+// Depth only, nothing is written to the colour attachments
+void main() {
+}
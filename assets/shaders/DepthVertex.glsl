@@ -0,0 +1,25 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+
+// Must match SceneVertex.glsl exactly, the scene pass tests its depths against these with
+// GL_EQUAL
+invariant gl_Position;
+
+layout(std140, binding = 0) uniform Camera 
+{
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    vec3 eye_position;
+};
+
+layout(std430, binding = 1) readonly buffer Instances 
+{
+    mat4 model_matrices[];
+};
+
+void main() {
+    mat4 model_matrix = model_matrices[gl_InstanceID];
+    vec4 world_position = model_matrix * vec4(in_position, 1.0);
+    gl_Position = projection_matrix * view_matrix * world_position;
+}
@@ -0,0 +1,61 @@
+#version 450 core
+
+in vec2 pass_texture_coord;
+in vec3 pass_normal;
+in vec3 pass_fragment_coord;
+
+// Albedo in rgb and the specular map in a
+layout(location = 0) out vec4 out_albedo;
+
+// Octahedral encoded normal
+layout(location = 1) out vec2 out_normal;
+
+// A layer of one of the material texture arrays, see TextureArrays.h
+struct TextureLayer
+{
+    int array;
+    int layer;
+};
+
+// The diffuse map has the specular map in its alpha, see TextureLoader::add_packed
+struct Material 
+{
+    TextureLayer diffuse;
+    float shininess;
+};
+
+// Must match TextureArrays::MAX_ARRAYS. The array is picked per draw, so the index is
+// dynamically uniform
+layout(binding = 0) uniform sampler2DArray material_textures[8];
+
+vec4 sample_material(TextureLayer texture_layer)
+{
+    return texture(material_textures[texture_layer.array],
+                   vec3(pass_texture_coord, texture_layer.layer));
+}
+
+uniform Material material;
+
+/**
+    Folds the normal onto an octahedron and flattens it into a square, so it fits in two
+    channels with the precision spread evenly over every direction
+
+    @param normal A normalized direction
+
+    @return The encoded normal (between 0 and 1)
+*/
+vec2 encode_normal(vec3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 folded = normal.z >= 0.0 
+        ? normal.xy 
+        : (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    return folded * 0.5 + 0.5;
+}
+
+void main()
+{
+    // Already laid out the way the G-buffer is
+    out_albedo = sample_material(material.diffuse);
+    out_normal = encode_normal(normalize(pass_normal));
+}
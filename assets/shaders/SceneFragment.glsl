@@ -6,13 +6,30 @@ in vec3 pass_fragment_coord;
 
 out vec4 out_colour;
 
+// A layer of one of the material texture arrays, see TextureArrays.h
+struct TextureLayer
+{
+    int array;
+    int layer;
+};
+
+// The diffuse map has the specular map in its alpha, see TextureLoader::add_packed
 struct Material 
 {
-    sampler2D diffuse0;
-    sampler2D specular0;
+    TextureLayer diffuse;
     float shininess;
 };
 
+// Must match TextureArrays::MAX_ARRAYS. The array is picked per draw, so the index is
+// dynamically uniform
+layout(binding = 0) uniform sampler2DArray material_textures[8];
+
+vec4 sample_material(TextureLayer texture_layer)
+{
+    return texture(material_textures[texture_layer.array],
+                   vec3(pass_texture_coord, texture_layer.layer));
+}
+
 struct LightBase 
 {
     vec3 colour;
@@ -51,13 +68,92 @@ struct SpotLight
     float cutoff;
 };
 
+// A point or spot light found by the clustered light culling, everything but the position,
+// colour, intensity and cone comes from point_light
+struct ClusterLight
+{
+    vec3 position;
+    float range;
+    vec3 colour;
+    float intensity;
+    vec3 direction;
+    float cutoff;
+};
+
+layout(std430, binding = 2) readonly buffer Lights 
+{
+    ClusterLight lights[];
+};
+
+// Offset into light_indices and number of lights for every cluster
+layout(std430, binding = 3) readonly buffer Clusters 
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 4) readonly buffer LightIndices 
+{
+    uint light_indices[];
+};
+
+// Must match LightClusters::GRID_X/Y/Z
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+
 uniform Material material;
+
+// Read from the alpha of the material's texture once, for every light to use
+float specular_map;
+
 uniform DirectionalLight dir_light;
 uniform PointLight point_light;
 uniform SpotLight spot_light;
 
+// The depth slice of a fragment is log(view depth) * x + y
+uniform vec2 cluster_depth_scale_bias;
+
+// Size of the area being rendered to, in pixels
+uniform vec2 cluster_viewport_size;
+
+layout(std140, binding = 0) uniform Camera 
+{
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    vec3 eye_position;
+};
+
 uniform bool is_light;
-uniform vec3 eye_position;
+
+// Shadow maps of the flashlight and of one point light, sampled with 2x2 PCF
+layout(binding = 9) uniform sampler2DShadow spot_shadow_map;
+layout(binding = 10) uniform sampler2DShadow point_shadow_map;
+
+// World space to the map, and for the point light each cube face to its tile of the map
+uniform mat4 spot_shadow_matrix;
+uniform mat4 point_shadow_matrices[6];
+
+// How far to push the position along the normal before sampling per unit of distance from the
+// light, about the size of a texel so surfaces do not shadow themselves
+uniform float spot_shadow_offset;
+uniform float point_shadow_offset;
+
+uniform bool spot_shadow;
+
+// Index of the light in lights with the point shadow map, -1 for none
+uniform int shadow_light;
+
+// Must match CascadedShadowMap::MAX_CASCADES
+const int MAX_CASCADES = 4;
+
+// The directional light's cascaded shadow map, one layer per cascade
+layout(binding = 8) uniform sampler2DArrayShadow cascade_shadow_map;
+uniform mat4 cascade_matrices[MAX_CASCADES];
+
+// The view depth each cascade ends at, and the normal offset of its texel size
+uniform float cascade_splits[MAX_CASCADES];
+uniform float cascade_offsets[MAX_CASCADES];
+
+// 0 when the directional light casts no shadows
+uniform int cascade_count;
 
 /**
     Calculates the base lighting 
@@ -80,7 +176,7 @@ vec3 calculate_base_lighting(LightBase light, vec3 normal, vec3 light_direction,
     // Specular lighting
     vec3 reflect_direction  = reflect(-light_direction, normal);
     float spec              = pow(max(dot(eye_direction, reflect_direction), 0.0), material.shininess);
-    vec3 specular           = light.specular_intensity * spec * vec3(texture(material.specular0, pass_texture_coord));
+    vec3 specular           = light.specular_intensity * spec * vec3(specular_map);
 
     return ambient_light + diffuse + specular;
 }
@@ -117,6 +213,93 @@ vec3 calculate_point_light(PointLight light, vec3 normal, vec3 eye_direction)
     return light_result * attenuation;
 }
 
+vec3 calculate_cluster_light(ClusterLight light, vec3 normal, vec3 eye_direction)
+{
+    PointLight point = point_light;
+    point.position = light.position;
+    point.base.colour *= light.colour * light.intensity;
+    vec3 light_result = calculate_point_light(point, normal, eye_direction);
+
+    // Fade smoothly to nothing at the range, so the light can be culled from clusters past it
+    float distance = length(light.position - pass_fragment_coord) / light.range;
+    float fade = clamp(1.0 - distance * distance * distance * distance, 0.0, 1.0);
+    light_result *= fade * fade;
+
+    // Spot lights get the same soft edged cone as the flashlight
+    if (light.cutoff > -1.0)
+    {
+        vec3 light_direction = normalize(light.position - pass_fragment_coord);
+        float oco = cos(acos(light.cutoff) + radians(6));
+        float theta = dot(light_direction, -light.direction);
+        light_result *= clamp((theta - oco) / (light.cutoff - oco), 0.0, 1.0);
+    }
+    return light_result;
+}
+
+float sample_shadow(sampler2DShadow shadow_map, mat4 shadow_matrix, vec3 position)
+{
+    vec4 coord = shadow_matrix * vec4(position, 1.0);
+    coord.xyz /= coord.w;
+
+    // Past the far plane is past the light's range, so is left lit
+    return texture(shadow_map, vec3(coord.xy, min(coord.z, 1.0)));
+}
+
+float calculate_spot_shadow(vec3 normal)
+{
+    if (!spot_shadow)
+    {
+        return 1.0;
+    }
+    float distance = length(spot_light.position - pass_fragment_coord);
+    vec3 position = pass_fragment_coord + normal * distance * spot_shadow_offset;
+    return sample_shadow(spot_shadow_map, spot_shadow_matrix, position);
+}
+
+float calculate_point_shadow(vec3 light_position, vec3 normal)
+{
+    // The cube face is the one facing along the largest axis from the light
+    vec3 to_fragment = pass_fragment_coord - light_position;
+    vec3 axis = abs(to_fragment);
+    int face = axis.x >= axis.y && axis.x >= axis.z ? (to_fragment.x > 0.0 ? 0 : 1)
+             : axis.y >= axis.z                     ? (to_fragment.y > 0.0 ? 2 : 3)
+                                                    : (to_fragment.z > 0.0 ? 4 : 5);
+
+    vec3 position = pass_fragment_coord + normal * length(to_fragment) * point_shadow_offset;
+    return sample_shadow(point_shadow_map, point_shadow_matrices[face], position);
+}
+
+float calculate_directional_shadow(vec3 normal)
+{
+    // The first cascade that reaches the fragment has the most texels over it
+    float depth = -(view_matrix * vec4(pass_fragment_coord, 1.0)).z;
+    for (int cascade = 0; cascade < cascade_count; cascade++)
+    {
+        if (depth < cascade_splits[cascade])
+        {
+            vec3 position = pass_fragment_coord + normal * cascade_offsets[cascade];
+            vec4 coord = cascade_matrices[cascade] * vec4(position, 1.0);
+            return texture(cascade_shadow_map, vec4(coord.xy, cascade, min(coord.z, 1.0)));
+        }
+    }
+
+    // Past the shadow distance
+    return 1.0;
+}
+
+/**
+    Finds the cluster the fragment is in, from its position on screen and its view depth
+*/
+uint find_cluster()
+{
+    float depth = -(view_matrix * vec4(pass_fragment_coord, 1.0)).z;
+    float slice = log(max(depth, 1e-4)) * cluster_depth_scale_bias.x + cluster_depth_scale_bias.y;
+    vec2 tile = gl_FragCoord.xy / cluster_viewport_size * vec2(CLUSTER_GRID.xy);
+
+    uvec3 cluster = uvec3(clamp(vec3(tile, slice), vec3(0), vec3(CLUSTER_GRID - 1)));
+    return (cluster.z * CLUSTER_GRID.y + cluster.y) * CLUSTER_GRID.x + cluster.x;
+}
+
 vec3 calculate_spot_light(SpotLight light, vec3 normal, vec3 eye_direction) 
 {
     
@@ -140,7 +323,9 @@ vec3 calculate_spot_light(SpotLight light, vec3 normal, vec3 eye_direction)
 
 void main()
 {
-    out_colour = texture(material.diffuse0, pass_texture_coord);
+    vec4 texel = sample_material(material.diffuse);
+    out_colour = vec4(texel.rgb, 1.0);
+    specular_map = texel.a;
     if (is_light)
     {
         out_colour *= 2.0f;
@@ -150,9 +335,25 @@ void main()
     vec3 eye_direction = normalize(eye_position - pass_fragment_coord); 
 
     vec3 total_light = vec3(0, 0, 0);
-    total_light += calculate_directional_light(dir_light, normal, eye_direction);
-    total_light += calculate_point_light(point_light, normal, eye_direction);
-    total_light += calculate_spot_light(spot_light, normal, eye_direction);
+
+    // The shadow only takes away the direct light, not the ambient
+    vec3 ambient = dir_light.base.colour * dir_light.base.ambient_intensity;
+    vec3 directional = calculate_directional_light(dir_light, normal, eye_direction);
+    total_light += ambient + (directional - ambient) * calculate_directional_shadow(normal);
+
+    uvec2 cluster = clusters[find_cluster()];
+    for (uint i = cluster.x; i < cluster.x + cluster.y; i++)
+    {
+        uint light_index = light_indices[i];
+        ClusterLight light = lights[light_index];
+        vec3 light_result = calculate_cluster_light(light, normal, eye_direction);
+        if (int(light_index) == shadow_light)
+        {
+            light_result *= calculate_point_shadow(light.position, normal);
+        }
+        total_light += light_result;
+    }
+    total_light += calculate_spot_light(spot_light, normal, eye_direction) * calculate_spot_shadow(normal);
 
     out_colour *= vec4(total_light, 1.0);
 
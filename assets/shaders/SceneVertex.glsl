@@ -9,16 +9,45 @@ out vec2 pass_texture_coord;
 out vec3 pass_normal;
 out vec3 pass_fragment_coord;
 
-uniform mat4 projection_matrix;
-uniform mat4 view_matrix;
-uniform mat4 model_matrix;
+// Must match DepthVertex.glsl exactly, so the depth pre-pass writes the same depths this pass
+// tests against with GL_EQUAL
+invariant gl_Position;
+
+// Per-frame data, streamed in by the StreamBuffer
+layout(std140, binding = 0) uniform Camera 
+{
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    vec3 eye_position;
+};
+
+// Model matrix of every instance of the current draw
+layout(std430, binding = 1) readonly buffer Instances 
+{
+    mat4 model_matrices[];
+};
+
+// The atlas rectangle of each billboard, offset in xy and size in zw, see SpriteAtlas.h
+layout(std430, binding = 5) readonly buffer Sprites 
+{
+    vec4 sprite_rects[];
+};
+
+// Only set for the billboards, every other draw uses its texture coordinates as they are
+uniform bool sprites;
 
 
 void main() {
+    mat4 model_matrix = model_matrices[gl_InstanceID];
     vec4 world_position = model_matrix * vec4(in_position, 1.0);
     gl_Position = projection_matrix * view_matrix * world_position;
 
     pass_texture_coord = in_texture_coord;
+    if (sprites)
+    {
+        vec4 rect = sprite_rects[gl_InstanceID];
+        pass_texture_coord = rect.xy + in_texture_coord * rect.zw;
+    }
     pass_normal = mat3(transpose(inverse(model_matrix))) * in_normal;
     pass_fragment_coord = vec3(world_position);
 }
\ No newline at end of file
@@ -5,8 +5,14 @@ out vec4 out_colour;
 
 uniform sampler2D texture_Colour;
 
+// The scene only covers part of the texture when the render scale is below the maximum, the
+// bilinear filter upscales it to the window. Sampling is clamped half a texel inside the
+// rendered area so the edges never blend in texels from outside of it
+uniform vec2 uv_scale;
+uniform vec2 uv_max;
+
 void main() {
-    out_colour = texture(texture_Colour, pass_texture_coord);
+    out_colour = texture(texture_Colour, min(pass_texture_coord * uv_scale, uv_max));
     //out_colour.r = 1.0;
    // float depth = texture(colourTexture, passTexCoord).r;
     //depth = 1.0 - (1.0 - depth) * 50.0;
@@ -0,0 +1,360 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <string_view>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    /// The pack that is open, which stays mapped until the program ends
+    struct MappedPack
+    {
+        const std::uint8_t* data = nullptr;
+        std::size_t size = 0;
+
+        const AssetPackHeader* header = nullptr;
+        const AssetPackEntry* entries = nullptr;
+        const std::uint32_t* slots = nullptr;
+        const char* names = nullptr;
+    } pack;
+
+    std::uint64_t align(std::uint64_t offset)
+    {
+        return (offset + AssetPackHeader::ALIGNMENT - 1) / AssetPackHeader::ALIGNMENT *
+               AssetPackHeader::ALIGNMENT;
+    }
+
+    /// eg "./assets\\textures/crate.png" is packed as "assets/textures/crate.png"
+    std::string pack_name(const fs::path& path)
+    {
+        return path.lexically_normal().generic_string();
+    }
+
+    /// FNV-1a
+    std::uint64_t hash_name(std::string_view name)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325;
+        for (auto c : name)
+        {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 0x100000001B3;
+        }
+        return hash;
+    }
+
+    const std::uint8_t* map_file(const fs::path& path, std::size_t& size)
+    {
+#if defined(_WIN32)
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return nullptr;
+        }
+        LARGE_INTEGER file_size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+        {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        CloseHandle(file);
+        if (!mapping)
+        {
+            return nullptr;
+        }
+
+        // The view keeps the mapping open
+        auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        size = static_cast<std::size_t>(file_size.QuadPart);
+        return static_cast<const std::uint8_t*>(data);
+#else
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            return nullptr;
+        }
+        struct stat info;
+        void* data = MAP_FAILED;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            size = static_cast<std::size_t>(info.st_size);
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        }
+        close(file);
+        if (data == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        // Starts reading the whole pack in now, in long sequential reads, rather than a page at
+        // a time as each file is first touched
+        posix_madvise(data, size, POSIX_MADV_WILLNEED);
+        return static_cast<const std::uint8_t*>(data);
+#endif
+    }
+
+    /// Every offset and size is checked once here, so lookups can trust them
+    bool is_valid(const MappedPack& mapped)
+    {
+        if (mapped.size < sizeof(AssetPackHeader))
+        {
+            return false;
+        }
+        auto& header = *mapped.header;
+        if (header.magic != AssetPackHeader::MAGIC || header.version != AssetPackHeader::VERSION ||
+            !std::has_single_bit(header.slot_count) || header.slot_count <= header.file_count)
+        {
+            return false;
+        }
+
+        auto names_offset = sizeof(AssetPackHeader) +
+                            std::uint64_t{header.file_count} * sizeof(AssetPackEntry) +
+                            std::uint64_t{header.slot_count} * sizeof(std::uint32_t);
+        if (names_offset > mapped.size)
+        {
+            return false;
+        }
+        auto names_size = mapped.size - names_offset;
+        for (std::uint32_t i = 0; i < header.file_count; i++)
+        {
+            auto& entry = mapped.entries[i];
+            if (entry.offset > mapped.size || entry.size > mapped.size - entry.offset ||
+                std::uint64_t{entry.name_offset} + entry.name_size > names_size)
+            {
+                return false;
+            }
+        }
+        for (std::uint32_t i = 0; i < header.slot_count; i++)
+        {
+            if (mapped.slots[i] != AssetPackHeader::EMPTY_SLOT &&
+                mapped.slots[i] >= header.file_count)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const AssetPackEntry* find_entry(const fs::path& path)
+    {
+        if (!pack.data)
+        {
+            return nullptr;
+        }
+
+        // Linear probing, the table always has empty slots to stop at
+        auto name = pack_name(path);
+        auto hash = hash_name(name);
+        auto mask = pack.header->slot_count - 1;
+        for (auto slot = static_cast<std::uint32_t>(hash) & mask;; slot = (slot + 1) & mask)
+        {
+            auto index = pack.slots[slot];
+            if (index == AssetPackHeader::EMPTY_SLOT)
+            {
+                return nullptr;
+            }
+            auto& entry = pack.entries[index];
+            if (entry.hash == hash &&
+                name == std::string_view(pack.names + entry.name_offset, entry.name_size))
+            {
+                return &entry;
+            }
+        }
+    }
+} // namespace
+
+namespace AssetPack
+{
+    bool open(const fs::path& path)
+    {
+        MappedPack mapped;
+        mapped.data = map_file(path, mapped.size);
+        if (!mapped.data)
+        {
+            std::cerr << "Failed to map asset pack " << path << '\n';
+            return false;
+        }
+
+        mapped.header = reinterpret_cast<const AssetPackHeader*>(mapped.data);
+        mapped.entries =
+            reinterpret_cast<const AssetPackEntry*>(mapped.data + sizeof(AssetPackHeader));
+        if (mapped.size >= sizeof(AssetPackHeader))
+        {
+            mapped.slots =
+                reinterpret_cast<const std::uint32_t*>(mapped.entries + mapped.header->file_count);
+            mapped.names = reinterpret_cast<const char*>(mapped.slots + mapped.header->slot_count);
+        }
+        if (!is_valid(mapped))
+        {
+            std::cerr << "The asset pack " << path << " is invalid or from another version\n";
+            return false;
+        }
+
+        pack = mapped;
+        std::cout << "Mapped " << pack.header->file_count << " assets from " << path << '\n';
+        return true;
+    }
+
+    std::optional<std::span<const std::uint8_t>> find(const fs::path& path)
+    {
+        if (auto entry = find_entry(path))
+        {
+            return std::span{pack.data + entry->offset, static_cast<std::size_t>(entry->size)};
+        }
+        return {};
+    }
+
+    fs::file_time_type last_write_time(const fs::path& path, std::error_code& error)
+    {
+        if (auto entry = find_entry(path))
+        {
+            error.clear();
+            return fs::file_time_type{fs::file_time_type::duration{entry->write_time}};
+        }
+        return fs::last_write_time(path, error);
+    }
+
+    bool write(const fs::path& path, const std::vector<fs::path>& directories)
+    {
+        // Adding or removing a file only changes the time of its directory, so the directories
+        // are compared too
+        std::error_code error;
+        auto pack_time = fs::last_write_time(path, error);
+        bool up_to_date = !error;
+
+        std::vector<std::string> names;
+        for (auto& directory : directories)
+        {
+            // eg the model, which is not in the repo
+            if (!fs::exists(directory, error))
+            {
+                std::cout << "Skipping " << directory << ", it does not exist\n";
+                continue;
+            }
+            up_to_date = up_to_date && fs::last_write_time(directory, error) <= pack_time;
+            for (fs::recursive_directory_iterator it(directory, error), end;
+                 !error && it != end; it.increment(error))
+            {
+                up_to_date = up_to_date && it->last_write_time(error) <= pack_time;
+                if (it->is_regular_file(error))
+                {
+                    names.push_back(pack_name(it->path()));
+                }
+            }
+            if (error)
+            {
+                std::cerr << "Failed to read asset directory " << directory << ": "
+                          << error.message() << '\n';
+                return false;
+            }
+        }
+        if (up_to_date)
+        {
+            std::cout << path << " is up to date\n";
+            return true;
+        }
+
+        // The names are sorted so a directory's files are next to each other in the pack
+        std::ranges::sort(names);
+        auto duplicates = std::ranges::unique(names);
+        names.erase(duplicates.begin(), duplicates.end());
+
+        AssetPackHeader header;
+        header.file_count = static_cast<std::uint32_t>(names.size());
+        header.slot_count = std::bit_ceil(std::max(header.file_count * 2, 1u));
+
+        std::vector<AssetPackEntry> entries(names.size());
+        std::vector<std::uint32_t> slots(header.slot_count, AssetPackHeader::EMPTY_SLOT);
+        std::string name_data;
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            auto& entry = entries[i];
+            entry.hash = hash_name(names[i]);
+            entry.size = fs::file_size(names[i], error);
+            entry.write_time = fs::last_write_time(names[i], error).time_since_epoch().count();
+            entry.name_offset = static_cast<std::uint32_t>(name_data.size());
+            entry.name_size = static_cast<std::uint32_t>(names[i].size());
+            name_data += names[i];
+            if (error)
+            {
+                std::cerr << "Failed to read asset " << names[i] << ": " << error.message()
+                          << '\n';
+                return false;
+            }
+
+            auto slot = static_cast<std::uint32_t>(entry.hash) & (header.slot_count - 1);
+            while (slots[slot] != AssetPackHeader::EMPTY_SLOT)
+            {
+                slot = (slot + 1) & (header.slot_count - 1);
+            }
+            slots[slot] = static_cast<std::uint32_t>(i);
+        }
+
+        auto offset = align(sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry) +
+                            slots.size() * sizeof(std::uint32_t) + name_data.size());
+        for (auto& entry : entries)
+        {
+            entry.offset = offset;
+            offset = align(offset + entry.size);
+        }
+
+        // Written to a file of its own first, so the game never maps a half written pack
+        auto temporary = path;
+        temporary += ".tmp";
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entries.data()),
+                   static_cast<std::streamsize>(entries.size() * sizeof(AssetPackEntry)));
+        file.write(reinterpret_cast<const char*>(slots.data()),
+                   static_cast<std::streamsize>(slots.size() * sizeof(std::uint32_t)));
+        file.write(name_data.data(), static_cast<std::streamsize>(name_data.size()));
+
+        std::vector<char> contents;
+        for (std::size_t i = 0; i < names.size() && file; i++)
+        {
+            std::ifstream asset(names[i], std::ios::binary);
+            contents.assign(static_cast<std::size_t>(entries[i].size), 0);
+            asset.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!asset)
+            {
+                std::cerr << "Failed to read asset " << names[i] << '\n';
+                return false;
+            }
+
+            std::fill_n(std::ostreambuf_iterator<char>(file),
+                        entries[i].offset - static_cast<std::uint64_t>(file.tellp()), '\0');
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+        file.close();
+        if (!file)
+        {
+            std::cerr << "Failed to write asset pack " << temporary << '\n';
+            fs::remove(temporary, error);
+            return false;
+        }
+        fs::rename(temporary, path, error);
+        if (error)
+        {
+            std::cerr << "Failed to write asset pack " << path << ": " << error.message() << '\n';
+            fs::remove(temporary, error);
+            return false;
+        }
+
+        std::cout << "Packed " << names.size() << " assets (" << offset / 1024 << "KB) into "
+                  << path << '\n';
+        return true;
+    }
+} // namespace AssetPack
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Util.h"
+
+/**
+    An asset pack is this header, then `file_count` AssetPackEntrys sorted by name, then a hash
+    table of `slot_count` entry indices, then the names, then the files' bytes.
+
+    Every file starts on a multiple of ALIGNMENT bytes from the start of the pack, and the files
+    are in the order of their names, so a directory is read front to back. Values are stored in
+    the native byte order, like GLCaptureHeader.
+*/
+struct AssetPackHeader
+{
+    static constexpr std::uint32_t MAGIC = 0x4B415053; // "SPAK"
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint64_t ALIGNMENT = 64;
+
+    // Slots of the hash table that hold no entry
+    static constexpr std::uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+
+    std::uint32_t magic = MAGIC;
+    std::uint32_t version = VERSION;
+
+    std::uint32_t file_count = 0;
+
+    // A power of two, at least twice the file count so probes stay short
+    std::uint32_t slot_count = 0;
+};
+
+struct AssetPackEntry
+{
+    // FNV-1a of the name, which is the path it was packed from, eg "assets/textures/crate.png"
+    std::uint64_t hash = 0;
+
+    // From the start of the pack
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+
+    // fs::file_time_type ticks of when the file was last written before it was packed
+    std::int64_t write_time = 0;
+
+    std::uint32_t name_offset = 0;
+    std::uint32_t name_size = 0;
+};
+
+/**
+    Reads assets from one memory mapped file instead of opening each of them, so a cold start is
+    a few long reads of the pack rather than an open and a seek for every file.
+
+    Looking a file up hashes its path and probes the pack's hash table, and gives a view of its
+    bytes in the mapping, which the decoders read from directly. The pack stays mapped until the
+    program ends, so the views never dangle.
+
+    open() must be called before anything reads assets, after which the pack is only read and
+    is safe to use from any thread. Files that are not in the pack, or every file when no pack
+    is open, are read from the file system as before. A packed file is used even when the loose
+    file is newer, so the pack has to be written again after editing assets.
+*/
+namespace AssetPack
+{
+    /// Maps the pack and asks for the whole of it to be read ahead
+    bool open(const fs::path& path);
+
+    /// The bytes of the file in the pack, or nothing if the pack does not have it
+    std::optional<std::span<const std::uint8_t>> find(const fs::path& path);
+
+    /// When the file was last written, from the pack when it has the file
+    fs::file_time_type last_write_time(const fs::path& path, std::error_code& error);
+
+    /// Packs every file under the directories, named by their paths, eg "assets/shaders" packs
+    /// "assets/shaders/SceneVertex.glsl". Directories that do not exist are skipped, and so is
+    /// the whole write if the pack is newer than every file
+    bool write(const fs::path& path, const std::vector<fs::path>& directories);
+} // namespace AssetPack
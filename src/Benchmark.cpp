@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include <SFML/Graphics/Image.hpp>
+
+namespace
+{
+    /// Nearest-rank percentile of already sorted values
+    float percentile(const std::vector<float>& sorted, float p)
+    {
+        auto rank = static_cast<std::size_t>(std::ceil(p / 100.0f * sorted.size()));
+        return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+    }
+} // namespace
+
+FrameTimeSummary summarise_frame_times(std::vector<float> frame_times_ms)
+{
+    FrameTimeSummary summary;
+    if (frame_times_ms.empty())
+    {
+        return summary;
+    }
+    std::sort(frame_times_ms.begin(), frame_times_ms.end());
+
+    summary.frames = frame_times_ms.size();
+    summary.mean_ms = std::accumulate(frame_times_ms.begin(), frame_times_ms.end(), 0.0f) /
+                      frame_times_ms.size();
+    summary.min_ms = frame_times_ms.front();
+    summary.max_ms = frame_times_ms.back();
+    summary.p50_ms = percentile(frame_times_ms, 50.0f);
+    summary.p95_ms = percentile(frame_times_ms, 95.0f);
+    summary.p99_ms = percentile(frame_times_ms, 99.0f);
+    return summary;
+}
+
+bool write_frame_stats(const fs::path& path, const std::vector<float>& frame_times_ms)
+{
+    std::ofstream out_file(path);
+    if (!out_file)
+    {
+        std::cerr << "Failed to open " << path << " for writing frame stats.\n";
+        return false;
+    }
+
+    auto summary = summarise_frame_times(frame_times_ms);
+    out_file << "frames " << summary.frames << '\n'
+             << "mean_ms " << summary.mean_ms << '\n'
+             << "min_ms " << summary.min_ms << '\n'
+             << "max_ms " << summary.max_ms << '\n'
+             << "p50_ms " << summary.p50_ms << '\n'
+             << "p95_ms " << summary.p95_ms << '\n'
+             << "p99_ms " << summary.p99_ms << '\n'
+             << "# frame times (ms)\n";
+    for (auto frame_time : frame_times_ms)
+    {
+        out_file << frame_time << '\n';
+    }
+
+    std::cout << "Rendered " << summary.frames << " frames, mean " << summary.mean_ms
+              << "ms, p50 " << summary.p50_ms << "ms, p95 " << summary.p95_ms << "ms, p99 "
+              << summary.p99_ms << "ms. Written to " << path << '\n';
+    return true;
+}
+
+bool save_texture_to_image(GLuint texture, GLuint width, GLuint height, const fs::path& path)
+{
+    std::vector<std::uint8_t> pixels(width * height * 4);
+    glGetTextureSubImage(texture, 0, 0, 0, 0, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                         static_cast<GLsizei>(pixels.size()), pixels.data());
+
+    // OpenGL's origin is the bottom left, images are top left
+    sf::Image image;
+    image.create(width, height, pixels.data());
+    image.flipVertically();
+    if (!image.saveToFile(path.string()))
+    {
+        std::cerr << "Failed to save image " << path << '\n';
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Util.h"
+
+struct FrameTimeSummary
+{
+    std::size_t frames = 0;
+
+    float mean_ms = 0.0f;
+    float min_ms = 0.0f;
+    float max_ms = 0.0f;
+
+    float p50_ms = 0.0f;
+    float p95_ms = 0.0f;
+    float p99_ms = 0.0f;
+};
+
+[[nodiscard]] FrameTimeSummary summarise_frame_times(std::vector<float> frame_times_ms);
+
+/// Writes the summary followed by every individual frame time, one per line
+bool write_frame_stats(const fs::path& path, const std::vector<float>& frame_times_ms);
+
+/// Reads back level 0 of a 2D texture and saves it in any format SFML can write (by extension)
+bool save_texture_to_image(GLuint texture, GLuint width, GLuint height, const fs::path& path);
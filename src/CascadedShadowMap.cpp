@@ -0,0 +1,217 @@
+#include "CascadedShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    // How far the splits lean towards a logarithmic split (1) from an even one (0). A log split
+    // gives every cascade the same texels per pixel, but leaves the first cascades tiny
+    constexpr float SPLIT_LAMBDA = 0.75f;
+
+    // Casters up to this far past a cascade's sphere towards the light are drawn into it
+    constexpr float CASTER_DISTANCE = 64.0f;
+
+    // The near and far planes move in steps of this much of the radius, so the depth range
+    // only changes when the camera has moved this far along the light
+    constexpr float DEPTH_SNAP = 0.25f;
+
+    glm::vec3 up_vector(const glm::vec3& direction)
+    {
+        return std::abs(direction.y) < 0.99f ? glm::vec3{0, 1, 0} : glm::vec3{1, 0, 0};
+    }
+} // namespace
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    glDeleteTextures(1, &texture_);
+}
+
+void CascadedShadowMap::create(GLsizei size, int cascades, float shadow_distance)
+{
+    cascades = std::clamp(cascades, 1, MAX_CASCADES);
+    desc_ = {size, size, GL_DEPTH_COMPONENT24};
+    shadow_distance_ = shadow_distance;
+    cascades_.resize(cascades);
+    stats_.cascades = cascades;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_);
+    glTextureStorage3D(texture_, 1, desc_.format, size, size, cascades);
+    glTextureParameteri(texture_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture_, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTextureParameteri(texture_, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // Outside the cascade is never in shadow
+    float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTextureParameteri(texture_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTextureParameteri(texture_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTextureParameterfv(texture_, GL_TEXTURE_BORDER_COLOR, border);
+}
+
+void CascadedShadowMap::set_views(const glm::mat4& view_matrix,
+                                  const glm::mat4& projection_matrix,
+                                  const glm::vec3& light_direction)
+{
+    float near_plane = projection_matrix[3][2] / (projection_matrix[2][2] - 1.0f);
+    float far_plane = std::max(shadow_distance_, near_plane + 1.0f);
+
+    // Squared slope of the view frustum's corner edges, how far a corner is from the view axis
+    // at a depth of 1
+    float slope_x = 1.0f / projection_matrix[0][0];
+    float slope_y = 1.0f / projection_matrix[1][1];
+    float corner_slope_squared = slope_x * slope_x + slope_y * slope_y;
+
+    glm::mat4 inverse_view = glm::inverse(view_matrix);
+    glm::vec3 eye{inverse_view[3]};
+    glm::vec3 forward = -glm::vec3{inverse_view[2]};
+
+    auto direction = glm::normalize(light_direction);
+    glm::mat4 light_view = glm::lookAt(glm::vec3{0.0f}, direction, up_vector(direction));
+
+    auto count = static_cast<int>(cascades_.size());
+    float slice_near = near_plane;
+    for (int i = 0; i < count; i++)
+    {
+        auto& cascade = cascades_[i];
+
+        float fraction = static_cast<float>(i + 1) / count;
+        float log_split = near_plane * std::pow(far_plane / near_plane, fraction);
+        float even_split = near_plane + (far_plane - near_plane) * fraction;
+        float slice_far = glm::mix(even_split, log_split, SPLIT_LAMBDA);
+        stats_.split_distances[i] = slice_far;
+
+        // The smallest sphere around the slice has its centre on the view axis, past the far
+        // plane it would be bigger than the circle around the far corners
+        float centre_depth = std::min((slice_far + slice_near) * (1.0f + corner_slope_squared) *
+                                          0.5f,
+                                      slice_far);
+        float near_offset = centre_depth - slice_near;
+        float far_offset = slice_far - centre_depth;
+        float radius =
+            std::sqrt(std::max(slice_near * slice_near * corner_slope_squared +
+                                   near_offset * near_offset,
+                               slice_far * slice_far * corner_slope_squared +
+                                   far_offset * far_offset));
+
+        // Rounded up so small changes to the projection do not change the texel size
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        cascade.radius = radius;
+        stats_.widths[i] = radius * 2.0f;
+
+        // Snap the centre to whole texels across the light, and to coarser steps along it
+        float texel = radius * 2.0f / static_cast<float>(desc_.width);
+        float depth_step = radius * DEPTH_SNAP;
+        glm::vec3 centre{light_view * glm::vec4{eye + forward * centre_depth, 1.0f}};
+        centre.x = std::floor(centre.x / texel) * texel;
+        centre.y = std::floor(centre.y / texel) * texel;
+        centre.z = std::floor(centre.z / depth_step) * depth_step;
+
+        // The view looks down -z, so the light side of the sphere is at the smaller depth
+        auto projection =
+            glm::ortho(centre.x - radius, centre.x + radius, centre.y - radius, centre.y + radius,
+                       -centre.z - radius - CASTER_DISTANCE, -centre.z + radius);
+        auto view_projection = projection * light_view;
+
+        cascade.view_changed = view_projection != cascade.view_projection;
+        cascade.view_projection = view_projection;
+        cascade.frustum = Frustum{view_projection};
+        cascade.dynamic_casters.clear();
+        stats_.casters[i] = 0;
+
+        slice_near = slice_far;
+    }
+    stats_.frames++;
+}
+
+void CascadedShadowMap::cull(const std::vector<glm::mat4>& model_matrices,
+                             const BoundingSphere& bounds, bool is_static,
+                             std::vector<std::vector<glm::mat4>>& visible)
+{
+    visible.resize(cascades_.size());
+    for (std::size_t i = 0; i < cascades_.size(); i++)
+    {
+        auto& cascade = cascades_[i];
+        auto& instances = visible[i];
+        if (!is_static || cascade.view_changed)
+        {
+            instances.clear();
+            for (auto& model_matrix : model_matrices)
+            {
+                auto centre = glm::vec3{model_matrix * glm::vec4{bounds.centre, 1.0f}};
+                if (cascade.frustum.intersects_sphere(centre, bounds.radius))
+                {
+                    instances.push_back(model_matrix);
+                }
+            }
+        }
+
+        if (!is_static)
+        {
+            cascade.dynamic_casters.insert(cascade.dynamic_casters.end(), instances.begin(),
+                                           instances.end());
+        }
+        stats_.casters[i] += instances.size();
+    }
+}
+
+bool CascadedShadowMap::needs_redraw(int cascade) const
+{
+    auto& c = cascades_[cascade];
+    return !c.drawn || c.drawn_view_projection != c.view_projection ||
+           c.drawn_dynamic_casters != c.dynamic_casters;
+}
+
+void CascadedShadowMap::validate_cascade(int cascade)
+{
+    auto& c = cascades_[cascade];
+    c.drawn = true;
+    c.drawn_view_projection = c.view_projection;
+    c.drawn_dynamic_casters = c.dynamic_casters;
+    stats_.redraws[cascade]++;
+}
+
+int CascadedShadowMap::cascade_count() const
+{
+    return static_cast<int>(cascades_.size());
+}
+
+const glm::mat4& CascadedShadowMap::view_projection(int cascade) const
+{
+    return cascades_[cascade].view_projection;
+}
+
+glm::mat4 CascadedShadowMap::sample_matrix(int cascade) const
+{
+    // Clip space [-1, 1] to texture coordinates and depth in [0, 1]
+    glm::mat4 bias{0.5f};
+    bias[3] = {0.5f, 0.5f, 0.5f, 1.0f};
+    return bias * cascades_[cascade].view_projection;
+}
+
+float CascadedShadowMap::split_distance(int cascade) const
+{
+    return stats_.split_distances[cascade];
+}
+
+float CascadedShadowMap::texel_size(int cascade) const
+{
+    return cascades_[cascade].radius * 2.0f / static_cast<float>(desc_.width);
+}
+
+GLuint CascadedShadowMap::texture() const
+{
+    return texture_;
+}
+
+const RenderTargetDesc& CascadedShadowMap::desc() const
+{
+    return desc_;
+}
+
+const CascadeShadowStats& CascadedShadowMap::stats() const
+{
+    return stats_;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "MeshGeneration.h"
+#include "RenderTargetPool.h"
+
+struct CascadeShadowStats
+{
+    static constexpr int MAX_CASCADES = 4;
+
+    int cascades = 0;
+
+    // Per cascade, the far end of its slice of the view, the width it covers and the casters
+    // that touch it this frame
+    std::array<float, MAX_CASCADES> split_distances{};
+    std::array<float, MAX_CASCADES> widths{};
+    std::array<std::size_t, MAX_CASCADES> casters{};
+
+    // How often each cascade had to be drawn again, because its casters changed
+    std::array<std::uint64_t, MAX_CASCADES> redraws{};
+    std::uint64_t frames = 0;
+};
+
+/**
+    Shadows from a directional light over the part of the world near the camera, split into
+    cascades that each cover a longer slice of the view with the same number of texels.
+
+    Every cascade is a layer of one depth texture array, so all of them are drawn in a single
+    pass with the layer picked per instance in the vertex shader. A cascade covers a sphere
+    around its slice of the view, so its size does not change as the camera turns. Its origin
+    is snapped to whole texels, so its contents only move by whole texels as the camera moves
+    and the shadow edges do not shimmer. Casters towards the light are only drawn up to a fixed
+    distance past the sphere, so the casters of a cascade do not grow with the world.
+
+    A cascade is only drawn again when the casters that touch it change: when its snapped view
+    moves, or when one of the moving casters in it moves.
+*/
+class CascadedShadowMap
+{
+  public:
+    static constexpr int MAX_CASCADES = CascadeShadowStats::MAX_CASCADES;
+
+    CascadedShadowMap() = default;
+    CascadedShadowMap(CascadedShadowMap&& other) noexcept = delete;
+    CascadedShadowMap(const CascadedShadowMap& other) = delete;
+    CascadedShadowMap& operator=(CascadedShadowMap&& other) noexcept = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap& other) = delete;
+    ~CascadedShadowMap();
+
+    /// The cascades split the view up to the shadow distance, past it nothing is shadowed
+    void create(GLsizei size, int cascades, float shadow_distance);
+
+    /// Fits the cascades to the camera's view frustum, for a light shining along the direction
+    void set_views(const glm::mat4& view_matrix, const glm::mat4& projection_matrix,
+                   const glm::vec3& light_direction);
+
+    /// Lists the model matrices of the instances that touch each cascade, one list per cascade.
+    /// Static casters are only culled again when a cascade's view changes, so for them
+    /// `visible` must be the same lists as were passed with the same casters last frame
+    void cull(const std::vector<glm::mat4>& model_matrices, const BoundingSphere& bounds,
+              bool is_static, std::vector<std::vector<glm::mat4>>& visible);
+
+    /// Whether the casters of the cascade changed since it was last drawn, only valid once
+    /// every caster has been culled
+    bool needs_redraw(int cascade) const;
+
+    /// Call once the cascade has been drawn with this frame's casters
+    void validate_cascade(int cascade);
+
+    int cascade_count() const;
+    const glm::mat4& view_projection(int cascade) const;
+
+    /// Maps a world position to the cascade's layer, with the depth in [0, 1]
+    glm::mat4 sample_matrix(int cascade) const;
+
+    /// The view depth at which the cascade ends and the next one begins
+    float split_distance(int cascade) const;
+
+    /// The width a texel of the cascade covers
+    float texel_size(int cascade) const;
+
+    GLuint texture() const;
+    const RenderTargetDesc& desc() const;
+
+    const CascadeShadowStats& stats() const;
+
+  private:
+    struct Cascade
+    {
+        glm::mat4 view_projection{0.0f};
+        Frustum frustum;
+        float radius = 0.0f;
+        bool view_changed = true;
+
+        // The moving casters culled into the cascade this frame
+        std::vector<glm::mat4> dynamic_casters;
+
+        // What the cascade was last drawn with
+        glm::mat4 drawn_view_projection{0.0f};
+        std::vector<glm::mat4> drawn_dynamic_casters;
+        bool drawn = false;
+    };
+
+    GLuint texture_ = 0;
+    RenderTargetDesc desc_;
+    float shadow_distance_ = 0.0f;
+
+    std::vector<Cascade> cascades_;
+    CascadeShadowStats stats_;
+};
@@ -0,0 +1,32 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& view_projection)
+{
+    // Each plane is the last row of the matrix plus or minus one of the others
+    auto row = [&](int i)
+    {
+        return glm::vec4{view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                         view_projection[3][i]};
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        planes_[i * 2] = row(3) + row(i);
+        planes_[i * 2 + 1] = row(3) - row(i);
+    }
+    for (auto& plane : planes_)
+    {
+        plane /= glm::length(glm::vec3{plane});
+    }
+}
+
+bool Frustum::intersects_sphere(const glm::vec3& centre, float radius) const
+{
+    for (auto& plane : planes_)
+    {
+        if (glm::dot(glm::vec3{plane}, centre) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+/// The six planes of a view-projection's clip volume, with normals pointing inwards
+class Frustum
+{
+  public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& view_projection);
+
+    /// Conservative, spheres near a corner may pass without touching it
+    bool intersects_sphere(const glm::vec3& centre, float radius) const;
+
+  private:
+    // xyz is the normal and w the distance, so a point is inside when dot(xyz, p) + w >= 0
+    std::array<glm::vec4, 6> planes_{};
+};
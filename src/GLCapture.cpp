@@ -0,0 +1,907 @@
+#include "GLCapture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "GLHooks.h"
+
+namespace
+{
+    using Hooks = GLHooks::Layer<struct CaptureTag>;
+
+    enum class Mode
+    {
+        Off,
+
+        // Before the first captured frame, resources are recorded and state is tracked
+        Setup,
+
+        // Everything is recorded
+        Frames,
+    };
+
+    /// Raw bytes, stored as their size followed by the bytes
+    struct Blob
+    {
+        const void* data = nullptr;
+        std::size_t size = 0;
+    };
+
+    /// The latest command to set some piece of state, eg the texture bound to one unit
+    struct StateCommand
+    {
+        std::uint64_t order = 0;
+        std::vector<std::byte> bytes;
+    };
+    using StateKey = std::pair<GLOp, std::uint64_t>;
+
+    struct CaptureState
+    {
+        Mode mode = Mode::Off;
+        int excluded = 0;
+
+        fs::path path;
+        GLuint width = 0;
+        GLuint height = 0;
+
+        int first_frame = 0;
+        int frame_count = 0;
+        int frame = 0;
+        int frames_captured = 0;
+
+        std::vector<std::byte> setup;
+        std::vector<std::byte> frames;
+
+        // Where the last complete frame ends, a frame cut short by stop() is not written
+        std::size_t frames_end = 0;
+
+        std::map<StateKey, StateCommand> state;
+        std::uint64_t state_order = 0;
+
+        // Where the bound pixel unpack buffer is mapped, if one is bound
+        const std::uint8_t* unpack_memory = nullptr;
+    };
+
+    CaptureState capture;
+
+    void put(std::vector<std::byte>& out, const void* data, std::size_t size)
+    {
+        auto bytes = static_cast<const std::byte*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void put_value(std::vector<std::byte>& out, const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put(out, &value, sizeof(T));
+    }
+
+    void put_value(std::vector<std::byte>& out, const Blob& blob)
+    {
+        put_value(out, static_cast<std::uint64_t>(blob.size));
+        put(out, blob.data, blob.size);
+    }
+
+    template <typename... Args>
+    void encode(std::vector<std::byte>& out, GLOp op, const Args&... args)
+    {
+        put_value(out, op);
+        (put_value(out, args), ...);
+    }
+
+    bool recording()
+    {
+        return capture.mode != Mode::Off && capture.excluded == 0;
+    }
+
+    /// The texels a texture upload reads, which are at an offset into the pixel unpack buffer
+    /// when one is bound
+    const void* unpack_source(const void* pixels)
+    {
+        if (!capture.unpack_memory)
+        {
+            return pixels;
+        }
+        return capture.unpack_memory + reinterpret_cast<std::uintptr_t>(pixels);
+    }
+
+    /// Resources are needed whenever they were created, so are recorded into either stream
+    template <typename... Args>
+    void record_resource(GLOp op, const Args&... args)
+    {
+        if (recording())
+        {
+            encode(capture.mode == Mode::Setup ? capture.setup : capture.frames, op, args...);
+        }
+    }
+
+    /// Before the captured frames only the latest command for each piece of state is kept
+    template <typename... Args>
+    void record_state(StateKey key, GLOp op, const Args&... args)
+    {
+        if (!recording())
+        {
+            return;
+        }
+        if (capture.mode == Mode::Frames)
+        {
+            encode(capture.frames, op, args...);
+            return;
+        }
+
+        auto& command = capture.state[key];
+        command.order = capture.state_order++;
+        command.bytes.clear();
+        encode(command.bytes, op, args...);
+    }
+
+    /// Draws and clears only matter in the captured frames
+    template <typename... Args>
+    void record_command(GLOp op, const Args&... args)
+    {
+        if (recording() && capture.mode == Mode::Frames)
+        {
+            encode(capture.frames, op, args...);
+        }
+    }
+
+    Blob names(GLsizei n, const GLuint* ids)
+    {
+        return {ids, sizeof(GLuint) * static_cast<std::size_t>(std::max(n, 0))};
+    }
+
+    std::uint64_t pair_key(GLuint a, GLuint b)
+    {
+        return (static_cast<std::uint64_t>(a) << 32) | b;
+    }
+
+    // Pointer sized values are always stored as 64 bit
+    std::int64_t to_i64(GLintptr value)
+    {
+        return static_cast<std::int64_t>(value);
+    }
+
+    std::int64_t to_i64(const void* offset)
+    {
+        return static_cast<std::int64_t>(reinterpret_cast<std::uintptr_t>(offset));
+    }
+
+    void set_hooks(bool install)
+    {
+        // Buffers
+        Hooks::set_hook<glad_glCreateBuffers>(
+            install,
+            [](GLsizei n, GLuint* buffers)
+            {
+                Hooks::call_original<glad_glCreateBuffers>(n, buffers);
+                record_resource(GLOp::CreateBuffers, n, names(n, buffers));
+            });
+        Hooks::set_hook<glad_glNamedBufferStorage>(
+            install,
+            [](GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags)
+            {
+                Blob blob{data, data ? static_cast<std::size_t>(size) : 0};
+                record_resource(GLOp::NamedBufferStorage, buffer, to_i64(size), flags, blob);
+                Hooks::call_original<glad_glNamedBufferStorage>(buffer, size, data, flags);
+            });
+        Hooks::set_hook<glad_glNamedBufferData>(
+            install,
+            [](GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+            {
+                Blob blob{data, data ? static_cast<std::size_t>(size) : 0};
+                record_resource(GLOp::NamedBufferData, buffer, to_i64(size), usage, blob);
+                Hooks::call_original<glad_glNamedBufferData>(buffer, size, data, usage);
+            });
+        Hooks::set_hook<glad_glNamedBufferSubData>(
+            install,
+            [](GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+            {
+                Blob blob{data, static_cast<std::size_t>(size)};
+                record_resource(GLOp::NamedBufferSubData, buffer, to_i64(offset), blob);
+                Hooks::call_original<glad_glNamedBufferSubData>(buffer, offset, size, data);
+            });
+        Hooks::set_hook<glad_glDeleteBuffers>(
+            install,
+            [](GLsizei n, const GLuint* buffers)
+            {
+                record_resource(GLOp::DeleteBuffers, n, names(n, buffers));
+                Hooks::call_original<glad_glDeleteBuffers>(n, buffers);
+            });
+
+        // Vertex arrays
+        Hooks::set_hook<glad_glCreateVertexArrays>(
+            install,
+            [](GLsizei n, GLuint* arrays)
+            {
+                Hooks::call_original<glad_glCreateVertexArrays>(n, arrays);
+                record_resource(GLOp::CreateVertexArrays, n, names(n, arrays));
+            });
+        Hooks::set_hook<glad_glVertexArrayVertexBuffer>(
+            install,
+            [](GLuint vao, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+            {
+                record_resource(GLOp::VertexArrayVertexBuffer, vao, binding, buffer,
+                                to_i64(offset), stride);
+                Hooks::call_original<glad_glVertexArrayVertexBuffer>(vao, binding, buffer, offset,
+                                                                     stride);
+            });
+        Hooks::set_hook<glad_glVertexArrayElementBuffer>(
+            install,
+            [](GLuint vao, GLuint buffer)
+            {
+                record_resource(GLOp::VertexArrayElementBuffer, vao, buffer);
+                Hooks::call_original<glad_glVertexArrayElementBuffer>(vao, buffer);
+            });
+        Hooks::set_hook<glad_glEnableVertexArrayAttrib>(
+            install,
+            [](GLuint vao, GLuint index)
+            {
+                record_resource(GLOp::EnableVertexArrayAttrib, vao, index);
+                Hooks::call_original<glad_glEnableVertexArrayAttrib>(vao, index);
+            });
+        Hooks::set_hook<glad_glVertexArrayAttribFormat>(
+            install,
+            [](GLuint vao, GLuint attrib, GLint size, GLenum type, GLboolean normalised,
+               GLuint relative_offset)
+            {
+                record_resource(GLOp::VertexArrayAttribFormat, vao, attrib, size, type,
+                                normalised, relative_offset);
+                Hooks::call_original<glad_glVertexArrayAttribFormat>(vao, attrib, size, type,
+                                                                     normalised, relative_offset);
+            });
+        Hooks::set_hook<glad_glVertexArrayAttribBinding>(
+            install,
+            [](GLuint vao, GLuint attrib, GLuint binding)
+            {
+                record_resource(GLOp::VertexArrayAttribBinding, vao, attrib, binding);
+                Hooks::call_original<glad_glVertexArrayAttribBinding>(vao, attrib, binding);
+            });
+        Hooks::set_hook<glad_glDeleteVertexArrays>(
+            install,
+            [](GLsizei n, const GLuint* arrays)
+            {
+                record_resource(GLOp::DeleteVertexArrays, n, names(n, arrays));
+                Hooks::call_original<glad_glDeleteVertexArrays>(n, arrays);
+            });
+
+        // Textures
+        Hooks::set_hook<glad_glCreateTextures>(
+            install,
+            [](GLenum target, GLsizei n, GLuint* textures)
+            {
+                Hooks::call_original<glad_glCreateTextures>(target, n, textures);
+                record_resource(GLOp::CreateTextures, target, n, names(n, textures));
+            });
+        Hooks::set_hook<glad_glTextureStorage2D>(
+            install,
+            [](GLuint texture, GLsizei levels, GLenum internal_format, GLsizei width,
+               GLsizei height)
+            {
+                record_resource(GLOp::TextureStorage2D, texture, levels, internal_format, width,
+                                height);
+                Hooks::call_original<glad_glTextureStorage2D>(texture, levels, internal_format,
+                                                              width, height);
+            });
+        Hooks::set_hook<glad_glTextureStorage2DMultisample>(
+            install,
+            [](GLuint texture, GLsizei samples, GLenum internal_format, GLsizei width,
+               GLsizei height, GLboolean fixed_sample_locations)
+            {
+                record_resource(GLOp::TextureStorage2DMultisample, texture, samples,
+                                internal_format, width, height, fixed_sample_locations);
+                Hooks::call_original<glad_glTextureStorage2DMultisample>(
+                    texture, samples, internal_format, width, height, fixed_sample_locations);
+            });
+        Hooks::set_hook<glad_glTextureStorage3D>(
+            install,
+            [](GLuint texture, GLsizei levels, GLenum internal_format, GLsizei width,
+               GLsizei height, GLsizei depth)
+            {
+                record_resource(GLOp::TextureStorage3D, texture, levels, internal_format, width,
+                                height, depth);
+                Hooks::call_original<glad_glTextureStorage3D>(texture, levels, internal_format,
+                                                              width, height, depth);
+            });
+        Hooks::set_hook<glad_glTextureSubImage2D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+               GLenum format, GLenum type, const void* pixels)
+            {
+                auto source = unpack_source(pixels);
+                Blob blob{source,
+                          source ? GLHooks::pixel_data_size(width, height, format, type) : 0};
+                record_resource(GLOp::TextureSubImage2D, texture, level, x, y, width, height,
+                                format, type, blob);
+                Hooks::call_original<glad_glTextureSubImage2D>(texture, level, x, y, width, height,
+                                                               format, type, pixels);
+            });
+        Hooks::set_hook<glad_glCompressedTextureSubImage2D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+               GLenum format, GLsizei image_size, const void* data)
+            {
+                Blob blob{unpack_source(data), static_cast<std::size_t>(image_size)};
+                record_resource(GLOp::CompressedTextureSubImage2D, texture, level, x, y, width,
+                                height, format, blob);
+                Hooks::call_original<glad_glCompressedTextureSubImage2D>(
+                    texture, level, x, y, width, height, format, image_size, data);
+            });
+        Hooks::set_hook<glad_glTextureSubImage3D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+            {
+                auto source = unpack_source(pixels);
+                Blob blob{source, source ? GLHooks::pixel_data_size(width, height, format, type) *
+                                               static_cast<std::size_t>(depth)
+                                         : 0};
+                record_resource(GLOp::TextureSubImage3D, texture, level, x, y, z, width, height,
+                                depth, format, type, blob);
+                Hooks::call_original<glad_glTextureSubImage3D>(texture, level, x, y, z, width,
+                                                               height, depth, format, type,
+                                                               pixels);
+            });
+        Hooks::set_hook<glad_glCompressedTextureSubImage3D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLsizei image_size, const void* data)
+            {
+                Blob blob{unpack_source(data), static_cast<std::size_t>(image_size)};
+                record_resource(GLOp::CompressedTextureSubImage3D, texture, level, x, y, z, width,
+                                height, depth, format, blob);
+                Hooks::call_original<glad_glCompressedTextureSubImage3D>(
+                    texture, level, x, y, z, width, height, depth, format, image_size, data);
+            });
+        Hooks::set_hook<glad_glTextureParameteri>(
+            install,
+            [](GLuint texture, GLenum name, GLint param)
+            {
+                record_resource(GLOp::TextureParameteri, texture, name, param);
+                Hooks::call_original<glad_glTextureParameteri>(texture, name, param);
+            });
+        Hooks::set_hook<glad_glTextureParameterfv>(
+            install,
+            [](GLuint texture, GLenum name, const GLfloat* params)
+            {
+                // Only the border colour takes more than one value
+                std::size_t count = name == GL_TEXTURE_BORDER_COLOR ? 4 : 1;
+                Blob blob{params, sizeof(GLfloat) * count};
+                record_resource(GLOp::TextureParameterfv, texture, name, blob);
+                Hooks::call_original<glad_glTextureParameterfv>(texture, name, params);
+            });
+        Hooks::set_hook<glad_glGenerateTextureMipmap>(
+            install,
+            [](GLuint texture)
+            {
+                record_resource(GLOp::GenerateTextureMipmap, texture);
+                Hooks::call_original<glad_glGenerateTextureMipmap>(texture);
+            });
+        Hooks::set_hook<glad_glDeleteTextures>(
+            install,
+            [](GLsizei n, const GLuint* textures)
+            {
+                record_resource(GLOp::DeleteTextures, n, names(n, textures));
+                Hooks::call_original<glad_glDeleteTextures>(n, textures);
+            });
+
+        // Framebuffers and renderbuffers
+        Hooks::set_hook<glad_glCreateFramebuffers>(
+            install,
+            [](GLsizei n, GLuint* framebuffers)
+            {
+                Hooks::call_original<glad_glCreateFramebuffers>(n, framebuffers);
+                record_resource(GLOp::CreateFramebuffers, n, names(n, framebuffers));
+            });
+        Hooks::set_hook<glad_glNamedFramebufferTexture>(
+            install,
+            [](GLuint framebuffer, GLenum attachment, GLuint texture, GLint level)
+            {
+                record_resource(GLOp::NamedFramebufferTexture, framebuffer, attachment, texture,
+                                level);
+                Hooks::call_original<glad_glNamedFramebufferTexture>(framebuffer, attachment,
+                                                                     texture, level);
+            });
+        Hooks::set_hook<glad_glNamedFramebufferRenderbuffer>(
+            install,
+            [](GLuint framebuffer, GLenum attachment, GLenum target, GLuint renderbuffer)
+            {
+                record_resource(GLOp::NamedFramebufferRenderbuffer, framebuffer, attachment,
+                                target, renderbuffer);
+                Hooks::call_original<glad_glNamedFramebufferRenderbuffer>(framebuffer, attachment,
+                                                                          target, renderbuffer);
+            });
+        Hooks::set_hook<glad_glNamedFramebufferDrawBuffers>(
+            install,
+            [](GLuint framebuffer, GLsizei n, const GLenum* buffers)
+            {
+                Blob blob{buffers, sizeof(GLenum) * static_cast<std::size_t>(n)};
+                record_resource(GLOp::NamedFramebufferDrawBuffers, framebuffer, n, blob);
+                Hooks::call_original<glad_glNamedFramebufferDrawBuffers>(framebuffer, n, buffers);
+            });
+        Hooks::set_hook<glad_glDeleteFramebuffers>(
+            install,
+            [](GLsizei n, const GLuint* framebuffers)
+            {
+                record_resource(GLOp::DeleteFramebuffers, n, names(n, framebuffers));
+                Hooks::call_original<glad_glDeleteFramebuffers>(n, framebuffers);
+            });
+        Hooks::set_hook<glad_glCreateRenderbuffers>(
+            install,
+            [](GLsizei n, GLuint* renderbuffers)
+            {
+                Hooks::call_original<glad_glCreateRenderbuffers>(n, renderbuffers);
+                record_resource(GLOp::CreateRenderbuffers, n, names(n, renderbuffers));
+            });
+        Hooks::set_hook<glad_glNamedRenderbufferStorage>(
+            install,
+            [](GLuint renderbuffer, GLenum internal_format, GLsizei width, GLsizei height)
+            {
+                record_resource(GLOp::NamedRenderbufferStorage, renderbuffer, internal_format,
+                                width, height);
+                Hooks::call_original<glad_glNamedRenderbufferStorage>(renderbuffer, internal_format,
+                                                                      width, height);
+            });
+        Hooks::set_hook<glad_glDeleteRenderbuffers>(
+            install,
+            [](GLsizei n, const GLuint* renderbuffers)
+            {
+                record_resource(GLOp::DeleteRenderbuffers, n, names(n, renderbuffers));
+                Hooks::call_original<glad_glDeleteRenderbuffers>(n, renderbuffers);
+            });
+
+        // Shaders
+        Hooks::set_hook<glad_glCreateShader>(
+            install,
+            [](GLenum type)
+            {
+                auto shader = Hooks::call_original<glad_glCreateShader>(type);
+                record_resource(GLOp::CreateShader, type, shader);
+                return shader;
+            });
+        Hooks::set_hook<glad_glShaderSource>(
+            install,
+            [](GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+            {
+                std::string source;
+                for (GLsizei i = 0; i < count; i++)
+                {
+                    source += lengths && lengths[i] >= 0
+                                  ? std::string(strings[i], lengths[i])
+                                  : std::string(strings[i]);
+                }
+                record_resource(GLOp::ShaderSource, shader, Blob{source.data(), source.size()});
+                Hooks::call_original<glad_glShaderSource>(shader, count, strings, lengths);
+            });
+        Hooks::set_hook<glad_glCompileShader>(
+            install,
+            [](GLuint shader)
+            {
+                record_resource(GLOp::CompileShader, shader);
+                Hooks::call_original<glad_glCompileShader>(shader);
+            });
+        Hooks::set_hook<glad_glCreateProgram>(
+            install,
+            []()
+            {
+                auto program = Hooks::call_original<glad_glCreateProgram>();
+                record_resource(GLOp::CreateProgram, program);
+                return program;
+            });
+        Hooks::set_hook<glad_glAttachShader>(
+            install,
+            [](GLuint program, GLuint shader)
+            {
+                record_resource(GLOp::AttachShader, program, shader);
+                Hooks::call_original<glad_glAttachShader>(program, shader);
+            });
+        Hooks::set_hook<glad_glLinkProgram>(
+            install,
+            [](GLuint program)
+            {
+                record_resource(GLOp::LinkProgram, program);
+                Hooks::call_original<glad_glLinkProgram>(program);
+            });
+        Hooks::set_hook<glad_glDeleteShader>(
+            install,
+            [](GLuint shader)
+            {
+                record_resource(GLOp::DeleteShader, shader);
+                Hooks::call_original<glad_glDeleteShader>(shader);
+            });
+        Hooks::set_hook<glad_glDeleteProgram>(
+            install,
+            [](GLuint program)
+            {
+                record_resource(GLOp::DeleteProgram, program);
+                Hooks::call_original<glad_glDeleteProgram>(program);
+            });
+        Hooks::set_hook<glad_glGetUniformLocation>(
+            install,
+            [](GLuint program, const GLchar* name)
+            {
+                // The replayer looks the name up again and maps the location it gets back
+                auto location = Hooks::call_original<glad_glGetUniformLocation>(program, name);
+                record_resource(GLOp::GetUniformLocation, program, location,
+                                Blob{name, std::strlen(name)});
+                return location;
+            });
+
+        // Programs and uniforms
+        Hooks::set_hook<glad_glUseProgram>(
+            install,
+            [](GLuint program)
+            {
+                record_state({GLOp::UseProgram, 0}, GLOp::UseProgram, program);
+                Hooks::call_original<glad_glUseProgram>(program);
+            });
+        Hooks::set_hook<glad_glProgramUniform1i>(
+            install,
+            [](GLuint program, GLint location, GLint v0)
+            {
+                StateKey key{GLOp::ProgramUniform1i, pair_key(program, location)};
+                record_state(key, GLOp::ProgramUniform1i, program, location, v0);
+                Hooks::call_original<glad_glProgramUniform1i>(program, location, v0);
+            });
+        Hooks::set_hook<glad_glProgramUniform1f>(
+            install,
+            [](GLuint program, GLint location, GLfloat v0)
+            {
+                StateKey key{GLOp::ProgramUniform1i, pair_key(program, location)};
+                record_state(key, GLOp::ProgramUniform1f, program, location, v0);
+                Hooks::call_original<glad_glProgramUniform1f>(program, location, v0);
+            });
+        Hooks::set_hook<glad_glProgramUniform2fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count, const GLfloat* value)
+            {
+                StateKey key{GLOp::ProgramUniform1i, pair_key(program, location)};
+                Blob blob{value, sizeof(GLfloat) * 2 * static_cast<std::size_t>(count)};
+                record_state(key, GLOp::ProgramUniform2fv, program, location, count, blob);
+                Hooks::call_original<glad_glProgramUniform2fv>(program, location, count, value);
+            });
+        Hooks::set_hook<glad_glProgramUniform3fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count, const GLfloat* value)
+            {
+                StateKey key{GLOp::ProgramUniform1i, pair_key(program, location)};
+                Blob blob{value, sizeof(GLfloat) * 3 * static_cast<std::size_t>(count)};
+                record_state(key, GLOp::ProgramUniform3fv, program, location, count, blob);
+                Hooks::call_original<glad_glProgramUniform3fv>(program, location, count, value);
+            });
+        Hooks::set_hook<glad_glProgramUniformMatrix4fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count, GLboolean transpose,
+               const GLfloat* value)
+            {
+                StateKey key{GLOp::ProgramUniform1i, pair_key(program, location)};
+                Blob blob{value, sizeof(GLfloat) * 16 * static_cast<std::size_t>(count)};
+                record_state(key, GLOp::ProgramUniformMatrix4fv, program, location, count,
+                             transpose, blob);
+                Hooks::call_original<glad_glProgramUniformMatrix4fv>(program, location, count,
+                                                                     transpose, value);
+            });
+
+        // Bindings
+        Hooks::set_hook<glad_glBindTextureUnit>(
+            install,
+            [](GLuint unit, GLuint texture)
+            {
+                record_state({GLOp::BindTextureUnit, unit}, GLOp::BindTextureUnit, unit, texture);
+                Hooks::call_original<glad_glBindTextureUnit>(unit, texture);
+            });
+        Hooks::set_hook<glad_glBindVertexArray>(
+            install,
+            [](GLuint vao)
+            {
+                record_state({GLOp::BindVertexArray, 0}, GLOp::BindVertexArray, vao);
+                Hooks::call_original<glad_glBindVertexArray>(vao);
+            });
+        Hooks::set_hook<glad_glBindFramebuffer>(
+            install,
+            [](GLenum target, GLuint framebuffer)
+            {
+                // Binding GL_FRAMEBUFFER replaces both the draw and read bindings
+                if (target == GL_FRAMEBUFFER && capture.mode == Mode::Setup)
+                {
+                    capture.state.erase({GLOp::BindFramebuffer, GL_DRAW_FRAMEBUFFER});
+                    capture.state.erase({GLOp::BindFramebuffer, GL_READ_FRAMEBUFFER});
+                }
+                record_state({GLOp::BindFramebuffer, target}, GLOp::BindFramebuffer, target,
+                             framebuffer);
+                Hooks::call_original<glad_glBindFramebuffer>(target, framebuffer);
+            });
+        Hooks::set_hook<glad_glBindBufferBase>(
+            install,
+            [](GLenum target, GLuint index, GLuint buffer)
+            {
+                StateKey key{GLOp::BindBufferRange, pair_key(target, index)};
+                record_state(key, GLOp::BindBufferBase, target, index, buffer);
+                Hooks::call_original<glad_glBindBufferBase>(target, index, buffer);
+            });
+        Hooks::set_hook<glad_glBindBufferRange>(
+            install,
+            [](GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+            {
+                StateKey key{GLOp::BindBufferRange, pair_key(target, index)};
+                record_state(key, GLOp::BindBufferRange, target, index, buffer, to_i64(offset),
+                             to_i64(size));
+                Hooks::call_original<glad_glBindBufferRange>(target, index, buffer, offset, size);
+            });
+
+        // Fixed function state
+        Hooks::set_hook<glad_glEnable>(
+            install,
+            [](GLenum capability)
+            {
+                record_state({GLOp::Enable, capability}, GLOp::Enable, capability);
+                Hooks::call_original<glad_glEnable>(capability);
+            });
+        Hooks::set_hook<glad_glDisable>(
+            install,
+            [](GLenum capability)
+            {
+                record_state({GLOp::Enable, capability}, GLOp::Disable, capability);
+                Hooks::call_original<glad_glDisable>(capability);
+            });
+        Hooks::set_hook<glad_glCullFace>(
+            install,
+            [](GLenum mode)
+            {
+                record_state({GLOp::CullFace, 0}, GLOp::CullFace, mode);
+                Hooks::call_original<glad_glCullFace>(mode);
+            });
+        Hooks::set_hook<glad_glDepthFunc>(
+            install,
+            [](GLenum func)
+            {
+                record_state({GLOp::DepthFunc, 0}, GLOp::DepthFunc, func);
+                Hooks::call_original<glad_glDepthFunc>(func);
+            });
+        Hooks::set_hook<glad_glDepthMask>(
+            install,
+            [](GLboolean flag)
+            {
+                record_state({GLOp::DepthMask, 0}, GLOp::DepthMask, flag);
+                Hooks::call_original<glad_glDepthMask>(flag);
+            });
+        Hooks::set_hook<glad_glColorMask>(
+            install,
+            [](GLboolean r, GLboolean g, GLboolean b, GLboolean a)
+            {
+                record_state({GLOp::ColorMask, 0}, GLOp::ColorMask, r, g, b, a);
+                Hooks::call_original<glad_glColorMask>(r, g, b, a);
+            });
+        Hooks::set_hook<glad_glBlendFunc>(
+            install,
+            [](GLenum source, GLenum destination)
+            {
+                record_state({GLOp::BlendFunc, 0}, GLOp::BlendFunc, source, destination);
+                Hooks::call_original<glad_glBlendFunc>(source, destination);
+            });
+        Hooks::set_hook<glad_glViewport>(
+            install,
+            [](GLint x, GLint y, GLsizei width, GLsizei height)
+            {
+                record_state({GLOp::Viewport, 0}, GLOp::Viewport, x, y, width, height);
+                Hooks::call_original<glad_glViewport>(x, y, width, height);
+            });
+        Hooks::set_hook<glad_glClearColor>(
+            install,
+            [](GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+            {
+                record_state({GLOp::ClearColor, 0}, GLOp::ClearColor, r, g, b, a);
+                Hooks::call_original<glad_glClearColor>(r, g, b, a);
+            });
+
+        // Clears and draws
+        Hooks::set_hook<glad_glClear>(
+            install,
+            [](GLbitfield mask)
+            {
+                record_command(GLOp::Clear, mask);
+                Hooks::call_original<glad_glClear>(mask);
+            });
+        Hooks::set_hook<glad_glClearTexSubImage>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* data)
+            {
+                // The data is a single texel, or null to clear to zero
+                Blob blob{data, data ? GLHooks::pixel_data_size(1, 1, format, type) : 0};
+                record_command(GLOp::ClearTexSubImage, texture, level, x, y, z, width, height,
+                               depth, format, type, blob);
+                Hooks::call_original<glad_glClearTexSubImage>(texture, level, x, y, z, width,
+                                                              height, depth, format, type, data);
+            });
+        Hooks::set_hook<glad_glMemoryBarrier>(
+            install,
+            [](GLbitfield barriers)
+            {
+                record_command(GLOp::MemoryBarrier, barriers);
+                Hooks::call_original<glad_glMemoryBarrier>(barriers);
+            });
+        Hooks::set_hook<glad_glCopyImageSubData>(
+            install,
+            [](GLuint source, GLenum source_target, GLint source_level, GLint source_x,
+               GLint source_y, GLint source_z, GLuint destination, GLenum destination_target,
+               GLint destination_level, GLint destination_x, GLint destination_y,
+               GLint destination_z, GLsizei width, GLsizei height, GLsizei depth)
+            {
+                record_command(GLOp::CopyImageSubData, source, source_target, source_level,
+                               source_x, source_y, source_z, destination, destination_target,
+                               destination_level, destination_x, destination_y, destination_z,
+                               width, height, depth);
+                Hooks::call_original<glad_glCopyImageSubData>(
+                    source, source_target, source_level, source_x, source_y, source_z,
+                    destination, destination_target, destination_level, destination_x,
+                    destination_y, destination_z, width, height, depth);
+            });
+        Hooks::set_hook<glad_glDrawArrays>(
+            install,
+            [](GLenum mode, GLint first, GLsizei count)
+            {
+                record_command(GLOp::DrawArrays, mode, first, count);
+                Hooks::call_original<glad_glDrawArrays>(mode, first, count);
+            });
+        Hooks::set_hook<glad_glDrawElements>(
+            install,
+            [](GLenum mode, GLsizei count, GLenum type, const void* indices)
+            {
+                record_command(GLOp::DrawElements, mode, count, type, to_i64(indices));
+                Hooks::call_original<glad_glDrawElements>(mode, count, type, indices);
+            });
+        Hooks::set_hook<glad_glDrawElementsInstanced>(
+            install,
+            [](GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+            {
+                record_command(GLOp::DrawElementsInstanced, mode, count, type, to_i64(indices),
+                               instances);
+                Hooks::call_original<glad_glDrawElementsInstanced>(mode, count, type, indices,
+                                                                   instances);
+            });
+    }
+
+    bool write_capture()
+    {
+        std::vector<std::byte> state;
+        std::vector<const StateCommand*> commands;
+        for (auto& [key, command] : capture.state)
+        {
+            commands.push_back(&command);
+        }
+        std::sort(commands.begin(), commands.end(),
+                  [](auto a, auto b) { return a->order < b->order; });
+        for (auto command : commands)
+        {
+            put(state, command->bytes.data(), command->bytes.size());
+        }
+
+        GLCaptureHeader header;
+        header.width = capture.width;
+        header.height = capture.height;
+        header.frames = static_cast<std::uint32_t>(capture.frames_captured);
+        header.setup_bytes = capture.setup.size();
+        header.state_bytes = state.size();
+        header.frames_bytes = capture.frames_end;
+
+        std::ofstream out_file(capture.path, std::ios::binary);
+        if (!out_file)
+        {
+            std::cerr << "Failed to open " << capture.path << " for writing the capture.\n";
+            return false;
+        }
+        out_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        auto write_stream = [&](const std::vector<std::byte>& stream, std::size_t size)
+        {
+            out_file.write(reinterpret_cast<const char*>(stream.data()),
+                           static_cast<std::streamsize>(size));
+        };
+        write_stream(capture.setup, capture.setup.size());
+        write_stream(state, state.size());
+        write_stream(capture.frames, capture.frames_end);
+
+        std::cout << "Captured " << header.frames << " frames to " << capture.path << " ("
+                  << (sizeof(header) + header.setup_bytes + header.state_bytes +
+                      header.frames_bytes) /
+                         1024
+                  << "KB)\n";
+        return true;
+    }
+} // namespace
+
+namespace GLCapture
+{
+    void start(const fs::path& path, int first_frame, int frame_count, GLuint width,
+               GLuint height)
+    {
+        if (capture.mode != Mode::Off)
+        {
+            return;
+        }
+
+        capture = {};
+        capture.mode = Mode::Setup;
+        capture.path = path;
+        capture.width = width;
+        capture.height = height;
+
+        // The first frame starts at the end of the frame before it, so there must be one
+        capture.first_frame = std::max(first_frame, 1);
+        capture.frame_count = std::max(frame_count, 1);
+        set_hooks(true);
+    }
+
+    bool is_active()
+    {
+        return capture.mode != Mode::Off;
+    }
+
+    void record_mapped_write(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size)
+    {
+        record_command(GLOp::MappedWrite, buffer, to_i64(offset),
+                       Blob{data, static_cast<std::size_t>(size)});
+    }
+
+    void set_pixel_unpack_memory(const void* memory)
+    {
+        capture.unpack_memory = static_cast<const std::uint8_t*>(memory);
+    }
+
+    void end_frame()
+    {
+        if (capture.mode == Mode::Off)
+        {
+            return;
+        }
+
+        capture.frame++;
+        if (capture.mode == Mode::Setup && capture.frame == capture.first_frame)
+        {
+            capture.mode = Mode::Frames;
+        }
+        else if (capture.mode == Mode::Frames)
+        {
+            encode(capture.frames, GLOp::EndFrame);
+            capture.frames_end = capture.frames.size();
+            if (++capture.frames_captured == capture.frame_count)
+            {
+                stop();
+            }
+        }
+    }
+
+    void stop()
+    {
+        if (capture.mode == Mode::Off)
+        {
+            return;
+        }
+
+        if (capture.frames_captured > 0)
+        {
+            write_capture();
+        }
+        else
+        {
+            std::cerr << "Capture stopped before a frame was captured, nothing was written.\n";
+        }
+        set_hooks(false);
+        capture = {};
+    }
+
+    ExcludeScope::ExcludeScope()
+    {
+        capture.excluded++;
+    }
+
+    ExcludeScope::~ExcludeScope()
+    {
+        capture.excluded--;
+    }
+} // namespace GLCapture
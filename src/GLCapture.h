@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "Util.h"
+
+/// Every command in a capture is a GLOp followed by its arguments, see GLCapture.cpp
+enum class GLOp : std::uint16_t
+{
+    // Resources, always recorded
+    CreateBuffers,
+    NamedBufferStorage,
+    NamedBufferData,
+    NamedBufferSubData,
+    DeleteBuffers,
+    CreateVertexArrays,
+    VertexArrayVertexBuffer,
+    VertexArrayElementBuffer,
+    EnableVertexArrayAttrib,
+    VertexArrayAttribFormat,
+    VertexArrayAttribBinding,
+    DeleteVertexArrays,
+    CreateTextures,
+    TextureStorage2D,
+    TextureStorage2DMultisample,
+    TextureStorage3D,
+    TextureSubImage2D,
+    CompressedTextureSubImage2D,
+    TextureSubImage3D,
+    CompressedTextureSubImage3D,
+    TextureParameteri,
+    TextureParameterfv,
+    GenerateTextureMipmap,
+    DeleteTextures,
+    CreateFramebuffers,
+    NamedFramebufferTexture,
+    NamedFramebufferRenderbuffer,
+    NamedFramebufferDrawBuffers,
+    DeleteFramebuffers,
+    CreateRenderbuffers,
+    NamedRenderbufferStorage,
+    DeleteRenderbuffers,
+    CreateShader,
+    ShaderSource,
+    CompileShader,
+    CreateProgram,
+    AttachShader,
+    LinkProgram,
+    DeleteShader,
+    DeleteProgram,
+    GetUniformLocation,
+
+    // State and draws, only recorded for the captured frames
+    UseProgram,
+    ProgramUniform1i,
+    ProgramUniform1f,
+    ProgramUniform2fv,
+    ProgramUniform3fv,
+    ProgramUniformMatrix4fv,
+    BindTextureUnit,
+    BindVertexArray,
+    BindFramebuffer,
+    BindBufferBase,
+    BindBufferRange,
+    Enable,
+    Disable,
+    CullFace,
+    DepthFunc,
+    DepthMask,
+    ColorMask,
+    BlendFunc,
+    Viewport,
+    ClearColor,
+    Clear,
+    ClearTexSubImage,
+    MemoryBarrier,
+    CopyImageSubData,
+    DrawArrays,
+    DrawElements,
+    DrawElementsInstanced,
+
+    // Writes to persistently mapped buffers, replayed as glNamedBufferSubData
+    MappedWrite,
+
+    EndFrame,
+};
+
+/**
+    A capture file is this header followed by three command streams:
+
+     - Setup:  Every resource created before the first captured frame (with its contents).
+     - State:  The bindings, enables and uniform values as they were when capturing started.
+     - Frames: Every command of the captured frames, each ending with GLOp::EndFrame.
+
+    A replayer runs the setup once, then the state and frames for as many loops as it likes.
+    Values are stored in the native byte order, so captures are not portable between big and
+    little endian machines.
+*/
+struct GLCaptureHeader
+{
+    static constexpr std::uint32_t MAGIC = 0x50414347; // "GCAP"
+    static constexpr std::uint32_t VERSION = 8;
+
+    std::uint32_t magic = MAGIC;
+    std::uint32_t version = VERSION;
+
+    // Size of the default framebuffer, the replayer renders "framebuffer 0" into a FBO this size
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+
+    std::uint32_t frames = 0;
+    std::uint32_t padding = 0;
+
+    std::uint64_t setup_bytes = 0;
+    std::uint64_t state_bytes = 0;
+    std::uint64_t frames_bytes = 0;
+};
+
+/**
+    Records the GL command stream into a capture file by wrapping the glad entry points the
+    renderer uses. Entry points that are not wrapped (queries, fences, debug output, reads) are
+    not part of the capture.
+
+    Must be started before any resources are created, and before any other GLHooks layer (such as
+    GLStats) is enabled. Calls made inside an ExcludeScope, such as ImGui's, are not recorded.
+    Render thread only.
+*/
+namespace GLCapture
+{
+    /// Starts recording resources now, and every command from frame `first_frame` (counted by
+    /// end_frame()) for `frame_count` frames, after which the capture is written to `path`
+    void start(const fs::path& path, int first_frame, int frame_count, GLuint width,
+               GLuint height);
+
+    bool is_active();
+
+    /// For writes into persistently mapped buffers, which never go through an entry point
+    void record_mapped_write(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size);
+
+    /// While a persistently mapped pixel unpack buffer is bound, texture uploads take offsets
+    /// into it. The capture reads their texels from where it is mapped, and records them as if
+    /// they came from client memory. nullptr when it is unbound
+    void set_pixel_unpack_memory(const void* memory);
+
+    void end_frame();
+
+    /// Writes the capture early if it was still running, and removes the wrappers
+    void stop();
+
+    class ExcludeScope
+    {
+      public:
+        ExcludeScope();
+        ExcludeScope(const ExcludeScope&) = delete;
+        ExcludeScope& operator=(const ExcludeScope&) = delete;
+        ~ExcludeScope();
+    };
+} // namespace GLCapture
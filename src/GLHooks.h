@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include <glad/glad.h>
+
+/**
+    Helpers for the layers (GLStats, GLCapture) that wrap glad entry points by swapping the
+    glad function pointers.
+
+    Layers stack: a wrapper calls whatever pointer it replaced, which may be another layer's
+    wrapper. A layer can only be removed while it is the outermost one, so layers should be
+    removed in the reverse order they were installed.
+*/
+namespace GLHooks
+{
+    /// Each layer has its own Layer type (by tag) so each remembers the pointers it replaced
+    template <typename Tag>
+    struct Layer
+    {
+        template <auto& Function>
+        static inline std::remove_reference_t<decltype(Function)> original = nullptr;
+
+        template <auto& Function, typename... Args>
+        static auto call_original(Args... args)
+        {
+            return original<Function>(args...);
+        }
+
+        template <auto& Function>
+        static void set_hook(bool install, std::remove_reference_t<decltype(Function)> wrapper)
+        {
+            if (install && Function != wrapper)
+            {
+                original<Function> = Function;
+                Function = wrapper;
+            }
+            else if (!install && Function == wrapper)
+            {
+                Function = original<Function>;
+            }
+        }
+    };
+
+    /// Size of the client pixel data read by glTex(ture)(Sub)Image2D with the default unpack
+    /// alignment of 4
+    inline std::size_t pixel_data_size(GLsizei width, GLsizei height, GLenum format,
+                                       GLenum type)
+    {
+        if (width <= 0 || height <= 0)
+        {
+            return 0;
+        }
+
+        std::size_t components = 4;
+        switch (format)
+        {
+            case GL_RED:
+            case GL_DEPTH_COMPONENT:
+                components = 1;
+                break;
+            case GL_RG:
+                components = 2;
+                break;
+            case GL_RGB:
+            case GL_BGR:
+                components = 3;
+                break;
+        }
+
+        std::size_t component_size = 1;
+        switch (type)
+        {
+            case GL_UNSIGNED_SHORT:
+            case GL_SHORT:
+            case GL_HALF_FLOAT:
+                component_size = 2;
+                break;
+            case GL_UNSIGNED_INT:
+            case GL_INT:
+            case GL_FLOAT:
+                component_size = 4;
+                break;
+        }
+
+        auto row = static_cast<std::size_t>(width) * components * component_size;
+        auto aligned_row = (row + 3) & ~std::size_t{3};
+        return aligned_row * (height - 1) + row;
+    }
+} // namespace GLHooks
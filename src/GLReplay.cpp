@@ -0,0 +1,872 @@
+#include "GLReplay.h"
+
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+
+namespace
+{
+    /// Reads values back in the order GLCapture wrote them
+    class CommandReader
+    {
+      public:
+        explicit CommandReader(const std::vector<std::byte>& stream)
+            : position_(stream.data())
+            , end_(stream.data() + stream.size())
+        {
+        }
+
+        template <typename T>
+        T read()
+        {
+            T value{};
+            if (static_cast<std::size_t>(end_ - position_) < sizeof(T))
+            {
+                failed_ = true;
+                position_ = end_;
+                return value;
+            }
+            std::memcpy(&value, position_, sizeof(T));
+            position_ += sizeof(T);
+            return value;
+        }
+
+        std::span<const std::byte> read_blob()
+        {
+            auto size = read<std::uint64_t>();
+            if (static_cast<std::uint64_t>(end_ - position_) < size)
+            {
+                failed_ = true;
+                position_ = end_;
+                return {};
+            }
+            std::span<const std::byte> blob(position_, static_cast<std::size_t>(size));
+            position_ += size;
+            return blob;
+        }
+
+        /// Empty blobs are passed to GL as a null pointer
+        const void* read_data()
+        {
+            auto blob = read_blob();
+            return blob.empty() ? nullptr : blob.data();
+        }
+
+        std::string read_string()
+        {
+            auto blob = read_blob();
+            return {reinterpret_cast<const char*>(blob.data()), blob.size()};
+        }
+
+        bool at_end() const
+        {
+            return position_ == end_;
+        }
+
+        bool failed() const
+        {
+            return failed_;
+        }
+
+      private:
+        const std::byte* position_;
+        const std::byte* end_;
+        bool failed_ = false;
+    };
+
+    std::vector<GLuint> read_names(CommandReader& reader, GLsizei n)
+    {
+        auto blob = reader.read_blob();
+        std::vector<GLuint> names(static_cast<std::size_t>(std::max(n, 0)));
+        std::memcpy(names.data(), blob.data(), std::min(blob.size(), names.size() * 4));
+        return names;
+    }
+
+    const void* to_offset(std::int64_t offset)
+    {
+        return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(offset));
+    }
+
+    std::uint64_t location_key(GLuint program, GLint location)
+    {
+        return (static_cast<std::uint64_t>(program) << 32) | static_cast<GLuint>(location);
+    }
+} // namespace
+
+GLReplay::~GLReplay()
+{
+    // Nothing was created if the setup never ran
+    if (default_fbo_ == 0)
+    {
+        return;
+    }
+
+    auto delete_all = [](std::unordered_map<GLuint, GLuint>& names, auto delete_function)
+    {
+        for (auto& [captured, name] : names)
+        {
+            delete_function(1, &name);
+        }
+    };
+    delete_all(buffers_, glDeleteBuffers);
+    delete_all(vertex_arrays_, glDeleteVertexArrays);
+    delete_all(textures_, glDeleteTextures);
+    delete_all(framebuffers_, glDeleteFramebuffers);
+    delete_all(renderbuffers_, glDeleteRenderbuffers);
+    for (auto& [captured, name] : shader_objects_)
+    {
+        glIsProgram(name) ? glDeleteProgram(name) : glDeleteShader(name);
+    }
+
+    glDeleteFramebuffers(1, &default_fbo_);
+    glDeleteTextures(1, &default_colour_);
+    glDeleteRenderbuffers(1, &default_depth_);
+}
+
+bool GLReplay::load_from_file(const fs::path& path)
+{
+    std::ifstream in_file(path, std::ios::binary);
+    if (!in_file)
+    {
+        std::cerr << "Failed to open capture " << path << '\n';
+        return false;
+    }
+
+    in_file.read(reinterpret_cast<char*>(&header_), sizeof(header_));
+    if (!in_file || header_.magic != GLCaptureHeader::MAGIC)
+    {
+        std::cerr << path << " is not a capture file.\n";
+        return false;
+    }
+    if (header_.version != GLCaptureHeader::VERSION)
+    {
+        std::cerr << path << " is capture version " << header_.version << ", expected "
+                  << GLCaptureHeader::VERSION << ".\n";
+        return false;
+    }
+
+    for (auto [stream, size] : {std::pair{&setup_, header_.setup_bytes},
+                                std::pair{&state_, header_.state_bytes},
+                                std::pair{&frames_, header_.frames_bytes}})
+    {
+        stream->resize(static_cast<std::size_t>(size));
+        in_file.read(reinterpret_cast<char*>(stream->data()), static_cast<std::streamsize>(size));
+    }
+    if (!in_file)
+    {
+        std::cerr << "Capture " << path << " is truncated.\n";
+        return false;
+    }
+    return true;
+}
+
+bool GLReplay::run_setup()
+{
+    glCreateFramebuffers(1, &default_fbo_);
+    glCreateTextures(GL_TEXTURE_2D, 1, &default_colour_);
+    glTextureStorage2D(default_colour_, 1, GL_RGBA8, header_.width, header_.height);
+    glCreateRenderbuffers(1, &default_depth_);
+    glNamedRenderbufferStorage(default_depth_, GL_DEPTH24_STENCIL8, header_.width,
+                               header_.height);
+    glNamedFramebufferTexture(default_fbo_, GL_COLOR_ATTACHMENT0, default_colour_, 0);
+    glNamedFramebufferRenderbuffer(default_fbo_, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+                                   default_depth_);
+
+    return execute(setup_, {});
+}
+
+bool GLReplay::play_frames(const std::function<void()>& on_frame_end)
+{
+    commands_ = 0;
+    return execute(state_, {}) && execute(frames_, on_frame_end);
+}
+
+const GLCaptureHeader& GLReplay::header() const
+{
+    return header_;
+}
+
+std::size_t GLReplay::commands_per_loop() const
+{
+    return commands_;
+}
+
+GLuint GLReplay::map(const std::unordered_map<GLuint, GLuint>& names, GLuint name) const
+{
+    auto itr = names.find(name);
+    return itr == names.end() ? 0 : itr->second;
+}
+
+GLint GLReplay::map_location(GLuint program, GLint location) const
+{
+    auto itr = uniform_locations_.find(location_key(program, location));
+    return itr == uniform_locations_.end() ? location : itr->second;
+}
+
+bool GLReplay::execute(const std::vector<std::byte>& stream,
+                       const std::function<void()>& on_frame_end)
+{
+    CommandReader reader(stream);
+
+    // Commands that create names map each captured name to the one created now
+    auto create = [&](std::unordered_map<GLuint, GLuint>& names, auto create_function)
+    {
+        auto n = reader.read<GLsizei>();
+        auto captured = read_names(reader, n);
+        std::vector<GLuint> created(captured.size());
+        create_function(n, created.data());
+        for (std::size_t i = 0; i < captured.size(); i++)
+        {
+            names[captured[i]] = created[i];
+        }
+    };
+    auto destroy = [&](std::unordered_map<GLuint, GLuint>& names, auto delete_function)
+    {
+        auto n = reader.read<GLsizei>();
+        for (auto name : read_names(reader, n))
+        {
+            auto mapped = map(names, name);
+            delete_function(1, &mapped);
+            names.erase(name);
+        }
+    };
+    auto buffer = [&]()
+    {
+        return map(buffers_, reader.read<GLuint>());
+    };
+    auto vertex_array = [&]()
+    {
+        return map(vertex_arrays_, reader.read<GLuint>());
+    };
+    auto texture = [&]()
+    {
+        return map(textures_, reader.read<GLuint>());
+    };
+    auto framebuffer = [&]()
+    {
+        return map(framebuffers_, reader.read<GLuint>());
+    };
+    auto renderbuffer = [&]()
+    {
+        return map(renderbuffers_, reader.read<GLuint>());
+    };
+    auto shader_object = [&]()
+    {
+        return map(shader_objects_, reader.read<GLuint>());
+    };
+    auto read_enum = [&]()
+    {
+        return reader.read<GLenum>();
+    };
+    auto read_int = [&]()
+    {
+        return reader.read<GLint>();
+    };
+    auto read_i64 = [&]()
+    {
+        return reader.read<std::int64_t>();
+    };
+
+    while (!reader.at_end())
+    {
+        auto op = reader.read<GLOp>();
+        commands_++;
+
+        // Arguments are read into locals first as the order function arguments are evaluated
+        // in is unspecified
+        switch (op)
+        {
+            case GLOp::CreateBuffers:
+                create(buffers_, glCreateBuffers);
+                break;
+
+            case GLOp::NamedBufferStorage:
+            {
+                auto name = buffer();
+                auto size = read_i64();
+                auto flags = reader.read<GLbitfield>();
+                auto data = reader.read_data();
+
+                // Mapped writes are replayed with glNamedBufferSubData
+                glNamedBufferStorage(name, size, data, flags | GL_DYNAMIC_STORAGE_BIT);
+                break;
+            }
+
+            case GLOp::NamedBufferData:
+            {
+                auto name = buffer();
+                auto size = read_i64();
+                auto usage = read_enum();
+                glNamedBufferData(name, size, reader.read_data(), usage);
+                break;
+            }
+
+            case GLOp::NamedBufferSubData:
+            case GLOp::MappedWrite:
+            {
+                auto name = buffer();
+                auto offset = read_i64();
+                auto data = reader.read_blob();
+                glNamedBufferSubData(name, offset, data.size(), data.data());
+                break;
+            }
+
+            case GLOp::DeleteBuffers:
+                destroy(buffers_, glDeleteBuffers);
+                break;
+
+            case GLOp::CreateVertexArrays:
+                create(vertex_arrays_, glCreateVertexArrays);
+                break;
+
+            case GLOp::VertexArrayVertexBuffer:
+            {
+                auto vao = vertex_array();
+                auto binding = reader.read<GLuint>();
+                auto vbo = buffer();
+                auto offset = read_i64();
+                auto stride = reader.read<GLsizei>();
+                glVertexArrayVertexBuffer(vao, binding, vbo, offset, stride);
+                break;
+            }
+
+            case GLOp::VertexArrayElementBuffer:
+            {
+                auto vao = vertex_array();
+                glVertexArrayElementBuffer(vao, buffer());
+                break;
+            }
+
+            case GLOp::EnableVertexArrayAttrib:
+            {
+                auto vao = vertex_array();
+                glEnableVertexArrayAttrib(vao, reader.read<GLuint>());
+                break;
+            }
+
+            case GLOp::VertexArrayAttribFormat:
+            {
+                auto vao = vertex_array();
+                auto attrib = reader.read<GLuint>();
+                auto size = read_int();
+                auto type = read_enum();
+                auto normalised = reader.read<GLboolean>();
+                auto relative_offset = reader.read<GLuint>();
+                glVertexArrayAttribFormat(vao, attrib, size, type, normalised, relative_offset);
+                break;
+            }
+
+            case GLOp::VertexArrayAttribBinding:
+            {
+                auto vao = vertex_array();
+                auto attrib = reader.read<GLuint>();
+                glVertexArrayAttribBinding(vao, attrib, reader.read<GLuint>());
+                break;
+            }
+
+            case GLOp::DeleteVertexArrays:
+                destroy(vertex_arrays_, glDeleteVertexArrays);
+                break;
+
+            case GLOp::CreateTextures:
+            {
+                auto target = read_enum();
+                create(textures_,
+                       [target](GLsizei n, GLuint* names) { glCreateTextures(target, n, names); });
+                break;
+            }
+
+            case GLOp::TextureStorage2D:
+            {
+                auto name = texture();
+                auto levels = reader.read<GLsizei>();
+                auto internal_format = read_enum();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                glTextureStorage2D(name, levels, internal_format, width, height);
+                break;
+            }
+
+            case GLOp::TextureStorage2DMultisample:
+            {
+                auto name = texture();
+                auto samples = reader.read<GLsizei>();
+                auto internal_format = read_enum();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto fixed_sample_locations = reader.read<GLboolean>();
+                glTextureStorage2DMultisample(name, samples, internal_format, width, height,
+                                              fixed_sample_locations);
+                break;
+            }
+
+            case GLOp::TextureStorage3D:
+            {
+                auto name = texture();
+                auto levels = reader.read<GLsizei>();
+                auto internal_format = read_enum();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto depth = reader.read<GLsizei>();
+                glTextureStorage3D(name, levels, internal_format, width, height, depth);
+                break;
+            }
+
+            case GLOp::TextureSubImage2D:
+            {
+                auto name = texture();
+                auto level = read_int();
+                auto x = read_int();
+                auto y = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto format = read_enum();
+                auto type = read_enum();
+                auto pixels = reader.read_data();
+                glTextureSubImage2D(name, level, x, y, width, height, format, type, pixels);
+                break;
+            }
+
+            case GLOp::CompressedTextureSubImage2D:
+            {
+                auto name = texture();
+                auto level = read_int();
+                auto x = read_int();
+                auto y = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto format = read_enum();
+                auto data = reader.read_blob();
+                glCompressedTextureSubImage2D(name, level, x, y, width, height, format,
+                                              static_cast<GLsizei>(data.size()), data.data());
+                break;
+            }
+
+            case GLOp::TextureSubImage3D:
+            {
+                auto name = texture();
+                auto level = read_int();
+                auto x = read_int();
+                auto y = read_int();
+                auto z = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto depth = reader.read<GLsizei>();
+                auto format = read_enum();
+                auto type = read_enum();
+                auto pixels = reader.read_data();
+                glTextureSubImage3D(name, level, x, y, z, width, height, depth, format, type,
+                                    pixels);
+                break;
+            }
+
+            case GLOp::CompressedTextureSubImage3D:
+            {
+                auto name = texture();
+                auto level = read_int();
+                auto x = read_int();
+                auto y = read_int();
+                auto z = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto depth = reader.read<GLsizei>();
+                auto format = read_enum();
+                auto data = reader.read_blob();
+                glCompressedTextureSubImage3D(name, level, x, y, z, width, height, depth, format,
+                                              static_cast<GLsizei>(data.size()), data.data());
+                break;
+            }
+
+            case GLOp::TextureParameteri:
+            {
+                auto name = texture();
+                auto parameter = read_enum();
+                glTextureParameteri(name, parameter, read_int());
+                break;
+            }
+
+            case GLOp::TextureParameterfv:
+            {
+                auto name = texture();
+                auto parameter = read_enum();
+                auto values = static_cast<const GLfloat*>(reader.read_data());
+                glTextureParameterfv(name, parameter, values);
+                break;
+            }
+
+            case GLOp::GenerateTextureMipmap:
+                glGenerateTextureMipmap(texture());
+                break;
+
+            case GLOp::DeleteTextures:
+                destroy(textures_, glDeleteTextures);
+                break;
+
+            case GLOp::CreateFramebuffers:
+                create(framebuffers_, glCreateFramebuffers);
+                break;
+
+            case GLOp::NamedFramebufferDrawBuffers:
+            {
+                auto fbo = framebuffer();
+                auto count = reader.read<GLsizei>();
+                auto buffers = static_cast<const GLenum*>(reader.read_data());
+                glNamedFramebufferDrawBuffers(fbo, count, buffers);
+                break;
+            }
+
+            case GLOp::NamedFramebufferTexture:
+            {
+                auto fbo = framebuffer();
+                auto attachment = read_enum();
+                auto name = texture();
+                glNamedFramebufferTexture(fbo, attachment, name, read_int());
+                break;
+            }
+
+            case GLOp::NamedFramebufferRenderbuffer:
+            {
+                auto fbo = framebuffer();
+                auto attachment = read_enum();
+                auto target = read_enum();
+                glNamedFramebufferRenderbuffer(fbo, attachment, target, renderbuffer());
+                break;
+            }
+
+            case GLOp::DeleteFramebuffers:
+                destroy(framebuffers_, glDeleteFramebuffers);
+                break;
+
+            case GLOp::CreateRenderbuffers:
+                create(renderbuffers_, glCreateRenderbuffers);
+                break;
+
+            case GLOp::NamedRenderbufferStorage:
+            {
+                auto rbo = renderbuffer();
+                auto internal_format = read_enum();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                glNamedRenderbufferStorage(rbo, internal_format, width, height);
+                break;
+            }
+
+            case GLOp::DeleteRenderbuffers:
+                destroy(renderbuffers_, glDeleteRenderbuffers);
+                break;
+
+            case GLOp::CreateShader:
+            {
+                auto type = read_enum();
+                auto captured = reader.read<GLuint>();
+                shader_objects_[captured] = glCreateShader(type);
+                break;
+            }
+
+            case GLOp::ShaderSource:
+            {
+                auto shader = shader_object();
+                auto source = reader.read_string();
+                auto string = source.c_str();
+                glShaderSource(shader, 1, &string, nullptr);
+                break;
+            }
+
+            case GLOp::CompileShader:
+                glCompileShader(shader_object());
+                break;
+
+            case GLOp::CreateProgram:
+                shader_objects_[reader.read<GLuint>()] = glCreateProgram();
+                break;
+
+            case GLOp::AttachShader:
+            {
+                auto program = shader_object();
+                glAttachShader(program, shader_object());
+                break;
+            }
+
+            case GLOp::LinkProgram:
+                glLinkProgram(shader_object());
+                break;
+
+            case GLOp::DeleteShader:
+            case GLOp::DeleteProgram:
+            {
+                auto captured = reader.read<GLuint>();
+                auto name = map(shader_objects_, captured);
+                op == GLOp::DeleteShader ? glDeleteShader(name) : glDeleteProgram(name);
+                shader_objects_.erase(captured);
+                break;
+            }
+
+            case GLOp::GetUniformLocation:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = read_int();
+                auto name = reader.read_string();
+                uniform_locations_[location_key(program, location)] =
+                    glGetUniformLocation(map(shader_objects_, program), name.c_str());
+                break;
+            }
+
+            case GLOp::UseProgram:
+                glUseProgram(shader_object());
+                break;
+
+            case GLOp::ProgramUniform1i:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = map_location(program, read_int());
+                auto value = read_int();
+                glProgramUniform1i(map(shader_objects_, program), location, value);
+                break;
+            }
+
+            case GLOp::ProgramUniform1f:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = map_location(program, read_int());
+                auto value = reader.read<GLfloat>();
+                glProgramUniform1f(map(shader_objects_, program), location, value);
+                break;
+            }
+
+            case GLOp::ProgramUniform2fv:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = map_location(program, read_int());
+                auto count = reader.read<GLsizei>();
+                auto values = static_cast<const GLfloat*>(reader.read_data());
+                glProgramUniform2fv(map(shader_objects_, program), location, count, values);
+                break;
+            }
+
+            case GLOp::ProgramUniform3fv:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = map_location(program, read_int());
+                auto count = reader.read<GLsizei>();
+                auto values = static_cast<const GLfloat*>(reader.read_data());
+                glProgramUniform3fv(map(shader_objects_, program), location, count, values);
+                break;
+            }
+
+            case GLOp::ProgramUniformMatrix4fv:
+            {
+                auto program = reader.read<GLuint>();
+                auto location = map_location(program, read_int());
+                auto count = reader.read<GLsizei>();
+                auto transpose = reader.read<GLboolean>();
+                auto values = static_cast<const GLfloat*>(reader.read_data());
+                glProgramUniformMatrix4fv(map(shader_objects_, program), location, count,
+                                          transpose, values);
+                break;
+            }
+
+            case GLOp::BindTextureUnit:
+            {
+                auto unit = reader.read<GLuint>();
+                glBindTextureUnit(unit, texture());
+                break;
+            }
+
+            case GLOp::BindVertexArray:
+                glBindVertexArray(vertex_array());
+                break;
+
+            case GLOp::BindFramebuffer:
+            {
+                auto target = read_enum();
+                auto captured = reader.read<GLuint>();
+                glBindFramebuffer(target,
+                                  captured == 0 ? default_fbo_ : map(framebuffers_, captured));
+                break;
+            }
+
+            case GLOp::BindBufferBase:
+            {
+                auto target = read_enum();
+                auto index = reader.read<GLuint>();
+                glBindBufferBase(target, index, buffer());
+                break;
+            }
+
+            case GLOp::BindBufferRange:
+            {
+                auto target = read_enum();
+                auto index = reader.read<GLuint>();
+                auto name = buffer();
+                auto offset = read_i64();
+                auto size = read_i64();
+                glBindBufferRange(target, index, name, offset, size);
+                break;
+            }
+
+            case GLOp::Enable:
+                glEnable(read_enum());
+                break;
+
+            case GLOp::Disable:
+                glDisable(read_enum());
+                break;
+
+            case GLOp::CullFace:
+                glCullFace(read_enum());
+                break;
+
+            case GLOp::DepthFunc:
+                glDepthFunc(read_enum());
+                break;
+
+            case GLOp::DepthMask:
+                glDepthMask(reader.read<GLboolean>());
+                break;
+
+            case GLOp::BlendFunc:
+            {
+                auto source = read_enum();
+                glBlendFunc(source, read_enum());
+                break;
+            }
+
+            case GLOp::ColorMask:
+            {
+                auto r = reader.read<GLboolean>();
+                auto g = reader.read<GLboolean>();
+                auto b = reader.read<GLboolean>();
+                auto a = reader.read<GLboolean>();
+                glColorMask(r, g, b, a);
+                break;
+            }
+
+            case GLOp::Viewport:
+            {
+                auto x = read_int();
+                auto y = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                glViewport(x, y, width, height);
+                break;
+            }
+
+            case GLOp::ClearColor:
+            {
+                auto r = reader.read<GLfloat>();
+                auto g = reader.read<GLfloat>();
+                auto b = reader.read<GLfloat>();
+                auto a = reader.read<GLfloat>();
+                glClearColor(r, g, b, a);
+                break;
+            }
+
+            case GLOp::Clear:
+                glClear(reader.read<GLbitfield>());
+                break;
+
+            case GLOp::ClearTexSubImage:
+            {
+                auto name = texture();
+                auto level = read_int();
+                auto x = read_int();
+                auto y = read_int();
+                auto z = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto depth = reader.read<GLsizei>();
+                auto format = read_enum();
+                auto type = read_enum();
+                auto data = reader.read_data();
+                glClearTexSubImage(name, level, x, y, z, width, height, depth, format, type,
+                                   data);
+                break;
+            }
+
+            case GLOp::MemoryBarrier:
+                glMemoryBarrier(reader.read<GLbitfield>());
+                break;
+
+            case GLOp::CopyImageSubData:
+            {
+                // Renderbuffers and textures have their own names
+                auto image = [&](GLenum& target)
+                {
+                    auto name = reader.read<GLuint>();
+                    target = read_enum();
+                    return target == GL_RENDERBUFFER ? map(renderbuffers_, name)
+                                                     : map(textures_, name);
+                };
+                GLenum source_target = 0;
+                auto source = image(source_target);
+                auto source_level = read_int();
+                auto source_x = read_int();
+                auto source_y = read_int();
+                auto source_z = read_int();
+                GLenum destination_target = 0;
+                auto destination = image(destination_target);
+                auto destination_level = read_int();
+                auto destination_x = read_int();
+                auto destination_y = read_int();
+                auto destination_z = read_int();
+                auto width = reader.read<GLsizei>();
+                auto height = reader.read<GLsizei>();
+                auto depth = reader.read<GLsizei>();
+                glCopyImageSubData(source, source_target, source_level, source_x, source_y,
+                                   source_z, destination, destination_target, destination_level,
+                                   destination_x, destination_y, destination_z, width, height,
+                                   depth);
+                break;
+            }
+
+            case GLOp::DrawArrays:
+            {
+                auto mode = read_enum();
+                auto first = read_int();
+                auto count = reader.read<GLsizei>();
+                glDrawArrays(mode, first, count);
+                break;
+            }
+
+            case GLOp::DrawElements:
+            {
+                auto mode = read_enum();
+                auto count = reader.read<GLsizei>();
+                auto type = read_enum();
+                auto offset = read_i64();
+                glDrawElements(mode, count, type, to_offset(offset));
+                break;
+            }
+
+            case GLOp::DrawElementsInstanced:
+            {
+                auto mode = read_enum();
+                auto count = reader.read<GLsizei>();
+                auto type = read_enum();
+                auto offset = read_i64();
+                auto instances = reader.read<GLsizei>();
+                glDrawElementsInstanced(mode, count, type, to_offset(offset), instances);
+                break;
+            }
+
+            case GLOp::EndFrame:
+                if (on_frame_end)
+                {
+                    on_frame_end();
+                }
+                break;
+
+            default:
+                std::cerr << "Unknown command " << static_cast<int>(op) << " in capture.\n";
+                return false;
+        }
+    }
+
+    if (reader.failed())
+    {
+        std::cerr << "Capture ended part way through a command.\n";
+        return false;
+    }
+    return true;
+}
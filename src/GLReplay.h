@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GLCapture.h"
+
+/**
+    Plays back a capture written by GLCapture.
+
+    Object names and uniform locations are remapped to the ones created during playback, and
+    "framebuffer 0" is redirected to an offscreen framebuffer the size of the captured default
+    framebuffer, so it plays back with a headless context.
+*/
+class GLReplay
+{
+  public:
+    GLReplay() = default;
+    GLReplay(GLReplay&& other) noexcept = delete;
+    GLReplay(const GLReplay& other) = delete;
+    GLReplay& operator=(GLReplay&& other) noexcept = delete;
+    GLReplay& operator=(const GLReplay& other) = delete;
+    ~GLReplay();
+
+    bool load_from_file(const fs::path& path);
+
+    /// Creates every resource, must be called once before play_frames()
+    bool run_setup();
+
+    /// Resets the state to how it was at the start of the capture and plays every frame,
+    /// calling on_frame_end after each
+    bool play_frames(const std::function<void()>& on_frame_end);
+
+    const GLCaptureHeader& header() const;
+    std::size_t commands_per_loop() const;
+
+  private:
+    bool execute(const std::vector<std::byte>& stream,
+                 const std::function<void()>& on_frame_end);
+
+    GLuint map(const std::unordered_map<GLuint, GLuint>& names, GLuint name) const;
+    GLint map_location(GLuint program, GLint location) const;
+
+    GLCaptureHeader header_;
+    std::vector<std::byte> setup_;
+    std::vector<std::byte> state_;
+    std::vector<std::byte> frames_;
+
+    std::unordered_map<GLuint, GLuint> buffers_;
+    std::unordered_map<GLuint, GLuint> vertex_arrays_;
+    std::unordered_map<GLuint, GLuint> textures_;
+    std::unordered_map<GLuint, GLuint> framebuffers_;
+    std::unordered_map<GLuint, GLuint> renderbuffers_;
+
+    // Shaders and programs share one namespace
+    std::unordered_map<GLuint, GLuint> shader_objects_;
+    std::unordered_map<std::uint64_t, GLint> uniform_locations_;
+
+    // Stands in for the default framebuffer
+    GLuint default_fbo_ = 0;
+    GLuint default_colour_ = 0;
+    GLuint default_depth_ = 0;
+
+    std::size_t commands_ = 0;
+};
@@ -0,0 +1,652 @@
+#include "GLStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "GLHooks.h"
+
+namespace
+{
+    using Hooks = GLHooks::Layer<struct StatsTag>;
+
+    constexpr GLuint UNKNOWN = std::numeric_limits<GLuint>::max();
+    constexpr std::size_t MAX_TEXTURE_UNITS = 32;
+
+    struct BufferRange
+    {
+        GLuint buffer = UNKNOWN;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+
+        bool operator==(const BufferRange&) const = default;
+    };
+
+    /// The GL state as last set through the wrappers, UNKNOWN until first seen
+    struct TrackedState
+    {
+        GLuint program = UNKNOWN;
+        GLuint vertex_array = UNKNOWN;
+        GLuint draw_framebuffer = UNKNOWN;
+        GLuint read_framebuffer = UNKNOWN;
+
+        GLuint active_unit = 0;
+        std::array<GLuint, MAX_TEXTURE_UNITS> textures;
+
+        std::unordered_map<GLenum, bool> capabilities;
+        std::unordered_map<GLenum, GLuint> buffers;
+        std::map<std::pair<GLenum, GLuint>, BufferRange> indexed_buffers;
+
+        // Last value uploaded to each (program, location), uniforms are at most a mat4
+        std::unordered_map<std::uint64_t, std::array<std::byte, 64>> uniforms;
+
+        TrackedState()
+        {
+            textures.fill(UNKNOWN);
+        }
+    };
+
+    bool enabled = false;
+    TrackedState tracked;
+
+    GLFrameStats current;
+    GLFrameStats last;
+    std::vector<std::size_t> pass_stack;
+
+    GLCallCounters& pass_counters()
+    {
+        if (current.passes.empty())
+        {
+            current.passes.push_back({"Other", {}});
+        }
+        return current.passes[pass_stack.empty() ? 0 : pass_stack.back()].counters;
+    }
+
+    void count(GLCallType type, bool redundant = false)
+    {
+        // The wrappers can outlive set_enabled(false) when another layer was installed on top
+        if (!enabled)
+        {
+            return;
+        }
+        auto& counters = pass_counters();
+        auto index = static_cast<std::size_t>(type);
+        counters.calls[index]++;
+        if (redundant)
+        {
+            counters.redundant[index]++;
+        }
+    }
+
+    void count_upload(GLCallType type, GLsizeiptr bytes)
+    {
+        count(type);
+        if (!enabled)
+        {
+            return;
+        }
+        pass_counters().upload_bytes += static_cast<std::uint64_t>(std::max<GLsizeiptr>(bytes, 0));
+    }
+
+    /// Updates the tracked value, returning true if it was already set to the new value
+    template <typename T>
+    bool set_tracked(T& tracked_value, const T& value)
+    {
+        bool same = tracked_value == value;
+        tracked_value = value;
+        return same;
+    }
+
+    bool set_uniform(GLuint program, GLint location, const void* data, std::size_t size)
+    {
+        if (program == UNKNOWN || location < 0)
+        {
+            return false;
+        }
+        std::array<std::byte, 64> value{};
+        std::memcpy(value.data(), data, std::min(size, value.size()));
+
+        auto key = (static_cast<std::uint64_t>(program) << 32) | static_cast<GLuint>(location);
+        auto [itr, inserted] = tracked.uniforms.try_emplace(key, value);
+        return !inserted && set_tracked(itr->second, value);
+    }
+
+    bool set_texture(GLuint unit, GLuint texture)
+    {
+        return unit < MAX_TEXTURE_UNITS && set_tracked(tracked.textures[unit], texture);
+    }
+
+    bool set_capability(GLenum capability, bool value)
+    {
+        auto [itr, inserted] = tracked.capabilities.try_emplace(capability, value);
+        return !inserted && set_tracked(itr->second, value);
+    }
+
+    void set_hooks(bool install)
+    {
+        // Draws
+        Hooks::set_hook<glad_glDrawArrays>(
+            install,
+            [](GLenum mode, GLint first, GLsizei count_)
+            {
+                count(GLCallType::Draw);
+                Hooks::call_original<glad_glDrawArrays>(mode, first, count_);
+            });
+        Hooks::set_hook<glad_glDrawArraysInstanced>(
+            install,
+            [](GLenum mode, GLint first, GLsizei count_, GLsizei instances)
+            {
+                count(GLCallType::Draw);
+                Hooks::call_original<glad_glDrawArraysInstanced>(mode, first, count_, instances);
+            });
+        Hooks::set_hook<glad_glDrawElements>(
+            install,
+            [](GLenum mode, GLsizei count_, GLenum type, const void* indices)
+            {
+                count(GLCallType::Draw);
+                Hooks::call_original<glad_glDrawElements>(mode, count_, type, indices);
+            });
+        Hooks::set_hook<glad_glDrawElementsInstanced>(
+            install,
+            [](GLenum mode, GLsizei count_, GLenum type, const void* indices, GLsizei instances)
+            {
+                count(GLCallType::Draw);
+                Hooks::call_original<glad_glDrawElementsInstanced>(mode, count_, type, indices,
+                                                                   instances);
+            });
+        Hooks::set_hook<glad_glDrawElementsBaseVertex>(
+            install,
+            [](GLenum mode, GLsizei count_, GLenum type, const void* indices, GLint base_vertex)
+            {
+                count(GLCallType::Draw);
+                Hooks::call_original<glad_glDrawElementsBaseVertex>(mode, count_, type, indices,
+                                                                    base_vertex);
+            });
+        Hooks::set_hook<glad_glClear>(
+            install,
+            [](GLbitfield mask)
+            {
+                count(GLCallType::Clear);
+                Hooks::call_original<glad_glClear>(mask);
+            });
+        Hooks::set_hook<glad_glClearTexSubImage>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* data)
+            {
+                count(GLCallType::Clear);
+                Hooks::call_original<glad_glClearTexSubImage>(texture, level, x, y, z, width,
+                                                              height, depth, format, type, data);
+            });
+        Hooks::set_hook<glad_glMemoryBarrier>(
+            install,
+            [](GLbitfield barriers)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glMemoryBarrier>(barriers);
+            });
+        Hooks::set_hook<glad_glCopyImageSubData>(
+            install,
+            [](GLuint source, GLenum source_target, GLint source_level, GLint source_x,
+               GLint source_y, GLint source_z, GLuint destination, GLenum destination_target,
+               GLint destination_level, GLint destination_x, GLint destination_y,
+               GLint destination_z, GLsizei width, GLsizei height, GLsizei depth)
+            {
+                count(GLCallType::Copy);
+                Hooks::call_original<glad_glCopyImageSubData>(
+                    source, source_target, source_level, source_x, source_y, source_z,
+                    destination, destination_target, destination_level, destination_x,
+                    destination_y, destination_z, width, height, depth);
+            });
+
+        // Object binds
+        Hooks::set_hook<glad_glUseProgram>(
+            install,
+            [](GLuint program)
+            {
+                count(GLCallType::Program, set_tracked(tracked.program, program));
+                Hooks::call_original<glad_glUseProgram>(program);
+            });
+        Hooks::set_hook<glad_glBindVertexArray>(
+            install,
+            [](GLuint vertex_array)
+            {
+                count(GLCallType::VertexArray, set_tracked(tracked.vertex_array, vertex_array));
+                Hooks::call_original<glad_glBindVertexArray>(vertex_array);
+            });
+        Hooks::set_hook<glad_glBindFramebuffer>(
+            install,
+            [](GLenum target, GLuint framebuffer)
+            {
+                bool redundant = true;
+                if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+                {
+                    redundant &= set_tracked(tracked.draw_framebuffer, framebuffer);
+                }
+                if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+                {
+                    redundant &= set_tracked(tracked.read_framebuffer, framebuffer);
+                }
+                count(GLCallType::Framebuffer, redundant);
+                Hooks::call_original<glad_glBindFramebuffer>(target, framebuffer);
+            });
+
+        // Textures, only one texture per unit is tracked rather than one per target
+        Hooks::set_hook<glad_glBindTextureUnit>(
+            install,
+            [](GLuint unit, GLuint texture)
+            {
+                count(GLCallType::Texture, set_texture(unit, texture));
+                Hooks::call_original<glad_glBindTextureUnit>(unit, texture);
+            });
+        Hooks::set_hook<glad_glBindTexture>(
+            install,
+            [](GLenum target, GLuint texture)
+            {
+                count(GLCallType::Texture, set_texture(tracked.active_unit, texture));
+                Hooks::call_original<glad_glBindTexture>(target, texture);
+            });
+        Hooks::set_hook<glad_glActiveTexture>(
+            install,
+            [](GLenum texture)
+            {
+                count(GLCallType::State, set_tracked(tracked.active_unit, texture - GL_TEXTURE0));
+                Hooks::call_original<glad_glActiveTexture>(texture);
+            });
+
+        // Buffer binds
+        Hooks::set_hook<glad_glBindBuffer>(
+            install,
+            [](GLenum target, GLuint buffer)
+            {
+                auto [itr, inserted] = tracked.buffers.try_emplace(target, buffer);
+                count(GLCallType::Buffer, !inserted && set_tracked(itr->second, buffer));
+                Hooks::call_original<glad_glBindBuffer>(target, buffer);
+            });
+        Hooks::set_hook<glad_glBindBufferBase>(
+            install,
+            [](GLenum target, GLuint index, GLuint buffer)
+            {
+                BufferRange range{buffer, 0, -1};
+                auto& binding = tracked.indexed_buffers[{target, index}];
+                count(GLCallType::Buffer, set_tracked(binding, range));
+                Hooks::call_original<glad_glBindBufferBase>(target, index, buffer);
+            });
+        Hooks::set_hook<glad_glBindBufferRange>(
+            install,
+            [](GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+            {
+                BufferRange range{buffer, offset, size};
+                auto& binding = tracked.indexed_buffers[{target, index}];
+                count(GLCallType::Buffer, set_tracked(binding, range));
+                Hooks::call_original<glad_glBindBufferRange>(target, index, buffer, offset, size);
+            });
+
+        // Uniforms
+        Hooks::set_hook<glad_glProgramUniform1i>(
+            install,
+            [](GLuint program, GLint location, GLint v0)
+            {
+                count(GLCallType::Uniform, set_uniform(program, location, &v0, sizeof(v0)));
+                Hooks::call_original<glad_glProgramUniform1i>(program, location, v0);
+            });
+        Hooks::set_hook<glad_glProgramUniform1f>(
+            install,
+            [](GLuint program, GLint location, GLfloat v0)
+            {
+                count(GLCallType::Uniform, set_uniform(program, location, &v0, sizeof(v0)));
+                Hooks::call_original<glad_glProgramUniform1f>(program, location, v0);
+            });
+        Hooks::set_hook<glad_glProgramUniform2fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count_, const GLfloat* value)
+            {
+                bool redundant =
+                    count_ == 1 && set_uniform(program, location, value, sizeof(GLfloat) * 2);
+                count(GLCallType::Uniform, redundant);
+                Hooks::call_original<glad_glProgramUniform2fv>(program, location, count_, value);
+            });
+        Hooks::set_hook<glad_glProgramUniform3fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count_, const GLfloat* value)
+            {
+                bool redundant =
+                    count_ == 1 && set_uniform(program, location, value, sizeof(GLfloat) * 3);
+                count(GLCallType::Uniform, redundant);
+                Hooks::call_original<glad_glProgramUniform3fv>(program, location, count_, value);
+            });
+        Hooks::set_hook<glad_glProgramUniformMatrix4fv>(
+            install,
+            [](GLuint program, GLint location, GLsizei count_, GLboolean transpose,
+               const GLfloat* value)
+            {
+                bool redundant =
+                    count_ == 1 && set_uniform(program, location, value, sizeof(GLfloat) * 16);
+                count(GLCallType::Uniform, redundant);
+                Hooks::call_original<glad_glProgramUniformMatrix4fv>(program, location, count_,
+                                                                     transpose, value);
+            });
+        Hooks::set_hook<glad_glUniform1i>(
+            install,
+            [](GLint location, GLint v0)
+            {
+                count(GLCallType::Uniform, set_uniform(tracked.program, location, &v0, sizeof(v0)));
+                Hooks::call_original<glad_glUniform1i>(location, v0);
+            });
+        Hooks::set_hook<glad_glUniformMatrix4fv>(
+            install,
+            [](GLint location, GLsizei count_, GLboolean transpose, const GLfloat* value)
+            {
+                bool redundant = count_ == 1 && set_uniform(tracked.program, location, value,
+                                                            sizeof(GLfloat) * 16);
+                count(GLCallType::Uniform, redundant);
+                Hooks::call_original<glad_glUniformMatrix4fv>(location, count_, transpose, value);
+            });
+
+        // Uploads
+        Hooks::set_hook<glad_glBufferData>(
+            install,
+            [](GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+            {
+                count_upload(GLCallType::BufferUpload, data ? size : 0);
+                Hooks::call_original<glad_glBufferData>(target, size, data, usage);
+            });
+        Hooks::set_hook<glad_glBufferSubData>(
+            install,
+            [](GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+            {
+                count_upload(GLCallType::BufferUpload, size);
+                Hooks::call_original<glad_glBufferSubData>(target, offset, size, data);
+            });
+        Hooks::set_hook<glad_glNamedBufferData>(
+            install,
+            [](GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+            {
+                count_upload(GLCallType::BufferUpload, data ? size : 0);
+                Hooks::call_original<glad_glNamedBufferData>(buffer, size, data, usage);
+            });
+        Hooks::set_hook<glad_glNamedBufferSubData>(
+            install,
+            [](GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+            {
+                count_upload(GLCallType::BufferUpload, size);
+                Hooks::call_original<glad_glNamedBufferSubData>(buffer, offset, size, data);
+            });
+        Hooks::set_hook<glad_glTexImage2D>(
+            install,
+            [](GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+               GLint border, GLenum format, GLenum type, const void* pixels)
+            {
+                auto bytes = pixels ? GLHooks::pixel_data_size(width, height, format, type) : 0;
+                count_upload(GLCallType::TextureUpload, static_cast<GLsizeiptr>(bytes));
+                Hooks::call_original<glad_glTexImage2D>(target, level, internal_format, width,
+                                                        height, border, format, type, pixels);
+            });
+        Hooks::set_hook<glad_glTextureSubImage2D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+               GLenum format, GLenum type, const void* pixels)
+            {
+                auto bytes = GLHooks::pixel_data_size(width, height, format, type);
+                count_upload(GLCallType::TextureUpload, static_cast<GLsizeiptr>(bytes));
+                Hooks::call_original<glad_glTextureSubImage2D>(texture, level, x, y, width, height,
+                                                               format, type, pixels);
+            });
+        Hooks::set_hook<glad_glCompressedTextureSubImage2D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+               GLenum format, GLsizei image_size, const void* data)
+            {
+                count_upload(GLCallType::TextureUpload, image_size);
+                Hooks::call_original<glad_glCompressedTextureSubImage2D>(
+                    texture, level, x, y, width, height, format, image_size, data);
+            });
+        Hooks::set_hook<glad_glTextureSubImage3D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+            {
+                auto bytes = GLHooks::pixel_data_size(width, height, format, type) *
+                             static_cast<std::size_t>(depth);
+                count_upload(GLCallType::TextureUpload, static_cast<GLsizeiptr>(bytes));
+                Hooks::call_original<glad_glTextureSubImage3D>(texture, level, x, y, z, width,
+                                                               height, depth, format, type,
+                                                               pixels);
+            });
+        Hooks::set_hook<glad_glCompressedTextureSubImage3D>(
+            install,
+            [](GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width,
+               GLsizei height, GLsizei depth, GLenum format, GLsizei image_size, const void* data)
+            {
+                count_upload(GLCallType::TextureUpload, image_size);
+                Hooks::call_original<glad_glCompressedTextureSubImage3D>(
+                    texture, level, x, y, z, width, height, depth, format, image_size, data);
+            });
+
+        // Fixed function state
+        Hooks::set_hook<glad_glEnable>(
+            install,
+            [](GLenum capability)
+            {
+                count(GLCallType::State, set_capability(capability, true));
+                Hooks::call_original<glad_glEnable>(capability);
+            });
+        Hooks::set_hook<glad_glDisable>(
+            install,
+            [](GLenum capability)
+            {
+                count(GLCallType::State, set_capability(capability, false));
+                Hooks::call_original<glad_glDisable>(capability);
+            });
+        Hooks::set_hook<glad_glCullFace>(
+            install,
+            [](GLenum mode)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glCullFace>(mode);
+            });
+        Hooks::set_hook<glad_glBlendFunc>(
+            install,
+            [](GLenum source, GLenum destination)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glBlendFunc>(source, destination);
+            });
+        Hooks::set_hook<glad_glViewport>(
+            install,
+            [](GLint x, GLint y, GLsizei width, GLsizei height)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glViewport>(x, y, width, height);
+            });
+        Hooks::set_hook<glad_glScissor>(
+            install,
+            [](GLint x, GLint y, GLsizei width, GLsizei height)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glScissor>(x, y, width, height);
+            });
+        Hooks::set_hook<glad_glBlendFuncSeparate>(
+            install,
+            [](GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glBlendFuncSeparate>(src_rgb, dst_rgb, src_alpha,
+                                                               dst_alpha);
+            });
+        Hooks::set_hook<glad_glBlendEquation>(
+            install,
+            [](GLenum mode)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glBlendEquation>(mode);
+            });
+        Hooks::set_hook<glad_glPolygonMode>(
+            install,
+            [](GLenum face, GLenum mode)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glPolygonMode>(face, mode);
+            });
+        Hooks::set_hook<glad_glBindSampler>(
+            install,
+            [](GLuint unit, GLuint sampler)
+            {
+                count(GLCallType::State);
+                Hooks::call_original<glad_glBindSampler>(unit, sampler);
+            });
+    }
+} // namespace
+
+const char* to_string(GLCallType type)
+{
+    switch (type)
+    {
+        case GLCallType::Draw:
+            return "Draws";
+        case GLCallType::Clear:
+            return "Clears";
+        case GLCallType::Copy:
+            return "Copies";
+        case GLCallType::Program:
+            return "Program binds";
+        case GLCallType::Texture:
+            return "Texture binds";
+        case GLCallType::VertexArray:
+            return "VAO binds";
+        case GLCallType::Framebuffer:
+            return "FBO binds";
+        case GLCallType::Buffer:
+            return "Buffer binds";
+        case GLCallType::Uniform:
+            return "Uniforms";
+        case GLCallType::BufferUpload:
+            return "Buffer uploads";
+        case GLCallType::TextureUpload:
+            return "Texture uploads";
+        case GLCallType::State:
+            return "State changes";
+        case GLCallType::Count:
+            break;
+    }
+    return "Unknown";
+}
+
+std::uint32_t GLCallCounters::total_calls() const
+{
+    std::uint32_t total = 0;
+    for (auto c : calls)
+    {
+        total += c;
+    }
+    return total;
+}
+
+std::uint32_t GLCallCounters::total_redundant() const
+{
+    std::uint32_t total = 0;
+    for (auto r : redundant)
+    {
+        total += r;
+    }
+    return total;
+}
+
+GLCallCounters& GLCallCounters::operator+=(const GLCallCounters& other)
+{
+    for (std::size_t i = 0; i < TYPES; i++)
+    {
+        calls[i] += other.calls[i];
+        redundant[i] += other.redundant[i];
+    }
+    upload_bytes += other.upload_bytes;
+    mapped_bytes += other.mapped_bytes;
+    return *this;
+}
+
+namespace GLStats
+{
+    void set_enabled(bool enable)
+    {
+        if (enable == enabled)
+        {
+            return;
+        }
+
+        // Anything could have changed while the layer was off
+        enabled = enable;
+        tracked = {};
+        current = {};
+        pass_stack.clear();
+        set_hooks(enable);
+    }
+
+    bool is_enabled()
+    {
+        return enabled;
+    }
+
+    void begin_pass(const char* name)
+    {
+        if (!enabled)
+        {
+            return;
+        }
+        pass_counters();
+
+        auto itr = std::find_if(current.passes.begin(), current.passes.end(),
+                                [name](auto& pass) { return std::strcmp(pass.name, name) == 0; });
+        if (itr == current.passes.end())
+        {
+            current.passes.push_back({name, {}});
+            itr = current.passes.end() - 1;
+        }
+        pass_stack.push_back(itr - current.passes.begin());
+    }
+
+    void end_pass()
+    {
+        if (enabled && !pass_stack.empty())
+        {
+            pass_stack.pop_back();
+        }
+    }
+
+    void record_mapped_upload(std::uint64_t bytes)
+    {
+        if (enabled)
+        {
+            pass_counters().mapped_bytes += bytes;
+        }
+    }
+
+    void end_frame()
+    {
+        last = std::move(current);
+        current = {};
+        for (auto& pass : last.passes)
+        {
+            last.total += pass.counters;
+        }
+
+        // Passes open across the end of the frame carry on into the next
+        if (enabled)
+        {
+            auto open = std::move(pass_stack);
+            pass_stack.clear();
+            for (auto index : open)
+            {
+                begin_pass(last.passes[index].name);
+            }
+        }
+    }
+
+    const GLFrameStats& last_frame()
+    {
+        return last;
+    }
+} // namespace GLStats
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class GLCallType
+{
+    Draw,
+    Clear,
+    Copy,
+    Program,
+    Texture,
+    VertexArray,
+    Framebuffer,
+    Buffer,
+    Uniform,
+    BufferUpload,
+    TextureUpload,
+    State,
+
+    Count
+};
+
+const char* to_string(GLCallType type);
+
+struct GLCallCounters
+{
+    static constexpr auto TYPES = static_cast<std::size_t>(GLCallType::Count);
+
+    std::array<std::uint32_t, TYPES> calls{};
+
+    // Calls that did not change anything, eg binding the texture that was already bound
+    std::array<std::uint32_t, TYPES> redundant{};
+
+    // Bytes passed to glBufferData/glTextureSubImage2D etc, and bytes written to mapped buffers
+    std::uint64_t upload_bytes = 0;
+    std::uint64_t mapped_bytes = 0;
+
+    std::uint32_t count(GLCallType type) const
+    {
+        return calls[static_cast<std::size_t>(type)];
+    }
+
+    std::uint32_t redundant_count(GLCallType type) const
+    {
+        return redundant[static_cast<std::size_t>(type)];
+    }
+
+    std::uint32_t total_calls() const;
+    std::uint32_t total_redundant() const;
+
+    GLCallCounters& operator+=(const GLCallCounters& other);
+};
+
+struct GLPassStats
+{
+    const char* name = "";
+    GLCallCounters counters;
+};
+
+struct GLFrameStats
+{
+    GLCallCounters total;
+
+    // In the order the passes first appeared in the frame, calls made outside of any pass are
+    // counted in the first pass
+    std::vector<GLPassStats> passes;
+};
+
+/**
+    Optional instrumentation around the glad entry points used by the renderer (and ImGui).
+
+    Enabling swaps the glad function pointers for wrappers that count each call and track enough
+    state to spot redundant calls, disabling puts the original pointers back so it costs nothing.
+    Calls are attributed to the innermost pass, which the profiler's GPU zones open and close.
+
+    State changes made by entry points that are not wrapped (or before the layer was enabled)
+    are not seen, so the redundant counts are a close estimate rather than exact.
+    Render thread only, and the OpenGL context must be current.
+*/
+namespace GLStats
+{
+    void set_enabled(bool enabled);
+    bool is_enabled();
+
+    void begin_pass(const char* name);
+    void end_pass();
+
+    /// For writes into persistently mapped buffers, which never go through an entry point
+    void record_mapped_upload(std::uint64_t bytes);
+
+    /// Finishes the frame's counters, they can then be read with last_frame()
+    void end_frame();
+    const GLFrameStats& last_frame();
+} // namespace GLStats
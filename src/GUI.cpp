@@ -1,9 +1,17 @@
 #include "GUI.h"
 
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
 #include <imgui.h>
 #include <imgui_sfml/imgui-SFML.h>
 #include <imgui_sfml/imgui_impl_opengl3.h>
 
+#include "Benchmark.h"
+#include "GLCapture.h"
+#include "GLStats.h"
+#include "Profiler.h"
 #include "Util.h"
 
 namespace
@@ -23,30 +31,111 @@ namespace
         ImGui::SliderFloat("Attenuation Quadratic", &attenuation.exponant, 0.000007f, 0.03f,
                            "%.6f");
     }
+
+    constexpr float FLAME_ROW_HEIGHT = 18.0f;
+
+    ImU32 zone_colour(const char* name)
+    {
+        // Stable colour per zone name so zones are easy to follow between frames
+        auto hash = std::hash<std::string_view>{}(name);
+        auto r = static_cast<ImU32>(100 + (hash & 0x7F));
+        auto g = static_cast<ImU32>(100 + ((hash >> 8) & 0x7F));
+        auto b = static_cast<ImU32>(100 + ((hash >> 16) & 0x7F));
+        return IM_COL32(r, g, b, 255);
+    }
+
+    /// Draws each thread as a lane of rows, one row per zone depth
+    void flame_graph(const ProfilerFrame& frame)
+    {
+        auto threads = Profiler::threads();
+
+        std::uint64_t end_ns = frame.end_ns;
+        for (auto& zone : frame.zones)
+        {
+            end_ns = std::max(end_ns, zone.end_ns);
+        }
+        auto span_ns = static_cast<float>(std::max<std::uint64_t>(end_ns - frame.start_ns, 1));
+
+        auto draw_list = ImGui::GetWindowDrawList();
+        auto origin = ImGui::GetCursorScreenPos();
+        auto width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+
+        float y = origin.y;
+        for (auto& thread : threads)
+        {
+            int max_depth = -1;
+            for (auto& zone : frame.zones)
+            {
+                if (zone.thread_id == thread.id)
+                {
+                    max_depth = std::max(max_depth, static_cast<int>(zone.depth));
+                }
+            }
+            if (max_depth < 0)
+            {
+                continue;
+            }
+
+            draw_list->AddText({origin.x, y}, IM_COL32(255, 255, 255, 255), thread.name.c_str());
+            y += ImGui::GetTextLineHeight();
+
+            for (auto& zone : frame.zones)
+            {
+                if (zone.thread_id != thread.id || zone.end_ns < frame.start_ns)
+                {
+                    continue;
+                }
+                auto start = std::max(zone.start_ns, frame.start_ns) - frame.start_ns;
+                auto end = zone.end_ns - frame.start_ns;
+                auto x0 = origin.x + static_cast<float>(start) / span_ns * width;
+                auto x1 = origin.x + static_cast<float>(end) / span_ns * width;
+                auto y0 = y + zone.depth * FLAME_ROW_HEIGHT;
+                ImVec2 min{x0, y0};
+                ImVec2 max{std::max(x1, x0 + 1.0f), y0 + FLAME_ROW_HEIGHT - 1.0f};
+
+                draw_list->AddRectFilled(min, max, zone_colour(zone.name));
+                draw_list->PushClipRect(min, max, true);
+                draw_list->AddText({x0 + 2.0f, y0 + 1.0f}, IM_COL32(0, 0, 0, 255), zone.name);
+                draw_list->PopClipRect();
+
+                if (ImGui::IsMouseHoveringRect(min, max))
+                {
+                    ImGui::SetTooltip("%s: %.3fms", zone.name, zone.duration_ms());
+                }
+            }
+            y += (max_depth + 1) * FLAME_ROW_HEIGHT + 4.0f;
+        }
+        ImGui::Dummy({width, y - origin.y});
+    }
 }
 
 namespace GUI
 {
     void init(sf::Window* window)
     {
+        // ImGui is not part of GL captures, see GLCapture
+        GLCapture::ExcludeScope exclude_from_capture;
         ImGui::SFML::Init(*window, cast_vector<float>(window->getSize()));
         ImGui_ImplOpenGL3_Init();
     }
 
     void begin_frame()
     {
+        GLCapture::ExcludeScope exclude_from_capture;
         ImGui_ImplOpenGL3_NewFrame();
         ImGui::NewFrame();
     }
 
     void shutdown()
     {
+        GLCapture::ExcludeScope exclude_from_capture;
         ImGui_ImplOpenGL3_Shutdown();
         ImGui::SFML::Shutdown();
     }
 
     void render()
     {
+        GLCapture::ExcludeScope exclude_from_capture;
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
@@ -72,6 +161,8 @@ namespace GUI
 
             ImGui::Separator();
             ImGui::Checkbox("Grass ground?", &settings.grass);
+            ImGui::Checkbox("Deferred shading", &settings.deferred);
+            ImGui::Checkbox("Shadows", &settings.shadows);
 
             ImGui::Separator();
 
@@ -88,6 +179,7 @@ namespace GUI
 
             ImGui::PushID("PointLight");
             ImGui::Text("Point light");
+            ImGui::SliderFloat("Range", &settings.point_light.range, 1.0f, 64.0f);
             base_light_widgets(settings.point_light);
             attenuation_widgets(settings.point_light.att);
             ImGui::PopID();
@@ -106,4 +198,398 @@ namespace GUI
         ImGui::End();
     }
 
-} // namespace GUI
\ No newline at end of file
+    void stream_buffer_stats(const StreamBufferStats& stats)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Stream buffer");
+            ImGui::Text("Segment usage: %lld / %lld bytes (peak %lld)",
+                        static_cast<long long>(stats.last_frame_usage),
+                        static_cast<long long>(stats.segment_size),
+                        static_cast<long long>(stats.peak_frame_usage));
+            ImGui::Text("Fence waits: %llu / %llu frames (%.3fms total)",
+                        static_cast<unsigned long long>(stats.fence_waits),
+                        static_cast<unsigned long long>(stats.frames), stats.fence_wait_ms);
+            ImGui::Text("Failed allocations: %llu",
+                        static_cast<unsigned long long>(stats.failed_allocations));
+        }
+        ImGui::End();
+    }
+
+    void render_scale_settings(RenderScaleGovernor& governor, GLsizei render_width,
+                               GLsizei render_height)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Render scale");
+            ImGui::Text("Rendering at %dx%d (%.0f%%), frame time %.2fms", render_width,
+                        render_height, governor.scale() * 100.0f, governor.smoothed_frame_ms());
+
+            ImGui::Checkbox("Dynamic resolution", &governor.enabled);
+            if (governor.enabled)
+            {
+                if (!Profiler::is_enabled())
+                {
+                    ImGui::Text("Needs the profiler enabled for the GPU frame times");
+                }
+                ImGui::SliderFloat("Target frame time", &governor.target_frame_ms, 4.0f, 50.0f,
+                                   "%.1fms");
+                ImGui::SliderFloat("Min scale", &governor.min_scale,
+                                   RenderScaleGovernor::MIN_SCALE, governor.max_scale());
+            }
+            else
+            {
+                float scale = governor.scale();
+                if (ImGui::SliderFloat("Scale", &scale, RenderScaleGovernor::MIN_SCALE,
+                                       governor.max_scale()))
+                {
+                    governor.set_scale(scale);
+                }
+            }
+        }
+        ImGui::End();
+    }
+
+    void light_cluster_stats(const LightClusterStats& stats)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Clustered lights");
+            ImGui::Text("Lights: %zu (%zu visible)", stats.lights, stats.visible_lights);
+            ImGui::Text("Lights per cluster: %.2f average, %u max", stats.average_cluster_lights,
+                        stats.max_cluster_lights);
+            ImGui::Text("Light indices: %zu", stats.light_indices);
+            if (stats.dropped_indices > 0)
+            {
+                ImGui::Text("Dropped: %zu (clusters full, lower the range)",
+                            stats.dropped_indices);
+            }
+        }
+        ImGui::End();
+    }
+
+    void shadow_map_stats(const ShadowMapStats& spot, const ShadowMapStats& point)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Shadow maps");
+            auto map_stats = [](const char* name, const ShadowMapStats& stats)
+            {
+                ImGui::Text("%s: %zu static, %zu moving, %zu culled", name, stats.static_casters,
+                            stats.dynamic_casters, stats.culled_casters);
+                ImGui::Text("  Cache redrawn %llu times in %llu frames",
+                            static_cast<unsigned long long>(stats.cache_redraws),
+                            static_cast<unsigned long long>(stats.frames));
+            };
+            map_stats("Flashlight", spot);
+            map_stats("Point light", point);
+        }
+        ImGui::End();
+    }
+
+    void cascade_shadow_stats(const CascadeShadowStats& stats)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Text("Moonlight cascades, %llu frames",
+                        static_cast<unsigned long long>(stats.frames));
+            for (int i = 0; i < stats.cascades; i++)
+            {
+                ImGui::Text("  %d: to %.1f, %.1f wide, %zu casters, redrawn %llu times", i,
+                            stats.split_distances[i], stats.widths[i], stats.casters[i],
+                            static_cast<unsigned long long>(stats.redraws[i]));
+            }
+        }
+        ImGui::End();
+    }
+
+    void depth_prepass_settings(PrepassTuner& tuner, bool prepass)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Depth pre-pass: %s", prepass ? "on" : "off");
+
+            int mode = static_cast<int>(tuner.mode);
+            const char* modes[] = {to_string(DepthPrepassMode::Off),
+                                   to_string(DepthPrepassMode::On),
+                                   to_string(DepthPrepassMode::Auto)};
+            if (ImGui::Combo("Pre-pass mode", &mode, modes, 3))
+            {
+                tuner.mode = static_cast<DepthPrepassMode>(mode);
+            }
+
+            if (tuner.mode == DepthPrepassMode::Auto)
+            {
+                if (!Profiler::is_enabled())
+                {
+                    ImGui::Text("Needs the profiler enabled for the GPU pass times");
+                }
+                else if (tuner.measuring())
+                {
+                    ImGui::Text("Measuring...");
+                }
+                if (tuner.with_prepass_ms() > 0.0f)
+                {
+                    ImGui::Text("Scene GPU time with: %.3fms, without: %.3fms",
+                                tuner.with_prepass_ms(), tuner.without_prepass_ms());
+                }
+            }
+        }
+        ImGui::End();
+    }
+
+    void render_target_stats(const RenderTargetPoolStats& stats)
+    {
+        auto mb = [](std::size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Render targets");
+            ImGui::Text("Textures: %zu (%.2fMB, peak %.2fMB)", stats.textures,
+                        mb(stats.allocated_bytes), mb(stats.peak_allocated_bytes));
+            ImGui::Text("In use at once: %.2fMB (peak %.2fMB)", mb(stats.frame_peak_bytes),
+                        mb(stats.peak_bytes));
+            ImGui::Text("Without sharing: %.2fMB", mb(stats.frame_requested_bytes));
+            ImGui::Text("Acquires: %llu (%llu reused)",
+                        static_cast<unsigned long long>(stats.frame_acquires),
+                        static_cast<unsigned long long>(stats.frame_reuses));
+        }
+        ImGui::End();
+    }
+
+    void texture_streaming_settings(const TextureStreamingStats& stats,
+                                    const UploadRingStats& uploads, int& budget_mb)
+    {
+        auto mb = [](std::size_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Texture streaming");
+            ImGui::Text("Resident: %.2fMB, requested: %.2fMB (%.2fMB for every level)",
+                        mb(stats.resident_bytes), mb(stats.requested_bytes),
+                        mb(stats.full_bytes));
+            if (stats.over_budget_arrays > 0)
+            {
+                ImGui::Text("Over budget, %d arrays kept coarser", stats.over_budget_arrays);
+            }
+            ImGui::Text("Arrays recreated: %llu, layers queued: %zu",
+                        static_cast<unsigned long long>(stats.rebuilds), stats.queued_uploads);
+            ImGui::SliderInt("Budget", &budget_mb, 1, 256, "%dMB");
+            ImGui::Text("Uploaded: %.2fMB last frame, %.2fMB total", mb(uploads.last_frame_bytes),
+                        mb(uploads.uploaded_bytes));
+            ImGui::Text("Upload ring: %.2fMB, %.2fMB a frame", mb(uploads.size),
+                        mb(uploads.frame_budget));
+            ImGui::Text("Frames at the upload budget: %llu, waits for the GPU: %llu",
+                        static_cast<unsigned long long>(uploads.budget_frames),
+                        static_cast<unsigned long long>(uploads.full_waits));
+        }
+        ImGui::End();
+    }
+
+    void render_graph_stats(const RenderGraph& graph)
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Render graph");
+
+            if (ImGui::BeginTable("Render passes", 5,
+                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Pass");
+                ImGui::TableSetupColumn("CPU");
+                ImGui::TableSetupColumn("GPU");
+                ImGui::TableSetupColumn("Reads");
+                ImGui::TableSetupColumn("Writes");
+                ImGui::TableHeadersRow();
+
+                auto join = [](const std::vector<std::string>& names)
+                {
+                    std::string joined;
+                    for (auto& name : names)
+                    {
+                        joined += (joined.empty() ? "" : ", ") + name;
+                    }
+                    return joined;
+                };
+
+                for (auto& pass : graph.pass_info())
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    if (pass.culled)
+                    {
+                        ImGui::TextDisabled("%s (culled)", pass.name);
+                        ImGui::TableNextColumn();
+                        ImGui::TableNextColumn();
+                    }
+                    else
+                    {
+                        ImGui::TextUnformatted(pass.name);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3fms", pass.cpu_ms);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3fms", pass.gpu_ms);
+                    }
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(join(pass.reads).c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(join(pass.writes).c_str());
+                }
+                ImGui::EndTable();
+            }
+
+            if (ImGui::Button("Dump graph"))
+            {
+                graph.write_graphviz("render_graph.dot");
+            }
+        }
+        ImGui::End();
+    }
+
+    void profiler_stats()
+    {
+        static int capture_frames = 120;
+        static bool export_pending = false;
+
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("Profiler");
+
+            bool enabled = Profiler::is_enabled();
+            if (ImGui::Checkbox("Enabled", &enabled))
+            {
+                Profiler::set_enabled(enabled);
+            }
+
+            auto& history = Profiler::history();
+            std::vector<float> cpu_times;
+            std::vector<float> gpu_times;
+            for (auto& frame : history)
+            {
+                cpu_times.push_back(frame.cpu_ms());
+                if (frame.gpu_resolved)
+                {
+                    gpu_times.push_back(frame.gpu_ms);
+                }
+            }
+
+            auto cpu = summarise_frame_times(cpu_times);
+            auto gpu = summarise_frame_times(gpu_times);
+            ImGui::Text("CPU p50 %.2fms  p95 %.2fms  p99 %.2fms", cpu.p50_ms, cpu.p95_ms,
+                        cpu.p99_ms);
+            ImGui::Text("GPU p50 %.2fms  p95 %.2fms  p99 %.2fms", gpu.p50_ms, gpu.p95_ms,
+                        gpu.p99_ms);
+            if (!cpu_times.empty())
+            {
+                ImGui::PlotLines("CPU ms", cpu_times.data(), static_cast<int>(cpu_times.size()),
+                                 0, nullptr, 0.0f, 33.3f, {0, 60});
+            }
+            if (!gpu_times.empty())
+            {
+                ImGui::PlotLines("GPU ms", gpu_times.data(), static_cast<int>(gpu_times.size()),
+                                 0, nullptr, 0.0f, 33.3f, {0, 60});
+            }
+
+            // The newest frame has no GPU times yet, so show the latest one that does
+            auto itr = std::find_if(history.rbegin(), history.rend(),
+                                    [](auto& frame) { return frame.gpu_resolved; });
+            if (itr != history.rend() && ImGui::CollapsingHeader("Flame graph"))
+            {
+                ImGui::Text("Frame %llu", static_cast<unsigned long long>(itr->frame));
+                flame_graph(*itr);
+            }
+
+            ImGui::InputInt("Capture frames", &capture_frames);
+            capture_frames = std::max(capture_frames, 1);
+            if (Profiler::is_capturing())
+            {
+                ImGui::Text("Capturing... %zu / %d", Profiler::captured_frames(),
+                            capture_frames);
+            }
+            else if (ImGui::Button("Capture trace"))
+            {
+                Profiler::start_capture(capture_frames);
+                export_pending = true;
+            }
+
+            if (export_pending && !Profiler::is_capturing())
+            {
+                Profiler::flush_gpu();
+                Profiler::export_chrome_trace("profile_trace.json");
+                export_pending = false;
+            }
+        }
+        ImGui::End();
+    }
+
+    void gl_stats()
+    {
+        if (ImGui::Begin("Debug Window"))
+        {
+            ImGui::Separator();
+            ImGui::Text("GL calls");
+
+            bool enabled = GLStats::is_enabled();
+            if (ImGui::Checkbox("Count GL calls", &enabled))
+            {
+                GLStats::set_enabled(enabled);
+            }
+
+            auto& frame = GLStats::last_frame();
+            if (enabled && !frame.passes.empty())
+            {
+                auto& total = frame.total;
+                ImGui::Text("Total: %u calls (%u redundant), %.1fKB uploaded, %.1fKB mapped",
+                            total.total_calls(), total.total_redundant(),
+                            total.upload_bytes / 1024.0, total.mapped_bytes / 1024.0);
+
+                // One row per call type, one column per pass. "calls (redundant)"
+                auto columns = static_cast<int>(frame.passes.size()) + 1;
+                if (ImGui::BeginTable("GL calls", columns,
+                                      ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+                {
+                    ImGui::TableSetupColumn("Call");
+                    for (auto& pass : frame.passes)
+                    {
+                        ImGui::TableSetupColumn(pass.name);
+                    }
+                    ImGui::TableHeadersRow();
+
+                    for (std::size_t i = 0; i < GLCallCounters::TYPES; i++)
+                    {
+                        auto type = static_cast<GLCallType>(i);
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(to_string(type));
+                        for (auto& pass : frame.passes)
+                        {
+                            ImGui::TableNextColumn();
+                            auto calls = pass.counters.count(type);
+                            auto redundant = pass.counters.redundant_count(type);
+                            if (redundant > 0)
+                            {
+                                ImGui::Text("%u (%u)", calls, redundant);
+                            }
+                            else
+                            {
+                                ImGui::Text("%u", calls);
+                            }
+                        }
+                    }
+                    ImGui::EndTable();
+                }
+            }
+        }
+        ImGui::End();
+    }
+
+} // namespace GUI
@@ -2,7 +2,17 @@
 
 #include <SFML/Window/Window.hpp>
 
+#include "CascadedShadowMap.h"
+#include "LightClusters.h"
+#include "PrepassTuner.h"
+#include "RenderGraph.h"
+#include "RenderScale.h"
+#include "RenderTargetPool.h"
 #include "Settings.h"
+#include "ShadowMap.h"
+#include "StreamBuffer.h"
+#include "TextureArrays.h"
+#include "UploadRing.h"
 
 
 namespace GUI
@@ -21,4 +31,41 @@ namespace GUI
     void debug_window(const glm::vec3& camera_position,
                       const glm::vec3& camera_rotation, Settings& settings);
 
+    void stream_buffer_stats(const StreamBufferStats& stats);
+
+    /// How many lights the clustered culling found and how they spread over the clusters
+    void light_cluster_stats(const LightClusterStats& stats);
+
+    /// Casters drawn into the flashlight's and the point light's shadow maps, and how often
+    /// their caches were redrawn
+    void shadow_map_stats(const ShadowMapStats& spot, const ShadowMapStats& point);
+
+    /// The slice of the view each of the moonlight's cascades covers, and how often each was
+    /// redrawn
+    void cascade_shadow_stats(const CascadeShadowStats& stats);
+
+    /// The current render resolution, and the render scale governor's settings
+    void render_scale_settings(RenderScaleGovernor& governor, GLsizei render_width,
+                               GLsizei render_height);
+
+    /// The depth pre-pass mode and what the tuner last measured with and without it
+    void depth_prepass_settings(PrepassTuner& tuner, bool prepass);
+
+    /// Memory used by the render target pool, and how much sharing targets saved
+    void render_target_stats(const RenderTargetPoolStats& stats);
+
+    /// The texture levels on the GPU against the levels asked for, the budget, and the uploads
+    /// through the upload ring
+    void texture_streaming_settings(const TextureStreamingStats& stats,
+                                    const UploadRingStats& uploads, int& budget_mb);
+
+    /// The passes of the last frame with their timings, and a button to dump the graph
+    void render_graph_stats(const RenderGraph& graph);
+
+    /// Frame time percentiles, a flame graph of a recent frame and trace capture
+    void profiler_stats();
+
+    /// GL calls per pass in the last frame, with a toggle for the GL stats layer
+    void gl_stats();
+
 } // namespace GUI
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "HeadlessContext.h"
+
+#include <iostream>
+
+#include <glad/glad.h>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+struct HeadlessContext::Impl
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    ~Impl()
+    {
+        if (display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT)
+            {
+                eglDestroyContext(display, context);
+            }
+            eglTerminate(display);
+        }
+    }
+
+    bool create()
+    {
+        // Prefer Mesa's surfaceless platform as it needs no X11 or Wayland display at all
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display)
+        {
+            display =
+                get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY)
+        {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        EGLint major = 0;
+        EGLint minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cerr << "Failed to initialise EGL display.\n";
+            return false;
+        }
+        std::cout << "EGL " << major << '.' << minor << " - " << eglQueryString(display, EGL_VENDOR)
+                  << '\n';
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cerr << "EGL does not support desktop OpenGL.\n";
+            return false;
+        }
+
+        // clang-format off
+        const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE,    EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION,          4,
+            EGL_CONTEXT_MINOR_VERSION,          5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        // clang-format on
+
+        EGLConfig config = nullptr;
+        EGLint config_count = 0;
+        if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) ||
+            config_count == 0)
+        {
+            std::cerr << "Failed to find an EGL config for OpenGL.\n";
+            return false;
+        }
+
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cerr << "Failed to create an OpenGL 4.5 core context.\n";
+            return false;
+        }
+
+        // No surface at all, this relies on EGL_KHR_surfaceless_context
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cerr << "Failed to make the surfaceless context current.\n";
+            return false;
+        }
+
+        return gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+    }
+};
+#else
+#include <SFML/Window/Context.hpp>
+
+struct HeadlessContext::Impl
+{
+    std::unique_ptr<sf::Context> context;
+
+    bool create()
+    {
+        sf::ContextSettings context_settings;
+        context_settings.majorVersion = 4;
+        context_settings.minorVersion = 5;
+        context_settings.attributeFlags = sf::ContextSettings::Core;
+
+        context = std::make_unique<sf::Context>(context_settings, 1, 1);
+        if (!context->setActive(true))
+        {
+            std::cerr << "Failed to activate the offscreen context.\n";
+            return false;
+        }
+        return gladLoadGL();
+    }
+};
+#endif
+
+HeadlessContext::HeadlessContext()
+    : impl_(std::make_unique<Impl>())
+{
+}
+
+HeadlessContext::~HeadlessContext() = default;
+
+bool HeadlessContext::create()
+{
+    if (!impl_->create())
+    {
+        std::cerr << "Failed to create headless OpenGL context.\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+
+/**
+    An OpenGL 4.5 core context with no window and no default framebuffer, everything must be
+    rendered into framebuffer objects.
+
+    On Linux this is an EGL surfaceless context so it works without a display server (including
+    on Mesa's llvmpipe software renderer), elsewhere it falls back to an SFML offscreen context.
+*/
+class HeadlessContext
+{
+  public:
+    HeadlessContext();
+    HeadlessContext(HeadlessContext&& other) noexcept = delete;
+    HeadlessContext(const HeadlessContext& other) = delete;
+    HeadlessContext& operator=(HeadlessContext&& other) noexcept = delete;
+    HeadlessContext& operator=(const HeadlessContext& other) = delete;
+    ~HeadlessContext();
+
+    /// Creates the context, makes it current and loads the OpenGL functions
+    bool create();
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,246 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr std::size_t CHUNK_SIZE = 1024;
+
+    // The shader fades spot lights out over this angle past their cutoff
+    constexpr float SPOT_LIGHT_EDGE = 6.0f * std::numbers::pi_v<float> / 180.0f;
+
+    /// The smallest sphere around a spot light's cone
+    glm::vec4 spot_light_bounds(const ClusterLight& light)
+    {
+        constexpr auto pi = std::numbers::pi_v<float>;
+        float angle = std::acos(glm::clamp(light.cutoff, -1.0f, 1.0f)) + SPOT_LIGHT_EDGE;
+        angle = std::min(angle, pi);
+        if (angle > pi / 4.0f)
+        {
+            // Wide cones are bounded by the circle of their base
+            return {light.position + light.direction * light.range * std::cos(angle),
+                    light.range * std::sin(angle)};
+        }
+
+        // Narrow cones by a sphere through the apex and the rim of the base
+        float radius = light.range / (2.0f * std::cos(angle));
+        return {light.position + light.direction * radius, radius};
+    }
+
+    /// Distance from a view space range of a tile to a coordinate, 0 if it is inside
+    float distance_outside(float min, float max, float value)
+    {
+        return std::max({min - value, 0.0f, value - max});
+    }
+} // namespace
+
+LightClusters::LightClusters()
+    : slices_(GRID_Z)
+    , clusters_(CLUSTER_COUNT)
+{
+    for (auto& slice : slices_)
+    {
+        slice.indices.resize(slice.counts.size() * MAX_CLUSTER_LIGHTS);
+    }
+}
+
+void LightClusters::build(const std::vector<ClusterLight>& lights, const glm::mat4& view_matrix,
+                          const glm::mat4& projection_matrix, ThreadPool& thread_pool)
+{
+    float near_plane = projection_matrix[3][2] / (projection_matrix[2][2] - 1.0f);
+    float far_plane = projection_matrix[3][2] / (projection_matrix[2][2] + 1.0f);
+    glm::vec2 projection_scale{projection_matrix[0][0], projection_matrix[1][1]};
+
+    float log_depth_range = std::log(far_plane / near_plane);
+    depth_slice_scale_bias_ = {GRID_Z / log_depth_range,
+                               -GRID_Z * std::log(near_plane) / log_depth_range};
+
+    // Bounding spheres in view space, the padding is far behind the camera so never touches a
+    // slice
+    auto padded_count = (lights.size() + 3) & ~std::size_t{3};
+    centre_x_.assign(padded_count, 0.0f);
+    centre_y_.assign(padded_count, 0.0f);
+    depth_.assign(padded_count, -1e30f);
+    radius_.assign(padded_count, 0.0f);
+    thread_pool.parallel_for(lights.size(), CHUNK_SIZE,
+                             [&](std::size_t begin, std::size_t end)
+                             {
+                                 for (auto i = begin; i < end; i++)
+                                 {
+                                     auto& light = lights[i];
+                                     auto bounds = light.cutoff > -1.0f
+                                                       ? spot_light_bounds(light)
+                                                       : glm::vec4{light.position, light.range};
+
+                                     auto centre = view_matrix *
+                                                   glm::vec4{glm::vec3{bounds}, 1.0f};
+                                     centre_x_[i] = centre.x;
+                                     centre_y_[i] = centre.y;
+                                     depth_[i] = -centre.z;
+                                     radius_[i] = bounds.w;
+                                 }
+                             });
+
+    thread_pool.parallel_for(GRID_Z, 1,
+                             [&](std::size_t begin, std::size_t end)
+                             {
+                                 for (auto z = begin; z < end; z++)
+                                 {
+                                     build_slice(static_cast<int>(z), near_plane, far_plane,
+                                                 projection_scale);
+                                 }
+                             });
+
+    // Compact the fixed size lists of every slice into the one index list the shader reads
+    stats_ = {};
+    stats_.lights = lights.size();
+    visible_.assign(lights.size(), 0);
+    light_indices_.clear();
+    for (int z = 0; z < GRID_Z; z++)
+    {
+        auto& slice = slices_[z];
+        stats_.dropped_indices += slice.dropped;
+        for (std::size_t tile = 0; tile < slice.counts.size(); tile++)
+        {
+            auto count = std::min<std::size_t>(slice.counts[tile],
+                                               MAX_LIGHT_INDICES - light_indices_.size());
+            stats_.dropped_indices += slice.counts[tile] - count;
+
+            auto first = slice.indices.begin() + tile * MAX_CLUSTER_LIGHTS;
+            auto offset = static_cast<std::uint32_t>(light_indices_.size());
+            clusters_[z * slice.counts.size() + tile] = {offset, static_cast<std::uint32_t>(count)};
+            light_indices_.insert(light_indices_.end(), first, first + count);
+            for (auto light = first; light != first + count; light++)
+            {
+                visible_[*light] = 1;
+            }
+            stats_.max_cluster_lights =
+                std::max(stats_.max_cluster_lights, static_cast<std::uint32_t>(count));
+        }
+    }
+
+    stats_.visible_lights = std::ranges::count(visible_, 1);
+    stats_.light_indices = light_indices_.size();
+    stats_.average_cluster_lights = static_cast<float>(light_indices_.size()) / CLUSTER_COUNT;
+}
+
+const std::vector<LightClusters::Cluster>& LightClusters::clusters() const
+{
+    return clusters_;
+}
+
+const std::vector<std::uint32_t>& LightClusters::light_indices() const
+{
+    return light_indices_;
+}
+
+glm::vec2 LightClusters::depth_slice_scale_bias() const
+{
+    return depth_slice_scale_bias_;
+}
+
+const LightClusterStats& LightClusters::stats() const
+{
+    return stats_;
+}
+
+void LightClusters::build_slice(int z, float near_plane, float far_plane,
+                                glm::vec2 projection_scale)
+{
+    auto& slice = slices_[z];
+    slice.counts.fill(0);
+    slice.dropped = 0;
+
+    float slice_near = near_plane * std::pow(far_plane / near_plane, float(z) / GRID_Z);
+    float slice_far = near_plane * std::pow(far_plane / near_plane, float(z + 1) / GRID_Z);
+
+    // Lights whose bounds overlap the slice's depth range, four at a time
+    slice.candidates.clear();
+    auto near4 = Float4::broadcast(slice_near);
+    auto far4 = Float4::broadcast(slice_far);
+    for (std::size_t i = 0; i < depth_.size(); i += 4)
+    {
+        auto depth = Float4::load(&depth_[i]);
+        auto radius = Float4::load(&radius_[i]);
+        int overlaps = less_mask(depth - radius, far4) & less_mask(near4, depth + radius);
+        for (; overlaps != 0; overlaps &= overlaps - 1)
+        {
+            auto lane = std::countr_zero(static_cast<unsigned>(overlaps));
+            slice.candidates.push_back(static_cast<std::uint32_t>(i + lane));
+        }
+    }
+    if (slice.candidates.empty())
+    {
+        return;
+    }
+
+    // View space bounds of each tile column and row across the slice. The tiles get wider with
+    // depth, so one side of the bounds comes from the near depth and the other from the far
+    auto tile_bounds = [&](int tile, int tiles, float scale, float& min, float& max)
+    {
+        float low = -1.0f + 2.0f * tile / tiles;
+        float high = -1.0f + 2.0f * (tile + 1) / tiles;
+        min = std::min(low * slice_near, low * slice_far) / scale;
+        max = std::max(high * slice_near, high * slice_far) / scale;
+    };
+    std::array<float, GRID_X> min_x;
+    std::array<float, GRID_X> max_x;
+    std::array<float, GRID_Y> min_y;
+    std::array<float, GRID_Y> max_y;
+    for (int x = 0; x < GRID_X; x++)
+    {
+        tile_bounds(x, GRID_X, projection_scale.x, min_x[x], max_x[x]);
+    }
+    for (int y = 0; y < GRID_Y; y++)
+    {
+        tile_bounds(y, GRID_Y, projection_scale.y, min_y[y], max_y[y]);
+    }
+
+    // Sphere against box tests, with the four tiles of a row tested together
+    auto zero = Float4::broadcast(0.0f);
+    for (auto light : slice.candidates)
+    {
+        float radius_squared = radius_[light] * radius_[light];
+        float depth_distance = distance_outside(slice_near, slice_far, depth_[light]);
+        float remaining = radius_squared - depth_distance * depth_distance;
+
+        auto centre_x = Float4::broadcast(centre_x_[light]);
+        for (int y = 0; y < GRID_Y; y++)
+        {
+            float y_distance = distance_outside(min_y[y], max_y[y], centre_y_[light]);
+            float remaining_x = remaining - y_distance * y_distance;
+            if (remaining_x < 0.0f)
+            {
+                continue;
+            }
+
+            auto remaining4 = Float4::broadcast(remaining_x);
+            for (int x = 0; x < GRID_X; x += 4)
+            {
+                auto distance = max(max(Float4::load(&min_x[x]) - centre_x, zero),
+                                    centre_x - Float4::load(&max_x[x]));
+                int touches = less_equal_mask(distance * distance, remaining4);
+                for (; touches != 0; touches &= touches - 1)
+                {
+                    auto lane = std::countr_zero(static_cast<unsigned>(touches));
+                    auto tile = y * GRID_X + x + lane;
+                    auto& count = slice.counts[tile];
+                    if (count < MAX_CLUSTER_LIGHTS)
+                    {
+                        slice.indices[tile * MAX_CLUSTER_LIGHTS + count++] = light;
+                    }
+                    else
+                    {
+                        slice.dropped++;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+/// Matches the std430 ClusterLight in SceneFragment.glsl
+struct ClusterLight
+{
+    glm::vec3 position{0.0f};
+
+    // The light fades out to nothing at this distance, so clusters past it can skip the light
+    float range = 1.0f;
+
+    glm::vec3 colour{1.0f};
+    float intensity = 1.0f;
+
+    glm::vec3 direction{0.0f, -1.0f, 0.0f};
+
+    // Cosine of the cone's half angle for spot lights, POINT_LIGHT for point lights
+    float cutoff = POINT_LIGHT;
+
+    static constexpr float POINT_LIGHT = -2.0f;
+};
+
+struct LightClusterStats
+{
+    std::size_t lights = 0;
+
+    // Lights that touched at least one cluster
+    std::size_t visible_lights = 0;
+
+    std::size_t light_indices = 0;
+    std::uint32_t max_cluster_lights = 0;
+    float average_cluster_lights = 0.0f;
+
+    // Light indices dropped because a cluster or the index list was full
+    std::size_t dropped_indices = 0;
+};
+
+/**
+    Splits the view frustum into a grid of clusters and works out which lights touch each one,
+    so the fragment shader only has to loop over the handful of lights near each fragment.
+
+    The grid is GRID_X by GRID_Y tiles on screen, and GRID_Z slices in depth spaced
+    exponentially, so clusters stay roughly cube shaped all the way to the far plane. Each slice
+    is built as its own job: the lights are first filtered by depth four at a time, then each
+    candidate is tested against four clusters of a row at a time, so the only shared state is
+    the final compaction into one index list.
+*/
+class LightClusters
+{
+  public:
+    // Must match CLUSTER_GRID in SceneFragment.glsl
+    static constexpr int GRID_X = 16;
+    static constexpr int GRID_Y = 9;
+    static constexpr int GRID_Z = 24;
+    static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    static constexpr std::uint32_t MAX_CLUSTER_LIGHTS = 256;
+    static constexpr std::size_t MAX_LIGHT_INDICES = 256 * 1024;
+
+    /// Offset into light_indices() and the number of lights, per cluster
+    using Cluster = glm::uvec2;
+
+    LightClusters();
+
+    /// Assigns the lights to the clusters of the view, the projection must be a perspective
+    /// projection as made by glm::perspective
+    void build(const std::vector<ClusterLight>& lights, const glm::mat4& view_matrix,
+               const glm::mat4& projection_matrix, ThreadPool& thread_pool);
+
+    /// Indexed by (z * GRID_Y + y) * GRID_X + x
+    const std::vector<Cluster>& clusters() const;
+    const std::vector<std::uint32_t>& light_indices() const;
+
+    /// The depth slice of a fragment is floor(log(view depth) * scale + bias)
+    glm::vec2 depth_slice_scale_bias() const;
+
+    const LightClusterStats& stats() const;
+
+  private:
+    /// Each slice's lists before compaction, a fixed MAX_CLUSTER_LIGHTS per cluster
+    struct Slice
+    {
+        std::vector<std::uint32_t> candidates;
+        std::array<std::uint32_t, GRID_X * GRID_Y> counts{};
+        std::vector<std::uint32_t> indices;
+        std::size_t dropped = 0;
+    };
+
+    void build_slice(int z, float near_plane, float far_plane, glm::vec2 projection_scale);
+
+    // The lights' bounding spheres in view space, padded to a multiple of 4 with spheres that
+    // touch nothing
+    std::vector<float> centre_x_;
+    std::vector<float> centre_y_;
+    std::vector<float> depth_;
+    std::vector<float> radius_;
+    std::vector<std::uint8_t> visible_;
+
+    std::vector<Slice> slices_;
+    std::vector<Cluster> clusters_;
+    std::vector<std::uint32_t> light_indices_;
+    glm::vec2 depth_slice_scale_bias_{0.0f};
+    LightClusterStats stats_;
+};
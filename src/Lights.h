@@ -26,6 +26,9 @@ struct PointLight : public LightBase
 {
     Attenuation att;
     glm::vec3 position = {0, 0, 0};
+
+    // Distance the light fades out to nothing at, lights are culled past it
+    float range = 10.0f;
 };
 
 struct SpotLight : public LightBase
@@ -1,9 +1,40 @@
 #include "MeshGeneration.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
 #include <numeric>
 
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/MemoryIOWrapper.h>
+
+#include "AssetPack.h"
+
+namespace
+{
+    /// Opens the model's files (eg the .obj and its .mtl) from the asset pack when it has them,
+    /// so Assimp reads them from the mapping
+    class AssetPackIOSystem : public Assimp::DefaultIOSystem
+    {
+      public:
+        bool Exists(const char* file) const override
+        {
+            return AssetPack::find(file) || DefaultIOSystem::Exists(file);
+        }
+
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+        {
+            auto asset = AssetPack::find(file);
+            if (asset && mode[0] == 'r')
+            {
+                return new Assimp::MemoryIOStream(asset->data(), asset->size());
+            }
+            return DefaultIOSystem::Open(file, mode);
+        }
+    };
+} // namespace
 
-#include <SFML/Graphics/Image.hpp>
 
 /*
 Cool blue RGB:
@@ -133,12 +164,118 @@ Mesh generate_terrain_mesh(int size)
     return mesh;
 }
 
-bool Model::load_from_file(const fs::path& path)
+Mesh generate_sphere_mesh(int segments, int rings)
+{
+    constexpr auto pi = std::numbers::pi_v<float>;
+
+    // Push the corners out so the flat faces between them still enclose the unit sphere
+    float radius = 1.0f / (std::cos(pi / segments) * std::cos(pi / (2.0f * rings)));
+
+    Mesh mesh;
+    for (int ring = 0; ring <= rings; ring++)
+    {
+        float theta = pi * ring / rings;
+        for (int segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * pi * segment / segments;
+            glm::vec3 normal{std::sin(theta) * std::cos(phi), std::cos(theta),
+                             std::sin(theta) * std::sin(phi)};
+
+            Vertex vertex;
+            vertex.position = normal * radius;
+            vertex.texture_coord = {static_cast<float>(segment) / segments,
+                                    static_cast<float>(ring) / rings};
+            vertex.normal = normal;
+            mesh.vertices.push_back(vertex);
+        }
+    }
+
+    for (int ring = 0; ring < rings; ring++)
+    {
+        for (int segment = 0; segment < segments; segment++)
+        {
+            GLuint top_left = ring * (segments + 1) + segment;
+            GLuint top_right = top_left + 1;
+            GLuint bottom_left = top_left + segments + 1;
+            GLuint bottom_right = bottom_left + 1;
+
+            mesh.indices.insert(mesh.indices.end(), {top_left, top_right, bottom_left});
+            mesh.indices.insert(mesh.indices.end(), {top_right, bottom_right, bottom_left});
+        }
+    }
+    return mesh;
+}
+
+Mesh generate_cone_mesh(int segments)
+{
+    constexpr auto pi = std::numbers::pi_v<float>;
+    float radius = 1.0f / std::cos(pi / segments);
+
+    Mesh mesh;
+    mesh.vertices.push_back({{0.0f, 0.0f, 0.0f}, {0.5f, 0.0f}, {0.0f, 0.0f, -1.0f}});
+    mesh.vertices.push_back({{0.0f, 0.0f, 1.0f}, {0.5f, 1.0f}, {0.0f, 0.0f, 1.0f}});
+    for (int segment = 0; segment < segments; segment++)
+    {
+        float phi = 2.0f * pi * segment / segments;
+        glm::vec3 normal{std::cos(phi), std::sin(phi), 0.0f};
+        mesh.vertices.push_back({{normal.x * radius, normal.y * radius, 1.0f},
+                                 {static_cast<float>(segment) / segments, 1.0f},
+                                 normal});
+    }
+
+    for (int segment = 0; segment < segments; segment++)
+    {
+        GLuint current = 2 + segment;
+        GLuint next = 2 + (segment + 1) % segments;
+        mesh.indices.insert(mesh.indices.end(), {0, next, current});
+        mesh.indices.insert(mesh.indices.end(), {1, current, next});
+    }
+    return mesh;
+}
+
+BoundingSphere compute_bounding_sphere(std::span<const Mesh> meshes)
+{
+    // Centred on the middle of the bounding box, which is close enough for culling
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (auto& mesh : meshes)
+    {
+        for (auto& vertex : mesh.vertices)
+        {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+    }
+
+    BoundingSphere sphere;
+    if (min.x > max.x)
+    {
+        return sphere;
+    }
+    sphere.centre = (min + max) * 0.5f;
+    for (auto& mesh : meshes)
+    {
+        for (auto& vertex : mesh.vertices)
+        {
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.position - sphere.centre));
+        }
+    }
+    return sphere;
+}
+
+BoundingSphere compute_bounding_sphere(const Mesh& mesh)
+{
+    return compute_bounding_sphere(std::span{&mesh, 1});
+}
+
+bool Model::load_from_file(const fs::path& path, TextureLoader& texture_loader)
 {
     auto path_str = path.string();
     // Load the model, other options include aiProcess_GenNormals, aiProcess_SplitLargeMeshes,
     // aiProcess_OptimizeMeshes
     Assimp::Importer importer;
+    // The importer takes ownership of the IO system
+    importer.SetIOHandler(new AssetPackIOSystem);
     auto scene = importer.ReadFile(path_str, aiProcess_Triangulate | aiProcess_FlipUVs |
                                                  aiProcess_GenNormals); //
     //|
@@ -152,7 +289,7 @@ bool Model::load_from_file(const fs::path& path)
     }
 
     directory = path_str.substr(0, path_str.find_last_of('/'));
-    process_node(scene->mRootNode, scene);
+    process_node(scene->mRootNode, scene, texture_loader);
 
     int vertex_count = 0;
     int indices_count = 0;
@@ -171,64 +308,40 @@ bool Model::load_from_file(const fs::path& path)
     return true;
 }
 
-void Model::process_node(aiNode* node, const aiScene* scene)
+void Model::process_node(aiNode* node, const aiScene* scene, TextureLoader& texture_loader)
 {
     for (unsigned i = 0; i < node->mNumMeshes; i++)
     {
         auto mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(process_mesh(mesh, scene));
+        meshes.push_back(process_mesh(mesh, scene, texture_loader));
     }
 
     for (unsigned i = 0; i < node->mNumChildren; i++)
     {
-        process_node(node->mChildren[i], scene);
+        process_node(node->mChildren[i], scene, texture_loader);
     }
 }
 
-GLuint load_texture(const fs::path& path)
-{
-    std::cout << "Loading texture " << path << '\n';
-    GLuint texture;
-    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-
-    // Load the texture from file
-    sf::Image image;
-    image.loadFromFile(path.string());
-    image.flipVertically();
-    auto w = image.getSize().x;
-    auto h = image.getSize().y;
-    auto data = image.getPixelsPtr();
-
-    // Set the storage
-    glTextureStorage2D(texture, 8, GL_RGBA8, w, h);
-    // glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Upload the texture to the GPU to cover the whole created texture
-    glTextureSubImage2D(texture, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateTextureMipmap(texture);
-
-    // Set texture wrapping and min/mag filters
-    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    return texture;
-};
-
-std::vector<Texture> Model::load_material(aiMaterial* material, aiTextureType texture_type)
+std::vector<Texture> Model::load_material(aiMaterial* material, TextureLoader& texture_loader)
 {
     std::vector<Texture> textures;
 
-    for (unsigned i = 0; i < material->GetTextureCount(texture_type); i++)
+    // Each diffuse map has the specular map of the same index packed into its alpha
+    for (unsigned i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++)
     {
-        aiString str;
-        material->GetTexture(texture_type, i, &str);
+        aiString diffuse;
+        aiString specular;
+        material->GetTexture(aiTextureType_DIFFUSE, i, &diffuse);
+        if (i < material->GetTextureCount(aiTextureType_SPECULAR))
+        {
+            material->GetTexture(aiTextureType_SPECULAR, i, &specular);
+        }
+        auto path = std::string(diffuse.C_Str()) + "+" + specular.C_Str();
 
         bool should_load = true;
         for (auto& cached : texture_cache)
         {
-            if (cached.path == std::string(str.C_Str()))
+            if (cached.path == path)
             {
                 textures.push_back(cached);
                 should_load = false;
@@ -239,25 +352,15 @@ std::vector<Texture> Model::load_material(aiMaterial* material, aiTextureType te
         if (should_load)
         {
             Texture texture;
-
-            texture.type = [texture_type]()
+            texture.type = "diffuse";
+            texture.path = path;
+            fs::path specular_path;
+            if (specular.C_Str()[0] != '\0')
             {
-                switch (texture_type)
-                {
-
-                    case aiTextureType_DIFFUSE:
-                        return "diffuse";
-                        break;
-                    case aiTextureType_SPECULAR:
-                        return "specular";
-                        break;
-                    default:
-                        return "Unknown";
-                }
-            }();
-
-            texture.path = str.C_Str();
-            texture.id = load_texture(directory + "/" + str.C_Str());
+                specular_path = directory + "/" + specular.C_Str();
+            }
+            texture.handle =
+                texture_loader.add_packed(directory + "/" + diffuse.C_Str(), specular_path);
             textures.push_back(texture);
             texture_cache.push_back(texture);
         }
@@ -266,7 +369,7 @@ std::vector<Texture> Model::load_material(aiMaterial* material, aiTextureType te
     return textures;
 }
 
-Mesh Model::process_mesh(aiMesh* ai_mesh, const aiScene* scene)
+Mesh Model::process_mesh(aiMesh* ai_mesh, const aiScene* scene, TextureLoader& texture_loader)
 {
     Mesh mesh;
 
@@ -312,11 +415,7 @@ Mesh Model::process_mesh(aiMesh* ai_mesh, const aiScene* scene)
     if (ai_mesh->mMaterialIndex >= 0)
     {
         auto material = scene->mMaterials[ai_mesh->mMaterialIndex];
-        auto diffuse_maps = load_material(material, aiTextureType_DIFFUSE);
-        auto specular_maps = load_material(material, aiTextureType_SPECULAR);
-
-        mesh.textures.insert(mesh.textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-        mesh.textures.insert(mesh.textures.end(), specular_maps.begin(), specular_maps.end());
+        mesh.textures = load_material(material, texture_loader);
     }
 
     return mesh;
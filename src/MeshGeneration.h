@@ -2,12 +2,14 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <span>
 #include <vector>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "TextureLoader.h"
 #include "Util.h"
 
 struct Vertex
@@ -26,7 +28,7 @@ struct VertexArray
 
 struct Texture
 {
-    GLuint id = 0;
+    TextureHandle handle = 0;
     std::string type;
     std::string path;
 };
@@ -41,13 +43,21 @@ struct Mesh
     
 };
 
+/// A sphere around every vertex of a mesh, in the space of the mesh
+struct BoundingSphere
+{
+    glm::vec3 centre{0.0f};
+    float radius = 0.0f;
+};
+
 struct Model
 {
-    bool load_from_file(const fs::path& path);
+    /// The textures are added to the loader, and are empty until it uploads them
+    bool load_from_file(const fs::path& path, TextureLoader& texture_loader);
 
-    void process_node(aiNode* node, const aiScene* scene);
-    Mesh process_mesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> load_material(aiMaterial* material, aiTextureType texture_type);
+    void process_node(aiNode* node, const aiScene* scene, TextureLoader& texture_loader);
+    Mesh process_mesh(aiMesh* mesh, const aiScene* scene, TextureLoader& texture_loader);
+    std::vector<Texture> load_material(aiMaterial* material, TextureLoader& texture_loader);
 
     std::vector<Texture> texture_cache;
 
@@ -57,4 +67,15 @@ struct Model
 
 [[nodiscard]] Mesh generate_quad_mesh(float w, float h);
 [[nodiscard]] Mesh generate_cube_mesh(const glm::vec3& size);
-[[nodiscard]] Mesh generate_terrain_mesh(int size);
\ No newline at end of file
+[[nodiscard]] Mesh generate_terrain_mesh(int size);
+
+/// A sphere that fully contains the unit sphere (its faces, not just its corners, are at least
+/// 1 from the centre), for light volumes
+[[nodiscard]] Mesh generate_sphere_mesh(int segments, int rings);
+
+/// A cone with its tip at the origin that fully contains the cone reaching to z = 1 with a base
+/// radius of 1, for light volumes
+[[nodiscard]] Mesh generate_cone_mesh(int segments);
+
+[[nodiscard]] BoundingSphere compute_bounding_sphere(const Mesh& mesh);
+[[nodiscard]] BoundingSphere compute_bounding_sphere(std::span<const Mesh> meshes);
\ No newline at end of file
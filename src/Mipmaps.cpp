@@ -0,0 +1,122 @@
+#include "Mipmaps.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "Simd.h"
+
+namespace
+{
+    // Linear values are looked up at this many steps when converting back to sRGB, enough that
+    // every 8 bit sRGB value has a step of its own
+    constexpr int LINEAR_STEPS = 4096;
+
+    struct GammaTables
+    {
+        std::array<float, 256> unorm;
+        std::array<float, 256> to_linear;
+        std::array<std::uint8_t, LINEAR_STEPS> to_srgb;
+    };
+
+    const GammaTables& gamma_tables()
+    {
+        static const GammaTables tables = []()
+        {
+            GammaTables tables;
+            for (int i = 0; i < 256; i++)
+            {
+                float value = i / 255.0f;
+                tables.unorm[i] = value;
+                tables.to_linear[i] = value <= 0.04045f
+                                          ? value / 12.92f
+                                          : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < LINEAR_STEPS; i++)
+            {
+                float value = static_cast<float>(i) / (LINEAR_STEPS - 1);
+                float srgb = value <= 0.0031308f
+                                 ? value * 12.92f
+                                 : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                tables.to_srgb[i] = static_cast<std::uint8_t>(std::lround(srgb * 255.0f));
+            }
+            return tables;
+        }();
+        return tables;
+    }
+
+    /// Halves an RGBA8 level, with the texels of each block summed as Float4s. Blocks are 2x2,
+    /// except that the last column and row of an odd size take in the odd texels, so every
+    /// texel counts toward the smaller level
+    std::vector<std::uint8_t> downsample(const std::vector<std::uint8_t>& pixels, GLsizei width,
+                                         GLsizei height)
+    {
+        auto& tables = gamma_tables();
+
+        // Per lane, the scale from the average to an index into to_srgb or straight to 8 bits
+        const float scales[4] = {LINEAR_STEPS - 1, LINEAR_STEPS - 1, LINEAR_STEPS - 1, 255.0f};
+        auto scale = Float4::load(scales);
+        auto half = Float4::broadcast(0.5f);
+
+        auto next_width = std::max(width / 2, 1);
+        auto next_height = std::max(height / 2, 1);
+        std::vector<std::uint8_t> next(static_cast<std::size_t>(next_width) * next_height * 4);
+
+        // The texels across (or down) of the block of an output texel, 1 when the size is 1
+        auto block_size = [](GLsizei i, GLsizei next_size, GLsizei size)
+        {
+            return i == next_size - 1 ? size - i * 2 : 2;
+        };
+
+        auto load = [&](GLsizei x, GLsizei y)
+        {
+            auto texel = pixels.data() + (static_cast<std::size_t>(y) * width + x) * 4;
+            const float values[4] = {tables.to_linear[texel[0]], tables.to_linear[texel[1]],
+                                     tables.to_linear[texel[2]], tables.unorm[texel[3]]};
+            return Float4::load(values);
+        };
+        for (GLsizei y = 0; y < next_height; y++)
+        {
+            for (GLsizei x = 0; x < next_width; x++)
+            {
+                auto block_width = block_size(x, next_width, width);
+                auto block_height = block_size(y, next_height, height);
+                auto sum = Float4::broadcast(0.0f);
+                for (GLsizei block_y = 0; block_y < block_height; block_y++)
+                {
+                    for (GLsizei block_x = 0; block_x < block_width; block_x++)
+                    {
+                        sum = sum + load(x * 2 + block_x, y * 2 + block_y);
+                    }
+                }
+                auto average = Float4::broadcast(1.0f / (block_width * block_height));
+                float values[4];
+                (sum * average * scale + half).store(values);
+
+                auto out = next.data() + (static_cast<std::size_t>(y) * next_width + x) * 4;
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    auto value = static_cast<int>(values[channel]);
+                    out[channel] = tables.to_srgb[std::min(value, LINEAR_STEPS - 1)];
+                }
+                out[3] = static_cast<std::uint8_t>(std::min(static_cast<int>(values[3]), 255));
+            }
+        }
+        return next;
+    }
+} // namespace
+
+TextureData build_mipmaps(const std::uint8_t* pixels, GLsizei width, GLsizei height)
+{
+    TextureData texture{TextureFormat::RGBA8, width, height, {}};
+    auto levels = mip_level_count(width, height);
+    texture.levels.reserve(levels);
+    texture.levels.emplace_back(pixels, pixels + level_size(TextureFormat::RGBA8, width, height));
+    for (GLsizei level = 1; level < levels; level++)
+    {
+        texture.levels.push_back(downsample(texture.levels.back(), width, height));
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return texture;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+#include "TextureData.h"
+
+/// Copies the RGBA8 image to level 0 and halves it with a 2x2 box filter down to 1x1. The
+/// last row or column of an odd size is blended into the row or column before it, so it is not
+/// lost and the smaller levels do not shift.
+///
+/// Colour is stored with the sRGB curve, so it is averaged as linear light to keep the smaller
+/// levels from darkening. Alpha holds the specular map, which is data and averaged as it is
+[[nodiscard]] TextureData build_mipmaps(const std::uint8_t* pixels, GLsizei width,
+                                        GLsizei height);
@@ -0,0 +1,255 @@
+#include "Options.h"
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+    bool parse_int(std::string_view value, int& out)
+    {
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), out);
+        return error == std::errc{} && end == value.data() + value.size();
+    }
+} // namespace
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+
+        // Options that take a value
+        auto next_value = [&](std::string_view& value)
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << '\n';
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+        auto next_int = [&](int& out, int min)
+        {
+            std::string_view value;
+            if (!next_value(value))
+            {
+                return false;
+            }
+            if (!parse_int(value, out) || out < min)
+            {
+                std::cerr << "Invalid value '" << value << "' for " << arg << '\n';
+                return false;
+            }
+            return true;
+        };
+
+        std::string_view value;
+        bool ok = true;
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--frames")
+        {
+            ok = next_int(options.frames, 1);
+        }
+        else if (arg == "--width")
+        {
+            ok = next_int(options.width, 1);
+        }
+        else if (arg == "--height")
+        {
+            ok = next_int(options.height, 1);
+        }
+        else if (arg == "--render-scale")
+        {
+            ok = next_int(options.render_scale, 25) && options.render_scale <= 200;
+            if (!ok && options.render_scale > 200)
+            {
+                std::cerr << "The render scale can be at most 200%\n";
+            }
+        }
+        else if (arg == "--target-fps")
+        {
+            ok = next_int(options.target_fps, 1);
+        }
+        else if (arg == "--depth-prepass")
+        {
+            DepthPrepassMode mode = DepthPrepassMode::Auto;
+            ok = next_value(value) && parse_depth_prepass_mode(value, mode);
+            if (ok)
+            {
+                options.depth_prepass = mode;
+            }
+            else if (!value.empty())
+            {
+                std::cerr << "Unknown depth pre-pass mode '" << value << "'\n";
+            }
+        }
+        else if (arg == "--deferred")
+        {
+            options.deferred = true;
+        }
+        else if (arg == "--no-shadows")
+        {
+            options.no_shadows = true;
+        }
+        else if (arg == "--no-texture-compression")
+        {
+            options.no_texture_compression = true;
+        }
+        else if (arg == "--texture-budget")
+        {
+            ok = next_int(options.texture_budget, 1);
+        }
+        else if (arg == "--asset-pack")
+        {
+            ok = next_value(value);
+            options.asset_pack = value;
+        }
+        else if (arg == "--stats")
+        {
+            ok = next_value(value);
+            options.stats_path = value;
+        }
+        else if (arg == "--image")
+        {
+            ok = next_value(value);
+            options.image_path = value;
+        }
+        else if (arg == "--capture")
+        {
+            ok = next_value(value);
+            options.capture_path = value;
+        }
+        else if (arg == "--capture-start")
+        {
+            ok = next_int(options.capture_start, 1);
+        }
+        else if (arg == "--capture-frames")
+        {
+            ok = next_int(options.capture_frames, 1);
+        }
+        else if (arg == "--gl-stats")
+        {
+            options.gl_stats = true;
+        }
+        else if (arg == "--dump-graph")
+        {
+            ok = next_value(value);
+            options.graph_path = value;
+        }
+        else if (arg == "--trace")
+        {
+            ok = next_value(value);
+            options.trace_path = value;
+        }
+        else if (arg == "--seed")
+        {
+            int seed = 0;
+            ok = next_int(seed, 0);
+            options.scene.seed = static_cast<std::uint32_t>(seed);
+        }
+        else if (arg == "--boxes")
+        {
+            ok = next_int(options.scene.boxes, 0);
+        }
+        else if (arg == "--people")
+        {
+            ok = next_int(options.scene.people, 0);
+        }
+        else if (arg == "--models")
+        {
+            ok = next_int(options.scene.models, 0);
+        }
+        else if (arg == "--lights")
+        {
+            ok = next_int(options.scene.lights, 0);
+        }
+        else if (arg == "--spot-lights")
+        {
+            ok = next_int(options.scene.spot_lights, 0);
+        }
+        else if (arg == "--terrain")
+        {
+            ok = next_int(options.scene.terrain_size, 2);
+        }
+        else if (arg == "--distribution")
+        {
+            ok = next_value(value) && parse_distribution(value, options.scene.distribution);
+            if (!ok && !value.empty())
+            {
+                std::cerr << "Unknown distribution '" << value << "'\n";
+            }
+        }
+        else if (arg == "--density")
+        {
+            // Multiplies the entity counts without growing the terrain, so the density of the
+            // scene goes up by this factor
+            int density = 1;
+            ok = next_int(density, 1);
+            options.scene.boxes *= density;
+            options.scene.people *= density;
+            options.scene.models *= density;
+        }
+        else if (arg == "--help" || arg == "-h")
+        {
+            print_usage(argv[0]);
+            return false;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << '\n';
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --width <n>        Render width (default 1600)\n"
+              << "  --height <n>       Render height (default 900)\n"
+              << "  --render-scale <n> Percent of the resolution to render at (default 100)\n"
+              << "  --target-fps <n>   Lower the render scale as needed to hold this frame rate\n"
+              << "  --depth-prepass <m> off, on or auto (default auto, off when headless)\n"
+              << "  --deferred         Light the scene with deferred shading\n"
+              << "  --no-shadows       Turn off the shadow maps\n"
+              << "  --no-texture-compression\n"
+              << "                     Upload the textures uncompressed\n"
+              << "  --texture-budget <n> MB of GPU memory for the textures (default 256)\n"
+              << "  --asset-pack <path>\n"
+              << "                     Read assets from this pack, eg build/release/assets.pack\n"
+              << "\nScene generation:\n"
+              << "  --seed <n>         Seed for placing everything in the scene (default 1)\n"
+              << "  --boxes <n>        Number of crates (default 25)\n"
+              << "  --people <n>       Number of billboard people (default 50)\n"
+              << "  --models <n>       Number of backpack models (default 1)\n"
+              << "  --lights <n>       Number of point lights (default 1)\n"
+              << "  --spot-lights <n>  Number of hanging spot lights (default 0)\n"
+              << "  --terrain <n>      Width and depth of the terrain (default 128)\n"
+              << "  --distribution <d> How to place entities: random, grid or clusters\n"
+              << "  --density <n>      Multiplies the box, people and model counts given so far\n"
+              << "\nBenchmarking:\n"
+              << "  --headless         Render offscreen without a window or vsync\n"
+              << "  --frames <n>       Frames to render in headless mode (default 1000)\n"
+              << "  --stats <path>     Where to write the frame time statistics\n"
+              << "  --image <path>     Save the final headless frame to this image\n"
+              << "  --trace <path>     Profile the first --frames frames to a Chrome trace\n"
+              << "  --gl-stats         Count GL calls and redundant state changes per pass\n"
+              << "  --dump-graph <path> Write the last frame's render graph as a Graphviz file\n"
+              << "\nCapture:\n"
+              << "  --capture <path>   Capture GL commands for spooky-replay to this file\n"
+              << "  --capture-start <n>  First frame to capture (default 10)\n"
+              << "  --capture-frames <n> Number of frames to capture (default 1)\n";
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "PrepassTuner.h"
+#include "SceneGeneration.h"
+
+/// Options set from the command line, see print_usage() for the full list
+struct Options
+{
+    // Render offscreen without a window for a fixed number of frames, used for benchmarking
+    bool headless = false;
+    int frames = 1000;
+
+    int width = 1600;
+    int height = 900;
+
+    // Percentage of the window resolution the scene is rendered at (and the most the governor
+    // can raise it to), the governor holds the frame time at `target_fps` when that is set
+    int render_scale = 100;
+    int target_fps = 0;
+
+    // Whether to render a depth pre-pass, when not given the windowed mode tunes it
+    // automatically and the headless mode leaves it off so benchmarks stay repeatable
+    std::optional<DepthPrepassMode> depth_prepass;
+
+    // Start with the deferred shading path instead of the forward one
+    bool deferred = false;
+
+    // Turn off the shadow maps of the moonlight, flashlight and nearest point light
+    bool no_shadows = false;
+
+    // Upload the textures as RGBA8 instead of block compressing them
+    bool no_texture_compression = false;
+
+    // Megabytes of GPU memory the streamed texture levels are kept under
+    int texture_budget = 256;
+
+    // When set, assets are read from this pack (written by spooky-pack) instead of the loose
+    // files under assets/. The pack is not checked against the files, so it is opt in
+    std::string asset_pack;
+
+    // Where the headless mode writes the frame time statistics and (optionally) the final frame
+    std::string stats_path = "frame_stats.txt";
+    std::string image_path;
+
+    // When set, the first `frames` frames are profiled and exported as a Chrome trace
+    std::string trace_path;
+
+    // When set, the render graph of the last frame is written here in the Graphviz dot format
+    std::string graph_path;
+
+    // Count GL calls from the start, the headless mode prints the last frame's counts
+    bool gl_stats = false;
+
+    // When set, `capture_frames` frames of GL commands starting at frame `capture_start` are
+    // captured for the spooky-replay tool
+    std::string capture_path;
+    int capture_start = 10;
+    int capture_frames = 1;
+
+    SceneConfig scene;
+};
+
+/// Returns false (after printing the problem and the usage) if the arguments could not be parsed
+bool parse_options(int argc, char** argv, Options& options);
+
+void print_usage(const char* program);
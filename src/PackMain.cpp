@@ -0,0 +1,18 @@
+#include <iostream>
+#include <vector>
+
+#include "AssetPack.h"
+
+/// Packs asset directories into one file for the game to map, see AssetPack.h. The asset-pack
+/// build target runs it to write assets.pack into the build directory
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <pack> <directory>...\n";
+        return -1;
+    }
+
+    std::vector<fs::path> directories(argv + 2, argv + argc);
+    return AssetPack::write(argv[1], directories) ? 0 : -1;
+}
@@ -0,0 +1,156 @@
+#include "PrepassTuner.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Frames rendered in each mode while measuring, the first few of each are not counted as
+    // the GPU may still be working through frames from the other mode
+    constexpr int MEASURE_FRAMES = 24;
+    constexpr int SKIPPED_FRAMES = 4;
+
+    // How long a decision holds before measuring again, the view and lights change over time
+    constexpr int DECIDED_FRAMES = 600;
+
+    // Gives up waiting for samples (eg the profiler is off) and measures again after this long
+    constexpr int WAIT_FRAMES = 120;
+
+    float median(std::vector<float>& samples)
+    {
+        if (samples.empty())
+        {
+            return 0.0f;
+        }
+        auto middle = samples.begin() + samples.size() / 2;
+        std::nth_element(samples.begin(), middle, samples.end());
+        return *middle;
+    }
+} // namespace
+
+const char* to_string(DepthPrepassMode mode)
+{
+    switch (mode)
+    {
+        case DepthPrepassMode::Off:
+            return "Off";
+        case DepthPrepassMode::On:
+            return "On";
+        case DepthPrepassMode::Auto:
+            return "Auto";
+    }
+    return "";
+}
+
+bool parse_depth_prepass_mode(std::string_view name, DepthPrepassMode& mode)
+{
+    if (name == "off")
+    {
+        mode = DepthPrepassMode::Off;
+    }
+    else if (name == "on")
+    {
+        mode = DepthPrepassMode::On;
+    }
+    else if (name == "auto")
+    {
+        mode = DepthPrepassMode::Auto;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool PrepassTuner::use_prepass(std::uint64_t frame)
+{
+    auto& sample = frame_samples_[frame % frame_samples_.size()];
+    sample = Sample::None;
+    if (mode != DepthPrepassMode::Auto)
+    {
+        return mode == DepthPrepassMode::On;
+    }
+
+    phase_frames_++;
+    switch (phase_)
+    {
+        case Phase::With:
+        case Phase::Without:
+        {
+            bool with = phase_ == Phase::With;
+            if (phase_frames_ > SKIPPED_FRAMES)
+            {
+                sample = with ? Sample::With : Sample::Without;
+            }
+            if (phase_frames_ == MEASURE_FRAMES)
+            {
+                phase_ = with ? Phase::Without : Phase::Waiting;
+                phase_frames_ = 0;
+            }
+            return with;
+        }
+
+        case Phase::Waiting:
+        {
+            constexpr auto NEEDED = static_cast<std::size_t>(MEASURE_FRAMES - SKIPPED_FRAMES) / 2;
+            if (with_.size() >= NEEDED && without_.size() >= NEEDED)
+            {
+                with_ms_ = median(with_);
+                without_ms_ = median(without_);
+                prepass_ = with_ms_ < without_ms_;
+                phase_ = Phase::Decided;
+                phase_frames_ = 0;
+            }
+            else if (phase_frames_ >= WAIT_FRAMES)
+            {
+                start_measuring();
+            }
+            return prepass_;
+        }
+
+        case Phase::Decided:
+            if (phase_frames_ >= DECIDED_FRAMES)
+            {
+                start_measuring();
+            }
+            return prepass_;
+    }
+    return prepass_;
+}
+
+void PrepassTuner::add_sample(std::uint64_t frame, float scene_ms)
+{
+    auto& sample = frame_samples_[frame % frame_samples_.size()];
+    if (sample == Sample::With)
+    {
+        with_.push_back(scene_ms);
+    }
+    else if (sample == Sample::Without)
+    {
+        without_.push_back(scene_ms);
+    }
+    sample = Sample::None;
+}
+
+float PrepassTuner::with_prepass_ms() const
+{
+    return with_ms_;
+}
+
+float PrepassTuner::without_prepass_ms() const
+{
+    return without_ms_;
+}
+
+bool PrepassTuner::measuring() const
+{
+    return mode == DepthPrepassMode::Auto && phase_ != Phase::Decided;
+}
+
+void PrepassTuner::start_measuring()
+{
+    phase_ = Phase::With;
+    phase_frames_ = 0;
+    with_.clear();
+    without_.clear();
+}
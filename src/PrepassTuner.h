@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum class DepthPrepassMode
+{
+    Off,
+    On,
+
+    // Switch it on only while it makes the frame cheaper
+    Auto,
+};
+
+const char* to_string(DepthPrepassMode mode);
+bool parse_depth_prepass_mode(std::string_view name, DepthPrepassMode& mode);
+
+/**
+    Finds out whether the depth pre-pass pays for itself with the current scene and view.
+
+    The pre-pass costs a second pass over the geometry, and saves shading every fragment that
+    ends up hidden. Which side wins depends on the overdraw and on how expensive the lighting is,
+    so in the Auto mode the tuner renders a few frames with it and a few without, compares the
+    GPU time of the scene passes, and keeps whichever was cheaper until it measures again.
+
+    GPU times arrive a few frames late, so every measured frame is remembered by its profiler
+    frame number until its time comes in.
+*/
+class PrepassTuner
+{
+  public:
+    /// Whether the frame about to be rendered should do the pre-pass
+    bool use_prepass(std::uint64_t frame);
+
+    /// The GPU time of the scene passes of an earlier frame
+    void add_sample(std::uint64_t frame, float scene_ms);
+
+    /// Median scene pass times of the last measurement, 0 until there has been one
+    float with_prepass_ms() const;
+    float without_prepass_ms() const;
+
+    bool measuring() const;
+
+    DepthPrepassMode mode = DepthPrepassMode::Auto;
+
+  private:
+    enum class Phase
+    {
+        With,
+        Without,
+        Waiting,
+        Decided,
+    };
+
+    enum class Sample : std::uint8_t
+    {
+        None,
+        With,
+        Without,
+    };
+
+    void start_measuring();
+
+    Phase phase_ = Phase::With;
+    int phase_frames_ = 0;
+    bool prepass_ = false;
+
+    std::array<Sample, 64> frame_samples_{};
+    std::vector<float> with_;
+    std::vector<float> without_;
+    float with_ms_ = 0.0f;
+    float without_ms_ = 0.0f;
+};
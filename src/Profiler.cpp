@@ -0,0 +1,528 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include <glad/glad.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Zones per thread that can be recorded between two calls to end_frame()
+    constexpr std::size_t RING_SIZE = 1 << 12;
+    constexpr std::size_t MAX_ZONE_DEPTH = 64;
+
+    // GPU queries are read back this many frames after they were issued
+    constexpr std::size_t GPU_FRAME_LATENCY = 4;
+
+    const Clock::time_point epoch = Clock::now();
+
+    std::uint64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+    }
+
+    struct CPUZoneEvent
+    {
+        const char* name;
+        std::uint64_t start_ns;
+        std::uint64_t end_ns;
+        std::uint16_t depth;
+    };
+
+    /// Single producer (the owning thread), single consumer (end_frame() on the render thread)
+    struct ThreadBuffer
+    {
+        std::array<CPUZoneEvent, RING_SIZE> events;
+        std::atomic<std::uint64_t> head = 0;
+
+        // Consumer side
+        std::uint64_t tail = 0;
+
+        // Producer side, the zones currently open on this thread
+        std::array<CPUZoneEvent, MAX_ZONE_DEPTH> open_zones;
+        std::size_t depth = 0;
+
+        std::uint32_t id = 0;
+        std::string name;
+    };
+
+    struct GPUQueryZone
+    {
+        const char* name;
+        std::size_t query;
+        std::uint16_t depth;
+    };
+
+    /// The timestamp queries issued during one frame
+    struct GPUFrame
+    {
+        std::uint64_t frame = 0;
+        bool pending = false;
+
+        std::vector<GLuint> queries;
+        std::vector<GPUQueryZone> zones;
+        std::vector<std::size_t> open_zones;
+        std::size_t queries_used = 0;
+    };
+
+    struct ProfilerState
+    {
+        std::mutex threads_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+        std::atomic<bool> enabled = true;
+
+        std::uint64_t frame = 0;
+        bool in_frame = false;
+        ProfilerFrame current;
+        std::vector<ProfilerFrame> history;
+
+        std::array<GPUFrame, GPU_FRAME_LATENCY> gpu_frames;
+        std::int64_t gpu_offset_ns = 0;
+        bool gpu_synced = false;
+
+        std::size_t capture_remaining = 0;
+        std::vector<ProfilerFrame> capture;
+    };
+
+    ProfilerState& state()
+    {
+        static ProfilerState state;
+        return state;
+    }
+
+    thread_local ThreadBuffer* local_buffer = nullptr;
+
+    ThreadBuffer& thread_buffer()
+    {
+        if (!local_buffer)
+        {
+            auto& s = state();
+            std::scoped_lock lock(s.threads_mutex);
+            auto& buffer = s.threads.emplace_back(std::make_unique<ThreadBuffer>());
+            buffer->id = static_cast<std::uint32_t>(s.threads.size());
+            buffer->name = "Thread " + std::to_string(buffer->id);
+            local_buffer = buffer.get();
+        }
+        return *local_buffer;
+    }
+
+    /// Moves every zone recorded since the last drain into `zones`
+    void drain_thread(ThreadBuffer& buffer, std::vector<ProfileZone>& zones)
+    {
+        auto head = buffer.head.load(std::memory_order_acquire);
+        if (head - buffer.tail > RING_SIZE)
+        {
+            buffer.tail = head - RING_SIZE;
+        }
+
+        auto first = zones.size();
+        for (auto i = buffer.tail; i < head; i++)
+        {
+            auto& event = buffer.events[i % RING_SIZE];
+
+            ProfileZone zone;
+            zone.name = event.name;
+            zone.start_ns = event.start_ns;
+            zone.end_ns = event.end_ns;
+            zone.depth = event.depth;
+            zone.thread_id = buffer.id;
+            zones.push_back(zone);
+        }
+
+        // If the producer lapped the ring while the events were being copied, the oldest may
+        // have been overwritten part way through so are thrown away
+        auto new_head = buffer.head.load(std::memory_order_acquire);
+        if (new_head - buffer.tail > RING_SIZE)
+        {
+            auto overwritten = std::min<std::size_t>(new_head - RING_SIZE - buffer.tail,
+                                                     zones.size() - first);
+            zones.erase(zones.begin() + first, zones.begin() + first + overwritten);
+        }
+        buffer.tail = head;
+    }
+
+    ProfilerFrame* find_frame(std::vector<ProfilerFrame>& frames, std::uint64_t frame)
+    {
+        auto itr = std::find_if(frames.begin(), frames.end(),
+                                [frame](auto& f) { return f.frame == frame; });
+        return itr == frames.end() ? nullptr : &*itr;
+    }
+
+    /// Reads back the queries of a frame if they are ready, or always if `wait` is set
+    void resolve_gpu_frame(GPUFrame& gpu_frame, bool wait)
+    {
+        if (!gpu_frame.pending)
+        {
+            return;
+        }
+
+        if (!wait && gpu_frame.queries_used > 0)
+        {
+            // Queries complete in order, so if the last is available they all are
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(gpu_frame.queries[gpu_frame.queries_used - 1],
+                               GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                return;
+            }
+        }
+
+        auto& s = state();
+        std::vector<ProfileZone> zones;
+        for (auto& query_zone : gpu_frame.zones)
+        {
+            GLuint64 start = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(gpu_frame.queries[query_zone.query], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(gpu_frame.queries[query_zone.query + 1], GL_QUERY_RESULT,
+                                  &end);
+
+            ProfileZone zone;
+            zone.name = query_zone.name;
+            zone.start_ns = static_cast<std::uint64_t>(start - s.gpu_offset_ns);
+            zone.end_ns = static_cast<std::uint64_t>(end - s.gpu_offset_ns);
+            zone.frame = gpu_frame.frame;
+            zone.depth = query_zone.depth;
+            zone.gpu = true;
+            zones.push_back(zone);
+        }
+        gpu_frame.pending = false;
+
+        // The whole frame is the first zone, see begin_frame()
+        for (auto frames : {&s.history, &s.capture})
+        {
+            if (auto frame = find_frame(*frames, gpu_frame.frame))
+            {
+                frame->zones.insert(frame->zones.end(), zones.begin(), zones.end());
+                frame->gpu_ms = zones.empty() ? 0.0f : zones.front().duration_ms();
+                frame->gpu_resolved = true;
+            }
+        }
+    }
+
+    void write_json_string(std::ostream& out, std::string_view string)
+    {
+        out << '"';
+        for (char c : string)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << '"';
+    }
+} // namespace
+
+float ProfilerFrame::zone_ms(std::string_view name, bool gpu) const
+{
+    for (auto& zone : zones)
+    {
+        if (zone.gpu == gpu && name == zone.name)
+        {
+            return zone.duration_ms();
+        }
+    }
+    return 0.0f;
+}
+
+namespace Profiler
+{
+    void set_enabled(bool enabled)
+    {
+        state().enabled = enabled;
+    }
+
+    bool is_enabled()
+    {
+        return state().enabled.load(std::memory_order_relaxed);
+    }
+
+    void set_thread_name(const std::string& name)
+    {
+        auto& buffer = thread_buffer();
+        std::scoped_lock lock(state().threads_mutex);
+        buffer.name = name;
+    }
+
+    void begin_frame()
+    {
+        auto& s = state();
+        if (!s.gpu_synced)
+        {
+            // Map the GPU's timestamps onto the CPU clock, close enough to line up zones
+            GLint64 gpu_now = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+            s.gpu_offset_ns = gpu_now - static_cast<std::int64_t>(now_ns());
+            s.gpu_synced = true;
+        }
+
+        s.frame++;
+        s.in_frame = true;
+        s.current = {};
+        s.current.frame = s.frame;
+        s.current.start_ns = now_ns();
+
+        // Reuse the queries of the frame GPU_FRAME_LATENCY frames ago. If the GPU is somehow
+        // still not finished with them they are dropped rather than stalling here
+        auto& gpu_frame = s.gpu_frames[s.frame % GPU_FRAME_LATENCY];
+        resolve_gpu_frame(gpu_frame, false);
+        gpu_frame.pending = false;
+        gpu_frame.frame = s.frame;
+        gpu_frame.zones.clear();
+        gpu_frame.open_zones.clear();
+        gpu_frame.queries_used = 0;
+
+        begin_gpu_zone("GPU Frame");
+    }
+
+    void end_frame()
+    {
+        auto& s = state();
+        if (!s.in_frame)
+        {
+            return;
+        }
+        end_gpu_zone();
+        s.in_frame = false;
+
+        auto& gpu_frame = s.gpu_frames[s.frame % GPU_FRAME_LATENCY];
+        gpu_frame.pending = !gpu_frame.zones.empty();
+
+        s.current.end_ns = now_ns();
+
+        GLStats::end_frame();
+        s.current.gl_calls = GLStats::last_frame().total;
+        {
+            std::scoped_lock lock(s.threads_mutex);
+            for (auto& buffer : s.threads)
+            {
+                drain_thread(*buffer, s.current.zones);
+            }
+        }
+        for (auto& zone : s.current.zones)
+        {
+            zone.frame = s.frame;
+        }
+
+        if (s.capture_remaining > 0)
+        {
+            s.capture.push_back(s.current);
+            s.capture_remaining--;
+        }
+
+        s.history.push_back(std::move(s.current));
+        if (s.history.size() > HISTORY_FRAMES)
+        {
+            s.history.erase(s.history.begin());
+        }
+
+        // Pick up any other frames whose queries have finished early
+        for (auto& frame : s.gpu_frames)
+        {
+            if (frame.frame != s.frame)
+            {
+                resolve_gpu_frame(frame, false);
+            }
+        }
+    }
+
+    std::uint64_t current_frame()
+    {
+        return state().frame;
+    }
+
+    bool begin_cpu_zone(const char* name)
+    {
+        if (!is_enabled())
+        {
+            return false;
+        }
+        auto& buffer = thread_buffer();
+        if (buffer.depth == MAX_ZONE_DEPTH)
+        {
+            return false;
+        }
+        buffer.open_zones[buffer.depth] = {name, now_ns(), 0,
+                                           static_cast<std::uint16_t>(buffer.depth)};
+        buffer.depth++;
+        return true;
+    }
+
+    void end_cpu_zone()
+    {
+        auto& buffer = *local_buffer;
+        auto event = buffer.open_zones[--buffer.depth];
+        event.end_ns = now_ns();
+
+        auto head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head % RING_SIZE] = event;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    bool begin_gpu_zone(const char* name)
+    {
+        auto& s = state();
+        if (!is_enabled() || !s.in_frame)
+        {
+            return false;
+        }
+
+        auto& gpu_frame = s.gpu_frames[s.frame % GPU_FRAME_LATENCY];
+        if (gpu_frame.queries_used + 2 > gpu_frame.queries.size())
+        {
+            auto old_size = gpu_frame.queries.size();
+            gpu_frame.queries.resize(std::max<std::size_t>(old_size * 2, 32));
+            glCreateQueries(GL_TIMESTAMP, static_cast<GLsizei>(gpu_frame.queries.size() - old_size),
+                            gpu_frame.queries.data() + old_size);
+        }
+
+        auto query = gpu_frame.queries_used;
+        gpu_frame.queries_used += 2;
+        glQueryCounter(gpu_frame.queries[query], GL_TIMESTAMP);
+
+        gpu_frame.open_zones.push_back(gpu_frame.zones.size());
+        gpu_frame.zones.push_back(
+            {name, query, static_cast<std::uint16_t>(gpu_frame.open_zones.size() - 1)});
+        return true;
+    }
+
+    void end_gpu_zone()
+    {
+        auto& s = state();
+        auto& gpu_frame = s.gpu_frames[s.frame % GPU_FRAME_LATENCY];
+        if (gpu_frame.open_zones.empty())
+        {
+            return;
+        }
+
+        auto& zone = gpu_frame.zones[gpu_frame.open_zones.back()];
+        gpu_frame.open_zones.pop_back();
+        glQueryCounter(gpu_frame.queries[zone.query + 1], GL_TIMESTAMP);
+    }
+
+    void flush_gpu()
+    {
+        for (auto& gpu_frame : state().gpu_frames)
+        {
+            resolve_gpu_frame(gpu_frame, true);
+        }
+    }
+
+    const std::vector<ProfilerFrame>& history()
+    {
+        return state().history;
+    }
+
+    std::vector<ProfilerThread> threads()
+    {
+        auto& s = state();
+        std::scoped_lock lock(s.threads_mutex);
+
+        std::vector<ProfilerThread> threads;
+        threads.push_back({0, "GPU"});
+        for (auto& buffer : s.threads)
+        {
+            threads.push_back({buffer->id, buffer->name});
+        }
+        return threads;
+    }
+
+    void start_capture(std::size_t frames)
+    {
+        auto& s = state();
+        s.capture.clear();
+        s.capture_remaining = frames;
+    }
+
+    bool is_capturing()
+    {
+        return state().capture_remaining > 0;
+    }
+
+    std::size_t captured_frames()
+    {
+        return state().capture.size();
+    }
+
+    bool export_chrome_trace(const fs::path& path)
+    {
+        std::ofstream out_file(path);
+        if (!out_file)
+        {
+            std::cerr << "Failed to open " << path << " for writing the trace.\n";
+            return false;
+        }
+
+        out_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() -> std::ostream&
+        {
+            out_file << (first ? "" : ",\n");
+            first = false;
+            return out_file;
+        };
+
+        for (auto& thread : threads())
+        {
+            separator() << R"({"ph":"M","pid":1,"tid":)" << thread.id
+                        << R"(,"name":"thread_name","args":{"name":)";
+            write_json_string(out_file, thread.name);
+            out_file << "}}";
+        }
+
+        // Timestamps are in microseconds
+        out_file << std::fixed << std::setprecision(3);
+        auto& capture = state().capture;
+        for (auto& frame : capture)
+        {
+            separator() << R"({"ph":"C","pid":1,"name":"Frame time","ts":)"
+                        << frame.start_ns / 1000.0 << R"(,"args":{"cpu_ms":)" << frame.cpu_ms()
+                        << R"(,"gpu_ms":)" << frame.gpu_ms << "}}";
+
+            auto& gl = frame.gl_calls;
+            if (gl.total_calls() > 0)
+            {
+                separator() << R"({"ph":"C","pid":1,"name":"GL calls","ts":)"
+                            << frame.start_ns / 1000.0 << R"(,"args":{"draws":)"
+                            << gl.count(GLCallType::Draw) << R"(,"total":)" << gl.total_calls()
+                            << R"(,"redundant":)" << gl.total_redundant() << "}}";
+            }
+
+            for (auto& zone : frame.zones)
+            {
+                separator() << R"({"ph":"X","pid":1,"tid":)" << zone.thread_id
+                            << R"(,"ts":)" << zone.start_ns / 1000.0 << R"(,"dur":)"
+                            << (zone.end_ns - zone.start_ns) / 1000.0 << R"(,"name":)";
+                write_json_string(out_file, zone.name);
+                out_file << R"(,"args":{"frame":)" << frame.frame << "}}";
+            }
+        }
+        out_file << "\n]}\n";
+
+        std::cout << "Exported " << capture.size() << " frames of profiling to " << path
+                  << '\n';
+        return true;
+    }
+
+    void shutdown()
+    {
+        for (auto& gpu_frame : state().gpu_frames)
+        {
+            glDeleteQueries(static_cast<GLsizei>(gpu_frame.queries.size()),
+                            gpu_frame.queries.data());
+            gpu_frame = {};
+        }
+    }
+} // namespace Profiler
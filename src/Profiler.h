@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "GLStats.h"
+#include "Util.h"
+
+/// A timed region of a frame, on the CPU (any thread) or on the GPU
+struct ProfileZone
+{
+    const char* name = "";
+
+    // Nanoseconds since the profiler started, GPU times are mapped onto the CPU clock
+    std::uint64_t start_ns = 0;
+    std::uint64_t end_ns = 0;
+
+    std::uint64_t frame = 0;
+    std::uint32_t thread_id = 0;
+    std::uint16_t depth = 0;
+    bool gpu = false;
+
+    float duration_ms() const
+    {
+        return static_cast<float>(end_ns - start_ns) / 1'000'000.0f;
+    }
+};
+
+struct ProfilerFrame
+{
+    std::uint64_t frame = 0;
+    std::uint64_t start_ns = 0;
+    std::uint64_t end_ns = 0;
+
+    // Filled in a few frames late, once the GPU timestamps are available
+    float gpu_ms = 0.0f;
+    bool gpu_resolved = false;
+
+    std::vector<ProfileZone> zones;
+
+    // Only counted while the GL stats layer is enabled
+    GLCallCounters gl_calls;
+
+    float cpu_ms() const
+    {
+        return static_cast<float>(end_ns - start_ns) / 1'000'000.0f;
+    }
+
+    /// Duration of the first CPU or GPU zone with this name, 0 if the frame has none
+    float zone_ms(std::string_view name, bool gpu) const;
+};
+
+/// Thread ID 0 is reserved for the GPU "thread" in the zone lists and trace
+struct ProfilerThread
+{
+    std::uint32_t id = 0;
+    std::string name;
+};
+
+/**
+    Scoped zone profiler.
+
+    CPU zones are recorded into a lock-free ring buffer per thread, so any thread can record
+    zones without contention. GPU zones are GL_TIMESTAMP queries that are read back several frames
+    later, and only once they are available, so reading them never stalls the pipeline.
+
+    Everything is collected on the render thread in end_frame().
+*/
+namespace Profiler
+{
+    /// How many frames of zones are kept for the GUI
+    constexpr std::size_t HISTORY_FRAMES = 240;
+
+    void set_enabled(bool enabled);
+    bool is_enabled();
+
+    /// Names the calling thread in the GUI and trace output
+    void set_thread_name(const std::string& name);
+
+    /// Render thread only, brackets each frame
+    void begin_frame();
+    void end_frame();
+
+    /// The number of the frame in progress, as used by ProfilerFrame::frame
+    std::uint64_t current_frame();
+
+    /// Returns false if the zone was not started (so must not be ended), eg when disabled
+    bool begin_cpu_zone(const char* name);
+    void end_cpu_zone();
+
+    /// Render thread only, must be called with the OpenGL context current
+    bool begin_gpu_zone(const char* name);
+    void end_gpu_zone();
+
+    /// Waits for every outstanding GPU query and resolves it, eg before exporting a trace
+    void flush_gpu();
+
+    const std::vector<ProfilerFrame>& history();
+    std::vector<ProfilerThread> threads();
+
+    /// Records every zone of the next `frames` frames so they can be exported as a trace
+    void start_capture(std::size_t frames);
+    bool is_capturing();
+    std::size_t captured_frames();
+
+    /// Writes the captured frames in the Chrome trace event format (chrome://tracing, Perfetto)
+    bool export_chrome_trace(const fs::path& path);
+
+    /// Frees the GPU queries, call before the OpenGL context is destroyed
+    void shutdown();
+
+    class CPUZoneScope
+    {
+      public:
+        explicit CPUZoneScope(const char* name)
+            : active_(begin_cpu_zone(name))
+        {
+        }
+        CPUZoneScope(const CPUZoneScope&) = delete;
+        CPUZoneScope& operator=(const CPUZoneScope&) = delete;
+        ~CPUZoneScope()
+        {
+            if (active_)
+            {
+                end_cpu_zone();
+            }
+        }
+
+      private:
+        bool active_;
+    };
+
+    /// Times the scope on the CPU and the GPU, and counts its GL calls as a pass
+    class GPUZoneScope
+    {
+      public:
+        explicit GPUZoneScope(const char* name)
+            : cpu_scope_(name)
+            , active_(begin_gpu_zone(name))
+        {
+            GLStats::begin_pass(name);
+        }
+        GPUZoneScope(const GPUZoneScope&) = delete;
+        GPUZoneScope& operator=(const GPUZoneScope&) = delete;
+        ~GPUZoneScope()
+        {
+            GLStats::end_pass();
+            if (active_)
+            {
+                end_gpu_zone();
+            }
+        }
+
+      private:
+        CPUZoneScope cpu_scope_;
+        bool active_;
+    };
+} // namespace Profiler
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+/// Times the rest of the enclosing scope, the name must be a string literal
+#define PROFILE_ZONE(name) Profiler::CPUZoneScope PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name)                                                                   \
+    Profiler::GPUZoneScope PROFILE_CONCAT(profile_gpu_zone_, __LINE__)(name)
@@ -0,0 +1,476 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "Profiler.h"
+
+namespace
+{
+    /// The bit that makes image stores visible to a later use of the texture
+    GLbitfield barrier_bit(RenderAccess access)
+    {
+        switch (access)
+        {
+            case RenderAccess::Sampled:
+                return GL_TEXTURE_FETCH_BARRIER_BIT;
+            case RenderAccess::Attachment:
+                return GL_FRAMEBUFFER_BARRIER_BIT;
+            case RenderAccess::Storage:
+                return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        }
+        return 0;
+    }
+
+    std::string format_name(GLenum format)
+    {
+        switch (format)
+        {
+            case GL_R8:
+                return "R8";
+            case GL_RG8:
+                return "RG8";
+            case GL_RGB8:
+                return "RGB8";
+            case GL_RGBA8:
+                return "RGBA8";
+            case GL_R16F:
+                return "R16F";
+            case GL_RGBA16F:
+                return "RGBA16F";
+            case GL_R32F:
+                return "R32F";
+            case GL_RGBA32F:
+                return "RGBA32F";
+            case GL_R11F_G11F_B10F:
+                return "R11G11B10F";
+            case GL_DEPTH_COMPONENT24:
+                return "D24";
+            case GL_DEPTH_COMPONENT32F:
+                return "D32F";
+            case GL_DEPTH24_STENCIL8:
+                return "D24S8";
+            case GL_DEPTH32F_STENCIL8:
+                return "D32FS8";
+        }
+        return "0x" + std::to_string(format);
+    }
+
+    /// Looks up the timings of every zone in the latest frame the profiler has GPU times for
+    const ProfilerFrame* latest_resolved_frame()
+    {
+        auto& history = Profiler::history();
+        auto itr = std::find_if(history.rbegin(), history.rend(),
+                                [](const ProfilerFrame& frame) { return frame.gpu_resolved; });
+        return itr != history.rend() ? &*itr : nullptr;
+    }
+} // namespace
+
+// =======================================
+//          RenderGraph::Builder
+// =======================================
+RenderGraph::Builder::Builder(RenderGraph& graph, std::size_t pass)
+    : graph_(graph)
+    , pass_(pass)
+{
+}
+
+RenderResource RenderGraph::Builder::create(const char* name, const RenderTargetDesc& desc,
+                                            RenderAccess access)
+{
+    auto resource = graph_.add_resource(name, desc);
+    write(resource, access);
+    return resource;
+}
+
+void RenderGraph::Builder::read(RenderResource resource, RenderAccess access)
+{
+    if (resource.valid())
+    {
+        graph_.passes_[pass_].reads.push_back({resource.index, access});
+    }
+}
+
+void RenderGraph::Builder::write(RenderResource resource, RenderAccess access)
+{
+    if (!resource.valid())
+    {
+        return;
+    }
+
+    auto& writers = graph_.resources_[resource.index].writers;
+    if (!writers.empty())
+    {
+        read(resource, access);
+    }
+    writers.push_back(pass_);
+    graph_.passes_[pass_].writes.push_back({resource.index, access});
+}
+
+void RenderGraph::Builder::side_effect()
+{
+    graph_.passes_[pass_].side_effect = true;
+}
+
+// =======================================
+//          RenderGraph::Resources
+// =======================================
+RenderGraph::Resources::Resources(const RenderGraph& graph, GLuint framebuffer)
+    : graph_(graph)
+    , framebuffer_(framebuffer)
+{
+}
+
+GLuint RenderGraph::Resources::texture(RenderResource resource) const
+{
+    return graph_.texture(resource);
+}
+
+const RenderTargetDesc& RenderGraph::Resources::desc(RenderResource resource) const
+{
+    return graph_.resources_[resource.index].desc;
+}
+
+GLuint RenderGraph::Resources::framebuffer() const
+{
+    return framebuffer_;
+}
+
+// =======================================
+//              RenderGraph
+// =======================================
+void RenderGraph::begin_frame()
+{
+    passes_.clear();
+    resources_.clear();
+    compiled_ = false;
+}
+
+RenderResource RenderGraph::import_texture(const char* name, GLuint texture,
+                                           const RenderTargetDesc& desc)
+{
+    auto resource = add_resource(name, desc);
+    resources_[resource.index].imported = true;
+    resources_[resource.index].texture = texture;
+    return resource;
+}
+
+RenderResource RenderGraph::import_backbuffer(const char* name, GLsizei width, GLsizei height)
+{
+    auto resource = import_texture(name, 0, {width, height, GL_RGBA8});
+    resources_[resource.index].backbuffer = true;
+    return resource;
+}
+
+void RenderGraph::add_pass(const char* name, const SetupFunction& setup, ExecuteFunction execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes_.push_back(std::move(pass));
+
+    Builder builder(*this, passes_.size() - 1);
+    setup(builder);
+}
+
+void RenderGraph::export_texture(RenderResource resource)
+{
+    if (resource.valid())
+    {
+        resources_[resource.index].exported = true;
+    }
+}
+
+bool RenderGraph::compile()
+{
+    // Walk back from the passes that have to run, marking everything they read as needed. A
+    // pass that writes nothing needed is culled
+    std::vector<bool> needed(resources_.size(), false);
+    for (std::size_t i = 0; i < resources_.size(); i++)
+    {
+        needed[i] = resources_[i].imported || resources_[i].exported;
+    }
+    for (auto pass = passes_.rbegin(); pass != passes_.rend(); pass++)
+    {
+        pass->culled = !pass->side_effect &&
+                       std::none_of(pass->writes.begin(), pass->writes.end(),
+                                    [&](const Access& write) { return needed[write.resource]; });
+        if (!pass->culled)
+        {
+            for (auto& read : pass->reads)
+            {
+                needed[read.resource] = true;
+            }
+        }
+    }
+
+    // Every texture a pass reads has to have been written by an earlier pass
+    for (std::size_t i = 0; i < passes_.size(); i++)
+    {
+        auto& pass = passes_[i];
+        if (pass.culled)
+        {
+            continue;
+        }
+        for (auto& read : pass.reads)
+        {
+            auto& resource = resources_[read.resource];
+            if (!resource.imported && (resource.writers.empty() || resource.writers.front() >= i))
+            {
+                std::cerr << "Render pass '" << pass.name << "' reads '" << resource.name
+                          << "' before any pass writes it.\n";
+                return false;
+            }
+        }
+    }
+
+    // Transient textures live from the first pass that uses them to the last
+    constexpr auto NONE = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> first_use(resources_.size(), NONE);
+    std::vector<std::size_t> last_use(resources_.size(), NONE);
+    for (std::size_t i = 0; i < passes_.size(); i++)
+    {
+        auto& pass = passes_[i];
+        pass.acquires.clear();
+        pass.releases.clear();
+        if (pass.culled)
+        {
+            continue;
+        }
+        for (auto accesses : {&pass.reads, &pass.writes})
+        {
+            for (auto& access : *accesses)
+            {
+                if (first_use[access.resource] == NONE)
+                {
+                    first_use[access.resource] = i;
+                }
+                last_use[access.resource] = i;
+            }
+        }
+    }
+    for (std::uint32_t i = 0; i < resources_.size(); i++)
+    {
+        auto& resource = resources_[i];
+        if (resource.imported || first_use[i] == NONE)
+        {
+            continue;
+        }
+        passes_[first_use[i]].acquires.push_back(i);
+        if (!resource.exported)
+        {
+            passes_[last_use[i]].releases.push_back(i);
+        }
+    }
+
+    // Image stores are not ordered with anything that comes after them, so each later use of
+    // the texture needs the barrier bit for how it is used
+    std::vector<bool> storage_written(resources_.size(), false);
+    std::vector<GLbitfield> barriers_issued(resources_.size(), 0);
+    for (auto& pass : passes_)
+    {
+        pass.barriers = 0;
+        if (pass.culled)
+        {
+            continue;
+        }
+        for (auto accesses : {&pass.reads, &pass.writes})
+        {
+            for (auto& access : *accesses)
+            {
+                auto bit = barrier_bit(access.access);
+                if (storage_written[access.resource] && !(barriers_issued[access.resource] & bit))
+                {
+                    pass.barriers |= bit;
+                    barriers_issued[access.resource] |= bit;
+                }
+            }
+        }
+        for (auto& write : pass.writes)
+        {
+            if (write.access == RenderAccess::Storage)
+            {
+                storage_written[write.resource] = true;
+                barriers_issued[write.resource] = 0;
+            }
+        }
+    }
+
+    compiled_ = true;
+    return true;
+}
+
+void RenderGraph::execute(RenderTargetPool& pool)
+{
+    if (!compiled_)
+    {
+        return;
+    }
+
+    std::vector<GLuint> colour;
+    for (auto& pass : passes_)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+        for (auto index : pass.acquires)
+        {
+            resources_[index].texture = pool.acquire(resources_[index].desc);
+        }
+        if (pass.barriers)
+        {
+            glMemoryBarrier(pass.barriers);
+        }
+
+        // Attach whatever the pass renders to, drawing to the backbuffer means framebuffer 0
+        bool bind_framebuffer = false;
+        bool backbuffer = false;
+        GLuint depth = 0;
+        GLenum depth_format = 0;
+        colour.clear();
+        for (auto& write : pass.writes)
+        {
+            auto& resource = resources_[write.resource];
+            if (write.access != RenderAccess::Attachment)
+            {
+                continue;
+            }
+            bind_framebuffer = true;
+            if (resource.backbuffer)
+            {
+                backbuffer = true;
+            }
+            else if (RenderTargetPool::is_depth_format(resource.desc.format))
+            {
+                depth = resource.texture;
+                depth_format = resource.desc.format;
+            }
+            else
+            {
+                colour.push_back(resource.texture);
+            }
+        }
+
+        GLuint framebuffer = 0;
+        if (bind_framebuffer)
+        {
+            framebuffer = backbuffer ? 0 : pool.framebuffer(colour, depth, depth_format);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+
+        {
+            Profiler::GPUZoneScope zone(pass.name);
+            pass.execute(Resources(*this, framebuffer));
+        }
+
+        for (auto index : pass.releases)
+        {
+            pool.release(resources_[index].texture);
+        }
+    }
+}
+
+GLuint RenderGraph::texture(RenderResource resource) const
+{
+    return resource.valid() ? resources_[resource.index].texture : 0;
+}
+
+std::vector<RenderPassInfo> RenderGraph::pass_info() const
+{
+    auto frame = latest_resolved_frame();
+
+    std::vector<RenderPassInfo> info;
+    for (auto& pass : passes_)
+    {
+        RenderPassInfo pass_info;
+        pass_info.name = pass.name;
+        pass_info.culled = pass.culled;
+        pass_info.barriers = pass.barriers;
+        for (auto& read : pass.reads)
+        {
+            pass_info.reads.push_back(resources_[read.resource].name);
+        }
+        for (auto& write : pass.writes)
+        {
+            pass_info.writes.push_back(resources_[write.resource].name);
+        }
+        if (!pass.culled && frame)
+        {
+            pass_info.cpu_ms = frame->zone_ms(pass.name, false);
+            pass_info.gpu_ms = frame->zone_ms(pass.name, true);
+        }
+        info.push_back(std::move(pass_info));
+    }
+    return info;
+}
+
+bool RenderGraph::write_graphviz(const fs::path& path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Failed to open " << path << " for writing.\n";
+        return false;
+    }
+
+    auto info = pass_info();
+    out << std::fixed << std::setprecision(3);
+    out << "digraph RenderGraph {\n"
+        << "    rankdir=LR;\n"
+        << "    node [fontname=\"Helvetica\", fontsize=10];\n";
+
+    // Passes are boxes with their timings, culled passes are greyed out
+    for (std::size_t i = 0; i < info.size(); i++)
+    {
+        auto& pass = info[i];
+        out << "    pass" << i << " [shape=box, style=\"filled,rounded\", label=\"" << pass.name;
+        if (pass.culled)
+        {
+            out << "\\n(culled)\", fillcolor=\"#dddddd\", fontcolor=\"#888888\"];\n";
+            continue;
+        }
+        out << "\\nCPU " << pass.cpu_ms << "ms, GPU " << pass.gpu_ms << "ms";
+        if (pass.barriers)
+        {
+            out << "\\nbarrier 0x" << std::hex << pass.barriers << std::dec;
+        }
+        out << "\", fillcolor=\"#a6cee3\"];\n";
+    }
+
+    // Resources are ellipses, imported ones are green
+    for (std::size_t i = 0; i < resources_.size(); i++)
+    {
+        auto& resource = resources_[i];
+        out << "    resource" << i << " [shape=ellipse, style=filled, label=\"" << resource.name
+            << "\\n"
+            << resource.desc.width << "x" << resource.desc.height << " "
+            << format_name(resource.desc.format) << "\", fillcolor=\""
+            << (resource.imported ? "#b2df8a" : "#fdbf6f") << "\"];\n";
+    }
+
+    for (std::size_t i = 0; i < passes_.size(); i++)
+    {
+        for (auto& write : passes_[i].writes)
+        {
+            out << "    pass" << i << " -> resource" << write.resource << ";\n";
+        }
+        for (auto& read : passes_[i].reads)
+        {
+            out << "    resource" << read.resource << " -> pass" << i << ";\n";
+        }
+    }
+    out << "}\n";
+    return true;
+}
+
+RenderResource RenderGraph::add_resource(const char* name, const RenderTargetDesc& desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resources_.push_back(resource);
+    return {static_cast<std::uint32_t>(resources_.size() - 1)};
+}
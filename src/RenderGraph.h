@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "RenderTargetPool.h"
+#include "Util.h"
+
+/// A texture in a RenderGraph, only valid for the frame it was declared in
+struct RenderResource
+{
+    static constexpr std::uint32_t INVALID = ~0u;
+    std::uint32_t index = INVALID;
+
+    bool valid() const
+    {
+        return index != INVALID;
+    }
+};
+
+/// How a pass uses a texture, decides the framebuffer attachments and the barriers
+enum class RenderAccess
+{
+    // Read with a sampler
+    Sampled,
+
+    // Rendered to as a framebuffer attachment
+    Attachment,
+
+    // Read or written with image load/store
+    Storage,
+};
+
+/// A pass as it was compiled in the last frame, for the GUI and the graph dump
+struct RenderPassInfo
+{
+    const char* name = "";
+    bool culled = false;
+    std::vector<std::string> reads;
+    std::vector<std::string> writes;
+
+    // glMemoryBarrier bits issued before the pass
+    GLbitfield barriers = 0;
+
+    // From the most recent frame the profiler has GPU times for, 0 if there are none
+    float cpu_ms = 0.0f;
+    float gpu_ms = 0.0f;
+};
+
+/**
+    The passes of a frame, declared each frame along with the textures they read and write.
+
+    compile() works out what the frame needs from the declarations:
+
+     - Passes are culled when nothing reads their output, unless they have side effects (such as
+       drawing to the window) or write an imported or exported texture.
+     - Transient textures are acquired from the RenderTargetPool just before the first pass that
+       uses them and released after the last, so the pool can hand the memory to later passes.
+     - glMemoryBarrier is issued before any pass that uses a texture last written with image
+       stores. Framebuffer writes followed by sampling are ordered by OpenGL itself.
+
+    Each pass runs inside a GPU profiler zone of its name, which is where the per-pass timings
+    come from. Pass and resource names must be string literals (or otherwise outlive the
+    profiler history).
+*/
+class RenderGraph
+{
+  public:
+    /// Declares what a pass reads and writes, passed to the setup function of each pass
+    class Builder
+    {
+      public:
+        /// A transient texture, written by this pass
+        RenderResource create(const char* name, const RenderTargetDesc& desc,
+                              RenderAccess access = RenderAccess::Attachment);
+
+        void read(RenderResource resource, RenderAccess access = RenderAccess::Sampled);
+
+        /// Writing a texture an earlier pass wrote keeps its contents, so also depends on that
+        /// pass
+        void write(RenderResource resource, RenderAccess access = RenderAccess::Attachment);
+
+        /// The pass is never culled
+        void side_effect();
+
+      private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, std::size_t pass);
+
+        RenderGraph& graph_;
+        std::size_t pass_;
+    };
+
+    /// The textures and framebuffer of a pass while it executes
+    class Resources
+    {
+      public:
+        GLuint texture(RenderResource resource) const;
+        const RenderTargetDesc& desc(RenderResource resource) const;
+
+        /// Has the textures the pass writes as attachments attached, and is already bound
+        GLuint framebuffer() const;
+
+      private:
+        friend class RenderGraph;
+        Resources(const RenderGraph& graph, GLuint framebuffer);
+
+        const RenderGraph& graph_;
+        GLuint framebuffer_;
+    };
+
+    using SetupFunction = std::function<void(Builder&)>;
+    using ExecuteFunction = std::function<void(const Resources&)>;
+
+    /// Clears the passes and resources of the last frame
+    void begin_frame();
+
+    /// A texture that is owned outside the graph and outlives the frame
+    RenderResource import_texture(const char* name, GLuint texture, const RenderTargetDesc& desc);
+
+    /// The default framebuffer, passes that write it draw to the window
+    RenderResource import_backbuffer(const char* name, GLsizei width, GLsizei height);
+
+    void add_pass(const char* name, const SetupFunction& setup, ExecuteFunction execute);
+
+    /// Keeps the texture (and so the passes writing it) alive to be read after execute(). Like
+    /// any transient it goes back to the pool at the end of the frame, so stays valid until the
+    /// next acquire of the same description
+    void export_texture(RenderResource resource);
+
+    /// Culls the passes and works out the lifetimes and barriers, returns false if the graph
+    /// is invalid (eg a pass reads a texture that nothing writes)
+    bool compile();
+
+    void execute(RenderTargetPool& pool);
+
+    /// The texture behind a resource once the pass writing it has executed
+    GLuint texture(RenderResource resource) const;
+
+    /// The last compiled frame, with the timings the profiler has for each pass
+    std::vector<RenderPassInfo> pass_info() const;
+
+    /// Writes the last compiled frame in the Graphviz dot format
+    bool write_graphviz(const fs::path& path) const;
+
+  private:
+    struct Access
+    {
+        std::uint32_t resource = 0;
+        RenderAccess access = RenderAccess::Sampled;
+    };
+
+    struct Pass
+    {
+        const char* name = "";
+        ExecuteFunction execute;
+
+        std::vector<Access> reads;
+        std::vector<Access> writes;
+        bool side_effect = false;
+
+        // Filled by compile()
+        bool culled = false;
+        GLbitfield barriers = 0;
+        std::vector<std::uint32_t> acquires;
+        std::vector<std::uint32_t> releases;
+    };
+
+    struct Resource
+    {
+        const char* name = "";
+        RenderTargetDesc desc;
+
+        bool imported = false;
+        bool exported = false;
+        bool backbuffer = false;
+        GLuint texture = 0;
+
+        // The passes that wrote it, in order
+        std::vector<std::size_t> writers;
+    };
+
+    RenderResource add_resource(const char* name, const RenderTargetDesc& desc);
+
+    std::vector<Pass> passes_;
+    std::vector<Resource> resources_;
+    bool compiled_ = false;
+};
@@ -0,0 +1,96 @@
+#include "RenderScale.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // How much of each new frame time goes into the smoothed time
+    constexpr float SMOOTHING = 0.2f;
+
+    // Frames to wait after changing the scale before looking at the frame times again
+    constexpr int COOLDOWN_FRAMES = 8;
+
+    // The scale is left alone while the frame time is within this band around the target, it
+    // goes further below the target than above so it does not flip between two scales
+    constexpr float LOWER_BAND = 0.85f;
+    constexpr float UPPER_BAND = 1.05f;
+
+    // Largest change of the scale in one update, it drops faster than it recovers
+    constexpr float MAX_STEP_DOWN = 0.1f;
+    constexpr float MAX_STEP_UP = 0.05f;
+} // namespace
+
+RenderScaleGovernor::RenderScaleGovernor(float max_scale)
+    : max_scale_(std::clamp(max_scale, MIN_SCALE, MAX_SCALE))
+{
+    scale_ = max_scale_;
+}
+
+void RenderScaleGovernor::update(float frame_ms)
+{
+    if (frame_ms <= 0.0f)
+    {
+        return;
+    }
+    smoothed_ms_ =
+        smoothed_ms_ == 0.0f ? frame_ms : smoothed_ms_ + (frame_ms - smoothed_ms_) * SMOOTHING;
+
+    if (!enabled || target_frame_ms <= 0.0f)
+    {
+        return;
+    }
+    if (cooldown_ > 0)
+    {
+        cooldown_--;
+        return;
+    }
+
+    auto load = smoothed_ms_ / target_frame_ms;
+    if (load > LOWER_BAND && load < UPPER_BAND)
+    {
+        return;
+    }
+
+    // Frame time goes with the pixel count, so the scale goes with the square root of it
+    auto wanted = scale_ * std::sqrt(1.0f / load);
+    auto step = std::clamp(wanted - scale_, -MAX_STEP_DOWN, MAX_STEP_UP);
+    auto lowest = std::clamp(min_scale, MIN_SCALE, max_scale_);
+    auto new_scale = std::clamp(scale_ + step, lowest, max_scale_);
+    if (new_scale != scale_)
+    {
+        scale_ = new_scale;
+        cooldown_ = COOLDOWN_FRAMES;
+    }
+}
+
+float RenderScaleGovernor::scale() const
+{
+    return scale_;
+}
+
+float RenderScaleGovernor::max_scale() const
+{
+    return max_scale_;
+}
+
+float RenderScaleGovernor::smoothed_frame_ms() const
+{
+    return smoothed_ms_;
+}
+
+void RenderScaleGovernor::set_scale(float scale)
+{
+    scale_ = std::clamp(scale, MIN_SCALE, max_scale_);
+    cooldown_ = COOLDOWN_FRAMES;
+}
+
+GLsizei RenderScaleGovernor::scaled(GLsizei window_size) const
+{
+    return std::max(1, static_cast<GLsizei>(static_cast<float>(window_size) * scale_));
+}
+
+GLsizei RenderScaleGovernor::allocated(GLsizei window_size) const
+{
+    return std::max(1, static_cast<GLsizei>(static_cast<float>(window_size) * max_scale_));
+}
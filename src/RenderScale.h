@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/**
+    Picks the fraction of the window resolution the scene is rendered at, so the frame time
+    holds at a target.
+
+    The cost of a frame is mostly per-pixel, so it scales with the square of the render scale.
+    Each update compares a smoothed frame time against the target and moves the scale towards
+    the one that would hit it, a small step at a time and only after the previous step has had
+    time to show up in the frame times (GPU timings arrive a few frames late).
+*/
+class RenderScaleGovernor
+{
+  public:
+    static constexpr float MIN_SCALE = 0.25f;
+    static constexpr float MAX_SCALE = 2.0f;
+
+    /// Starts at the max scale, the render targets are allocated at the max scale so changing
+    /// the scale never reallocates them
+    explicit RenderScaleGovernor(float max_scale = 1.0f);
+
+    /// Feeds in the time a frame took, call once per new measurement
+    void update(float frame_ms);
+
+    float scale() const;
+    float max_scale() const;
+    float smoothed_frame_ms() const;
+
+    /// Fixes the scale, used when the governor is disabled
+    void set_scale(float scale);
+
+    /// Size of the render target area for a window of the given size at the current scale
+    GLsizei scaled(GLsizei window_size) const;
+
+    /// Size to allocate the render targets at for a window of the given size
+    GLsizei allocated(GLsizei window_size) const;
+
+    bool enabled = false;
+    float target_frame_ms = 16.0f;
+    float min_scale = 0.5f;
+
+  private:
+    float scale_ = 1.0f;
+    float max_scale_ = 1.0f;
+
+    float smoothed_ms_ = 0.0f;
+    int cooldown_ = 0;
+};
@@ -0,0 +1,239 @@
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // Textures unused for this many frames are deleted
+    constexpr std::uint64_t FRAMES_BEFORE_DELETE = 3;
+
+    bool has_stencil(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    /// Drivers pad 3 component formats to 4, so RGB8 is counted as 4 bytes
+    std::size_t bytes_per_pixel(GLenum format)
+    {
+        switch (format)
+        {
+            case GL_R8:
+                return 1;
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGBA16F:
+            case GL_RG32F:
+            case GL_DEPTH32F_STENCIL8:
+                return 8;
+            case GL_RGB32F:
+            case GL_RGBA32F:
+                return 16;
+            default:
+                return 4;
+        }
+    }
+} // namespace
+
+RenderTargetPool::~RenderTargetPool()
+{
+    for (auto& framebuffer : framebuffers_)
+    {
+        glDeleteFramebuffers(1, &framebuffer.fbo);
+    }
+    for (auto& target : targets_)
+    {
+        glDeleteTextures(1, &target.texture);
+    }
+}
+
+GLuint RenderTargetPool::acquire(const RenderTargetDesc& desc)
+{
+    auto size = size_in_bytes(desc);
+    frame_acquires_++;
+    frame_requested_bytes_ += size;
+
+    auto itr = std::find_if(targets_.begin(), targets_.end(), [&](const Target& target)
+                            { return !target.in_use && target.desc == desc; });
+    if (itr != targets_.end())
+    {
+        frame_reuses_++;
+    }
+    else
+    {
+        Target target;
+        target.desc = desc;
+        if (desc.samples > 0)
+        {
+            glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &target.texture);
+            glTextureStorage2DMultisample(target.texture, desc.samples, desc.format, desc.width,
+                                          desc.height, GL_TRUE);
+        }
+        else
+        {
+            glCreateTextures(GL_TEXTURE_2D, 1, &target.texture);
+            glTextureStorage2D(target.texture, 1, desc.format, desc.width, desc.height);
+
+            GLint filter = is_depth_format(desc.format) ? GL_NEAREST : GL_LINEAR;
+            glTextureParameteri(target.texture, GL_TEXTURE_MIN_FILTER, filter);
+            glTextureParameteri(target.texture, GL_TEXTURE_MAG_FILTER, filter);
+            glTextureParameteri(target.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(target.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        stats_.total_allocations++;
+        stats_.allocated_bytes += size;
+        stats_.peak_allocated_bytes = std::max(stats_.peak_allocated_bytes, stats_.allocated_bytes);
+        itr = targets_.insert(targets_.end(), target);
+    }
+
+    itr->in_use = true;
+    itr->last_used_frame = stats_.frames;
+
+    in_use_bytes_ += size;
+    frame_peak_bytes_ = std::max(frame_peak_bytes_, in_use_bytes_);
+    return itr->texture;
+}
+
+void RenderTargetPool::release(GLuint texture)
+{
+    auto target = find(texture);
+    if (target && target->in_use)
+    {
+        target->in_use = false;
+        in_use_bytes_ -= size_in_bytes(target->desc);
+    }
+}
+
+GLuint RenderTargetPool::framebuffer(const std::vector<GLuint>& colour, GLuint depth,
+                                     GLenum depth_format)
+{
+    for (auto& framebuffer : framebuffers_)
+    {
+        if (framebuffer.colour == colour && framebuffer.depth == depth)
+        {
+            return framebuffer.fbo;
+        }
+    }
+
+    Framebuffer framebuffer{colour, depth, 0};
+    glCreateFramebuffers(1, &framebuffer.fbo);
+
+    std::vector<GLenum> draw_buffers;
+    for (GLenum i = 0; i < colour.size(); i++)
+    {
+        glNamedFramebufferTexture(framebuffer.fbo, GL_COLOR_ATTACHMENT0 + i, colour[i], 0);
+        draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    if (draw_buffers.size() > 1)
+    {
+        glNamedFramebufferDrawBuffers(framebuffer.fbo, static_cast<GLsizei>(draw_buffers.size()),
+                                      draw_buffers.data());
+    }
+
+    if (depth != 0)
+    {
+        auto attachment =
+            has_stencil(depth_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        glNamedFramebufferTexture(framebuffer.fbo, attachment, depth, 0);
+    }
+
+    if (auto status = glCheckNamedFramebufferStatus(framebuffer.fbo, GL_FRAMEBUFFER);
+        status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Framebuffer incomplete. Status: " << status << '\n';
+        glDeleteFramebuffers(1, &framebuffer.fbo);
+        return 0;
+    }
+
+    framebuffers_.push_back(framebuffer);
+    return framebuffer.fbo;
+}
+
+void RenderTargetPool::end_frame()
+{
+    for (auto& target : targets_)
+    {
+        target.in_use = false;
+    }
+    in_use_bytes_ = 0;
+
+    stats_.frame_peak_bytes = frame_peak_bytes_;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, frame_peak_bytes_);
+    stats_.frame_requested_bytes = frame_requested_bytes_;
+    stats_.frame_acquires = frame_acquires_;
+    stats_.frame_reuses = frame_reuses_;
+    frame_peak_bytes_ = 0;
+    frame_requested_bytes_ = 0;
+    frame_acquires_ = 0;
+    frame_reuses_ = 0;
+
+    stats_.frames++;
+    for (auto& target : targets_)
+    {
+        if (stats_.frames - target.last_used_frame > FRAMES_BEFORE_DELETE)
+        {
+            destroy(target);
+        }
+    }
+    std::erase_if(targets_, [](const Target& target) { return target.texture == 0; });
+    stats_.textures = targets_.size();
+}
+
+const RenderTargetPoolStats& RenderTargetPool::stats() const
+{
+    return stats_;
+}
+
+bool RenderTargetPool::is_depth_format(GLenum format)
+{
+    switch (format)
+    {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8:
+            return true;
+    }
+    return false;
+}
+
+std::size_t RenderTargetPool::size_in_bytes(const RenderTargetDesc& desc)
+{
+    return static_cast<std::size_t>(desc.width) * desc.height * bytes_per_pixel(desc.format) *
+           std::max(desc.samples, 1);
+}
+
+RenderTargetPool::Target* RenderTargetPool::find(GLuint texture)
+{
+    for (auto& target : targets_)
+    {
+        if (target.texture == texture && texture != 0)
+        {
+            return &target;
+        }
+    }
+    return nullptr;
+}
+
+void RenderTargetPool::destroy(Target& target)
+{
+    std::erase_if(framebuffers_,
+                  [&](Framebuffer& framebuffer)
+                  {
+                      bool attached = framebuffer.depth == target.texture ||
+                                      std::ranges::count(framebuffer.colour, target.texture) > 0;
+                      if (attached)
+                      {
+                          glDeleteFramebuffers(1, &framebuffer.fbo);
+                      }
+                      return attached;
+                  });
+
+    glDeleteTextures(1, &target.texture);
+    stats_.allocated_bytes -= size_in_bytes(target.desc);
+    target.texture = 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+/// What a pass needs from a render target, targets with equal descriptions are interchangeable
+struct RenderTargetDesc
+{
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLenum format = GL_RGBA8;
+
+    // 0 for a regular 2D texture, otherwise a multisampled texture with this many samples
+    GLsizei samples = 0;
+
+    bool operator==(const RenderTargetDesc& other) const = default;
+};
+
+struct RenderTargetPoolStats
+{
+    std::uint64_t frames = 0;
+
+    // Every texture the pool owns, whether in use or waiting to be reused
+    std::size_t textures = 0;
+    std::size_t allocated_bytes = 0;
+    std::size_t peak_allocated_bytes = 0;
+
+    // The most memory held by acquired targets at once in the last frame, and ever
+    std::size_t frame_peak_bytes = 0;
+    std::size_t peak_bytes = 0;
+
+    // What the last frame's targets would have used if no pass shared a texture
+    std::size_t frame_requested_bytes = 0;
+
+    // Acquires in the last frame, and how many of those were handed an existing texture
+    std::uint64_t frame_acquires = 0;
+    std::uint64_t frame_reuses = 0;
+    std::uint64_t total_allocations = 0;
+};
+
+/**
+    Hands out render target textures by description for the duration of a frame.
+
+    A target is acquired when a pass first writes it and released after the last pass that
+    reads it. Once released, the texture can be handed to any later acquire with the same
+    description, in this frame or the next, so passes with lifetimes that do not overlap share
+    the same memory. Textures that go unused for a few frames (such as the old size after a
+    resize) are deleted.
+
+    Framebuffers for sets of attachments are cached too, and deleted with their textures.
+*/
+class RenderTargetPool
+{
+  public:
+    RenderTargetPool() = default;
+    RenderTargetPool(RenderTargetPool&& other) noexcept = delete;
+    RenderTargetPool(const RenderTargetPool& other) = delete;
+    RenderTargetPool& operator=(RenderTargetPool&& other) noexcept = delete;
+    RenderTargetPool& operator=(const RenderTargetPool& other) = delete;
+    ~RenderTargetPool();
+
+    GLuint acquire(const RenderTargetDesc& desc);
+
+    /// The texture may be handed out again by the next acquire, so must not be used after this
+    void release(GLuint texture);
+
+    /// A framebuffer with the given textures attached, depth may be 0. The textures do not have
+    /// to come from the pool. Returns 0 (after printing why) if the framebuffer is incomplete
+    GLuint framebuffer(const std::vector<GLuint>& colour, GLuint depth, GLenum depth_format);
+
+    /// Releases anything still acquired and deletes textures that have not been used lately
+    void end_frame();
+
+    const RenderTargetPoolStats& stats() const;
+
+    static bool is_depth_format(GLenum format);
+    static std::size_t size_in_bytes(const RenderTargetDesc& desc);
+
+  private:
+    struct Target
+    {
+        RenderTargetDesc desc;
+        GLuint texture = 0;
+        bool in_use = false;
+        std::uint64_t last_used_frame = 0;
+    };
+
+    struct Framebuffer
+    {
+        std::vector<GLuint> colour;
+        GLuint depth = 0;
+        GLuint fbo = 0;
+    };
+
+    Target* find(GLuint texture);
+    void destroy(Target& target);
+
+    std::vector<Target> targets_;
+    std::vector<Framebuffer> framebuffers_;
+
+    RenderTargetPoolStats stats_;
+
+    // Counted through the frame, moved into the stats by end_frame()
+    std::size_t in_use_bytes_ = 0;
+    std::size_t frame_peak_bytes_ = 0;
+    std::size_t frame_requested_bytes_ = 0;
+    std::uint64_t frame_acquires_ = 0;
+    std::uint64_t frame_reuses_ = 0;
+};
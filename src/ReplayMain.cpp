@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <SFML/System/Clock.hpp>
+#include <glad/glad.h>
+
+#include "Benchmark.h"
+#include "GLReplay.h"
+#include "HeadlessContext.h"
+
+namespace
+{
+    void print_usage(const char* program)
+    {
+        std::cerr << "Usage: " << program << " <capture> [options]\n"
+                  << "  --loops <n>        Times to play the captured frames (default 10)\n"
+                  << "  --stats <path>     Where to write the frame time statistics\n";
+    }
+} // namespace
+
+/// Plays back a capture written by the game's --capture option and reports the frame times
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    fs::path capture_path = argv[1];
+    fs::path stats_path;
+    int loops = 10;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--loops" && i + 1 < argc)
+        {
+            loops = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--stats" && i + 1 < argc)
+        {
+            stats_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.create())
+    {
+        return -1;
+    }
+
+    // The replay has to be destroyed before the context
+    {
+        GLReplay replay;
+        if (!replay.load_from_file(capture_path) || !replay.run_setup())
+        {
+            return -1;
+        }
+        glFinish();
+
+        auto& header = replay.header();
+        std::cout << "Replaying " << header.frames << " frames (" << header.width << "x"
+                  << header.height << ") " << loops << " times\n";
+
+        // The first loop warms up the driver (shader compiles etc) and is not counted
+        std::vector<float> frame_times;
+        sf::Clock frame_clock;
+        for (int loop = 0; loop <= loops; loop++)
+        {
+            frame_clock.restart();
+            bool ok = replay.play_frames(
+                [&]()
+                {
+                    glFinish();
+                    auto time = frame_clock.restart().asSeconds() * 1000.0f;
+                    if (loop > 0)
+                    {
+                        frame_times.push_back(time);
+                    }
+                });
+            if (!ok)
+            {
+                return -1;
+            }
+        }
+
+        auto summary = summarise_frame_times(frame_times);
+        std::cout << "Commands per loop: " << replay.commands_per_loop() << '\n'
+                  << "Frame time (ms): mean " << summary.mean_ms << ", min " << summary.min_ms
+                  << ", max " << summary.max_ms << ", p50 " << summary.p50_ms << ", p95 "
+                  << summary.p95_ms << ", p99 " << summary.p99_ms << '\n';
+        if (!stats_path.empty())
+        {
+            write_frame_stats(stats_path, frame_times);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include "SceneGeneration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numbers>
+
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr std::size_t CHUNK_SIZE = 4096;
+
+    // How far from the terrain edges entities are kept
+    constexpr float EDGE_MARGIN = 3.0f;
+
+    // Entities per cluster when using Distribution::Clusters
+    constexpr int CLUSTER_SIZE = 64;
+
+    enum class Category : std::uint64_t
+    {
+        Box = 1,
+        Person,
+        Model,
+        Light,
+        Cluster,
+        SpotLight,
+    };
+
+    /// SplitMix64, small and fast with good enough quality for placing objects
+    class Random
+    {
+      public:
+        Random(std::uint32_t seed, Category category, std::uint64_t index)
+            : state_(seed)
+        {
+            // Mix in the category and index so every entity has an independent stream
+            state_ = next() ^ (static_cast<std::uint64_t>(category) << 56);
+            state_ = next() ^ index;
+            next();
+        }
+
+        std::uint64_t next()
+        {
+            std::uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        /// Uniform float in [min, max)
+        float range(float min, float max)
+        {
+            auto unit = static_cast<float>(next() >> 40) / static_cast<float>(1ull << 24);
+            return min + unit * (max - min);
+        }
+
+      private:
+        std::uint64_t state_;
+    };
+
+    class Placer
+    {
+      public:
+        Placer(const SceneConfig& config, Category category, int count)
+            : config_(config)
+            , category_(category)
+            , count_(count)
+            , min_(EDGE_MARGIN)
+            , max_(std::max(static_cast<float>(config.terrain_size) - EDGE_MARGIN * 2, min_))
+        {
+            if (config.distribution == Distribution::Clusters)
+            {
+                // Every category shares the same cluster centres, so the scene has hot spots
+                // with lots of different types of objects
+                int cluster_count = std::max(1, count / CLUSTER_SIZE);
+                for (int i = 0; i < cluster_count; i++)
+                {
+                    Random random(config.seed, Category::Cluster, i);
+                    clusters_.push_back({random.range(min_, max_), random.range(min_, max_)});
+                }
+            }
+        }
+
+        /// Returns the XZ position of entity `index`, along with its random stream for anything
+        /// else that needs randomising
+        glm::vec2 place(int index, Random& random) const
+        {
+            switch (config_.distribution)
+            {
+                case Distribution::Grid:
+                {
+                    int columns = static_cast<int>(std::ceil(std::sqrt(count_)));
+                    float spacing = (max_ - min_) / std::max(columns, 1);
+                    return {min_ + (index % columns + 0.5f) * spacing,
+                            min_ + (index / columns + 0.5f) * spacing};
+                }
+
+                case Distribution::Clusters:
+                {
+                    auto centre = clusters_[random.next() % clusters_.size()];
+                    float angle = random.range(0.0f, 2.0f * std::numbers::pi_v<float>);
+                    float distance = random.range(0.0f, 1.0f) * random.range(0.0f, 16.0f);
+                    return glm::clamp(
+                        centre + glm::vec2{std::cos(angle), std::sin(angle)} * distance,
+                        glm::vec2{min_}, glm::vec2{max_});
+                }
+
+                case Distribution::Random:
+                default:
+                    return {random.range(min_, max_), random.range(min_, max_)};
+            }
+        }
+
+        Random random_for(int index) const
+        {
+            return {config_.seed, category_, static_cast<std::uint64_t>(index)};
+        }
+
+      private:
+        const SceneConfig& config_;
+        Category category_;
+        int count_;
+        float min_;
+        float max_;
+        std::vector<glm::vec2> clusters_;
+    };
+
+    /// Fills `out` with `count` transforms in parallel, f(index, xz, random) creates each one
+    template <typename T, typename F>
+    void generate(const SceneConfig& config, ThreadPool& thread_pool, Category category,
+                  int count, std::vector<T>& out, F f)
+    {
+        Placer placer(config, category, count);
+        out.resize(count);
+        thread_pool.parallel_for(out.size(), CHUNK_SIZE,
+                                 [&](std::size_t begin, std::size_t end)
+                                 {
+                                     for (auto i = begin; i < end; i++)
+                                     {
+                                         auto index = static_cast<int>(i);
+                                         auto random = placer.random_for(index);
+                                         auto xz = placer.place(index, random);
+                                         out[i] = f(index, xz, random);
+                                     }
+                                 });
+    }
+} // namespace
+
+glm::vec3 OrbitingLight::position_at(float time) const
+{
+    float angle = phase + speed * time;
+    return centre + glm::vec3{-std::cos(angle), 0.0f, std::sin(angle)} * radius;
+}
+
+float OrbitingLight::intensity_at(float time) const
+{
+    // Two waves at unrelated rates multiplied together, so the flicker never visibly repeats
+    float wave = std::sin(time * 11.0f + phase * 5.0f) * std::sin(time * 3.7f + phase * 13.0f);
+    return 1.0f - flicker * std::max(wave, 0.0f);
+}
+
+Scene generate_scene(const SceneConfig& config, ThreadPool& thread_pool)
+{
+    Scene scene;
+    scene.terrain_size = config.terrain_size;
+
+    generate(config, thread_pool, Category::Box, config.boxes, scene.boxes,
+             [](int, glm::vec2 xz, Random& random)
+             {
+                 return Transform{{xz.x, 0.0f, xz.y}, {0.0f, random.range(0.0f, 360.0f), 0.0f}};
+             });
+
+    generate(config, thread_pool, Category::Person, config.people, scene.people,
+             [](int, glm::vec2 xz, Random&) { return Transform{{xz.x, 0.0f, xz.y}}; });
+
+    generate(config, thread_pool, Category::Model, config.models, scene.models,
+             [](int index, glm::vec2 xz, Random&)
+             {
+                 // Keep the original backpack where it always was
+                 return index == 0 ? Transform{{30.0f, 5.0f, 30.0f}}
+                                   : Transform{{xz.x, 5.0f, xz.y}};
+             });
+
+    generate(config, thread_pool, Category::Light, config.lights, scene.lights,
+             [](int index, glm::vec2 xz, Random& random)
+             {
+                 // The first light follows the same orbit the single point light always had
+                 OrbitingLight light;
+                 if (index == 0)
+                 {
+                     light.radius = 3.0f / 0.55f;
+                     light.centre = {20.0f + light.radius, 5.0f, 20.0f};
+                     light.speed = 0.55f;
+                     return light;
+                 }
+                 light.centre = {xz.x, random.range(1.0f, 6.0f), xz.y};
+                 light.colour = {random.range(0.3f, 1.0f), random.range(0.3f, 1.0f),
+                                 random.range(0.3f, 1.0f)};
+                 light.radius = random.range(0.0f, 8.0f);
+                 light.speed = random.range(-1.0f, 1.0f);
+                 light.phase = random.range(0.0f, 2.0f * std::numbers::pi_v<float>);
+                 light.flicker = random.range(0.0f, 0.8f);
+                 return light;
+             });
+
+    generate(config, thread_pool, Category::SpotLight, config.spot_lights, scene.spot_lights,
+             [](int, glm::vec2 xz, Random& random)
+             {
+                 HangingSpotLight light;
+                 light.position = {xz.x, random.range(4.0f, 7.0f), xz.y};
+                 light.direction = glm::normalize(glm::vec3{
+                     random.range(-0.4f, 0.4f), -1.0f, random.range(-0.4f, 0.4f)});
+                 light.colour = {random.range(0.6f, 1.0f), random.range(0.5f, 0.9f),
+                                 random.range(0.3f, 0.7f)};
+                 light.cutoff = random.range(15.0f, 35.0f);
+                 return light;
+             });
+
+    std::cout << "Generated scene with seed " << config.seed << ": " << scene.boxes.size()
+              << " boxes, " << scene.people.size() << " people, " << scene.models.size()
+              << " models, " << scene.lights.size() << " point lights, "
+              << scene.spot_lights.size() << " spot lights on a " << config.terrain_size
+              << "x" << config.terrain_size << " terrain.\n";
+    return scene;
+}
+
+bool parse_distribution(std::string_view name, Distribution& distribution)
+{
+    if (name == "random")
+    {
+        distribution = Distribution::Random;
+    }
+    else if (name == "grid")
+    {
+        distribution = Distribution::Grid;
+    }
+    else if (name == "clusters")
+    {
+        distribution = Distribution::Clusters;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
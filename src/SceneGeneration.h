@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Transform.h"
+
+class ThreadPool;
+
+enum class Distribution
+{
+    Random,
+    Grid,
+    Clusters,
+};
+
+/// Everything that decides what gets placed in the scene, the same config always generates the
+/// same scene
+struct SceneConfig
+{
+    std::uint32_t seed = 1;
+
+    int boxes = 25;
+    int people = 50;
+    int models = 1;
+    int lights = 1;
+    int spot_lights = 0;
+    int terrain_size = 128;
+
+    Distribution distribution = Distribution::Random;
+};
+
+/// A point light that orbits a fixed centre, so its position is purely a function of time
+struct OrbitingLight
+{
+    glm::vec3 centre{0.0f};
+    glm::vec3 colour{1.0f};
+    float radius = 0.0f;
+    float speed = 0.0f;
+    float phase = 0.0f;
+
+    // How far the intensity dips when the light flickers, 0 for a steady light
+    float flicker = 0.0f;
+
+    [[nodiscard]] glm::vec3 position_at(float time) const;
+    [[nodiscard]] float intensity_at(float time) const;
+};
+
+/// A spot light hanging over the terrain, pointing roughly downwards. These never move
+struct HangingSpotLight
+{
+    glm::vec3 position{0.0f};
+    glm::vec3 direction{0.0f, -1.0f, 0.0f};
+    glm::vec3 colour{1.0f};
+
+    // Half angle of the cone in degrees
+    float cutoff = 25.0f;
+};
+
+struct Scene
+{
+    int terrain_size = 0;
+
+    std::vector<Transform> boxes;
+    std::vector<Transform> people;
+    std::vector<Transform> models;
+    std::vector<OrbitingLight> lights;
+    std::vector<HangingSpotLight> spot_lights;
+};
+
+/// Places every entity in parallel, each from its own seeded random stream so the result does not
+/// depend on the number of threads or the order they run in
+[[nodiscard]] Scene generate_scene(const SceneConfig& config, ThreadPool& thread_pool);
+
+bool parse_distribution(std::string_view name, Distribution& distribution);
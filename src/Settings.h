@@ -34,4 +34,10 @@ struct Settings
     float material_shine = 32.0f;
 
     bool grass = true;
+
+    // Light the scene from a G-buffer instead of while drawing it
+    bool deferred = false;
+
+    // Shadows from the moonlight, the flashlight and the point light nearest the camera
+    bool shadows = true;
 };
\ No newline at end of file
@@ -141,6 +141,11 @@ void Shader::set_uniform(const std::string& name, float value)
     glProgramUniform1f(program_, get_uniform_location(name), value);
 }
 
+void Shader::set_uniform(const std::string& name, const glm::vec2& vect)
+{
+    glProgramUniform2fv(program_, get_uniform_location(name), 1, glm::value_ptr(vect));
+}
+
 void Shader::set_uniform(const std::string& name, const glm::vec3& vect)
 {
     glProgramUniform3fv(program_, get_uniform_location(name), 1, glm::value_ptr(vect));
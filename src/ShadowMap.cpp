@@ -0,0 +1,206 @@
+#include "ShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    constexpr float NEAR_PLANE = 0.05f;
+
+    // Must match the soft edge past the cutoff in the scene shaders
+    constexpr float SPOT_LIGHT_EDGE_DEGREES = 6.0f;
+
+    // Spot light views wider than this are clamped, as the edges of a wide projection get few
+    // texels
+    constexpr float MAX_SPOT_ANGLE_DEGREES = 80.0f;
+
+    // Texels past the edge of each cube face
+    constexpr float CUBE_FACE_MARGIN = 2.0f;
+
+    GLuint create_depth_texture(const RenderTargetDesc& desc)
+    {
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, 1, desc.format, desc.width, desc.height);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTextureParameteri(texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        // Outside the map is never in shadow
+        float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, border);
+        return texture;
+    }
+
+    glm::vec3 up_vector(const glm::vec3& direction)
+    {
+        return std::abs(direction.y) < 0.99f ? glm::vec3{0, 1, 0} : glm::vec3{1, 0, 0};
+    }
+} // namespace
+
+ShadowMap::~ShadowMap()
+{
+    glDeleteTextures(1, &texture_);
+    glDeleteTextures(1, &cache_texture_);
+}
+
+void ShadowMap::create(GLsizei tile_size, int columns, int rows)
+{
+    tile_size_ = tile_size;
+    columns_ = columns;
+    desc_ = {tile_size * columns, tile_size * rows, GL_DEPTH_COMPONENT24};
+    texture_ = create_depth_texture(desc_);
+    cache_texture_ = create_depth_texture(desc_);
+}
+
+void ShadowMap::set_views(const std::vector<glm::mat4>& view_projections)
+{
+    if (view_projections != cached_views_)
+    {
+        cache_valid_ = false;
+    }
+    view_projections_ = view_projections;
+    frustums_.clear();
+    for (auto& view_projection : view_projections)
+    {
+        frustums_.emplace_back(view_projection);
+    }
+
+    stats_.static_casters = 0;
+    stats_.dynamic_casters = 0;
+    stats_.culled_casters = 0;
+    stats_.frames++;
+}
+
+void ShadowMap::cull(const std::vector<glm::mat4>& model_matrices, const BoundingSphere& bounds,
+                     bool is_static, std::vector<std::vector<glm::mat4>>& visible)
+{
+    visible.resize(frustums_.size());
+    for (std::size_t view = 0; view < frustums_.size(); view++)
+    {
+        auto& frustum = frustums_[view];
+        auto& instances = visible[view];
+        for (auto& model_matrix : model_matrices)
+        {
+            auto centre = glm::vec3{model_matrix * glm::vec4{bounds.centre, 1.0f}};
+            if (frustum.intersects_sphere(centre, bounds.radius))
+            {
+                instances.push_back(model_matrix);
+            }
+        }
+
+        auto drawn = instances.size();
+        (is_static ? stats_.static_casters : stats_.dynamic_casters) += drawn;
+        stats_.culled_casters += model_matrices.size() - drawn;
+    }
+}
+
+bool ShadowMap::cache_valid() const
+{
+    return cache_valid_;
+}
+
+void ShadowMap::validate_cache()
+{
+    cached_views_ = view_projections_;
+    cache_valid_ = true;
+    stats_.cache_redraws++;
+}
+
+std::size_t ShadowMap::view_count() const
+{
+    return view_projections_.size();
+}
+
+const glm::mat4& ShadowMap::view_projection(std::size_t view) const
+{
+    return view_projections_[view];
+}
+
+glm::ivec4 ShadowMap::viewport(std::size_t view) const
+{
+    auto column = static_cast<int>(view) % columns_;
+    auto row = static_cast<int>(view) / columns_;
+    return {column * tile_size_, row * tile_size_, tile_size_, tile_size_};
+}
+
+glm::mat4 ShadowMap::sample_matrix(std::size_t view) const
+{
+    // Clip space [-1, 1] to the tile's texture coordinates and the depth to [0, 1]
+    auto size = glm::vec2{static_cast<float>(desc_.width), static_cast<float>(desc_.height)};
+    auto area = glm::vec4{viewport(view)} / glm::vec4{size, size};
+    glm::mat4 tile{1.0f};
+    tile[0][0] = area.z * 0.5f;
+    tile[1][1] = area.w * 0.5f;
+    tile[2][2] = 0.5f;
+    tile[3] = {area.x + area.z * 0.5f, area.y + area.w * 0.5f, 0.5f, 1.0f};
+    return tile * view_projections_[view];
+}
+
+float ShadowMap::texel_size(std::size_t view) const
+{
+    // The view is a rotation, so the length of the first row is the projection's x scale,
+    // 1 / tan(fov / 2)
+    auto& view_projection = view_projections_[view];
+    auto x_scale = glm::length(
+        glm::vec3{view_projection[0][0], view_projection[1][0], view_projection[2][0]});
+    return 2.0f / (x_scale * static_cast<float>(tile_size_));
+}
+
+GLuint ShadowMap::texture() const
+{
+    return texture_;
+}
+
+GLuint ShadowMap::cache_texture() const
+{
+    return cache_texture_;
+}
+
+const RenderTargetDesc& ShadowMap::desc() const
+{
+    return desc_;
+}
+
+const ShadowMapStats& ShadowMap::stats() const
+{
+    return stats_;
+}
+
+glm::mat4 spot_light_view_projection(const glm::vec3& position, const glm::vec3& direction,
+                                     float cutoff_degrees, float range)
+{
+    auto angle = std::min(cutoff_degrees + SPOT_LIGHT_EDGE_DEGREES, MAX_SPOT_ANGLE_DEGREES);
+    auto projection = glm::perspective(glm::radians(angle * 2.0f), 1.0f, NEAR_PLANE, range);
+    return projection * glm::lookAt(position, position + direction, up_vector(direction));
+}
+
+std::array<glm::mat4, 6> point_light_view_projections(const glm::vec3& position, float range,
+                                                      GLsizei tile_size)
+{
+    // tan(fov / 2) = 1 + margin puts the edge of each face the margin in from the tile's edge
+    float half_extent = 1.0f + 2.0f * CUBE_FACE_MARGIN / static_cast<float>(tile_size);
+    auto projection = glm::perspective(2.0f * std::atan(half_extent), 1.0f, NEAR_PLANE, range);
+
+    const std::array<glm::vec3, 6> directions = {{
+        {1, 0, 0},
+        {-1, 0, 0},
+        {0, 1, 0},
+        {0, -1, 0},
+        {0, 0, 1},
+        {0, 0, -1},
+    }};
+    std::array<glm::mat4, 6> view_projections;
+    for (std::size_t face = 0; face < directions.size(); face++)
+    {
+        auto& direction = directions[face];
+        view_projections[face] =
+            projection * glm::lookAt(position, position + direction, up_vector(direction));
+    }
+    return view_projections;
+}
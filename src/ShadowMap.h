@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "MeshGeneration.h"
+#include "RenderTargetPool.h"
+
+struct ShadowMapStats
+{
+    // Instances that were drawn into the map this frame, and that were culled
+    std::size_t static_casters = 0;
+    std::size_t dynamic_casters = 0;
+    std::size_t culled_casters = 0;
+
+    // How often the static casters had to be drawn again, because the light moved
+    std::uint64_t cache_redraws = 0;
+    std::uint64_t frames = 0;
+};
+
+/**
+    A depth map of the scene from a light, with each view of the light (one for a spot light,
+    six cube faces for a point light) in its own tile of the one texture.
+
+    Most casters never move, so they are drawn into a cache that is only redrawn when the views
+    change. Each frame the cache is copied into the map and the casters that move are drawn over
+    it, so a light that holds still only costs the copy and its moving casters.
+
+    Both textures compare against the reference depth when sampled with a sampler2DShadow, with
+    bilinear filtering for 2x2 PCF.
+*/
+class ShadowMap
+{
+  public:
+    ShadowMap() = default;
+    ShadowMap(ShadowMap&& other) noexcept = delete;
+    ShadowMap(const ShadowMap& other) = delete;
+    ShadowMap& operator=(ShadowMap&& other) noexcept = delete;
+    ShadowMap& operator=(const ShadowMap& other) = delete;
+    ~ShadowMap();
+
+    void create(GLsizei tile_size, int columns, int rows);
+
+    /// Sets this frame's views of the light, in tile order. The cache is invalidated when any
+    /// of them changed since the cache was drawn
+    void set_views(const std::vector<glm::mat4>& view_projections);
+
+    /// Appends the model matrices of the instances that touch each view, one list per view
+    void cull(const std::vector<glm::mat4>& model_matrices, const BoundingSphere& bounds,
+              bool is_static, std::vector<std::vector<glm::mat4>>& visible);
+
+    /// Whether the cache holds the static casters for the current views
+    bool cache_valid() const;
+
+    /// Call once the static casters have been drawn for the current views
+    void validate_cache();
+
+    std::size_t view_count() const;
+    const glm::mat4& view_projection(std::size_t view) const;
+
+    /// The area of the map the view renders to, x, y, width and height
+    glm::ivec4 viewport(std::size_t view) const;
+
+    /// Maps a world position to the view's tile in the map, with the depth in [0, 1]
+    glm::mat4 sample_matrix(std::size_t view) const;
+
+    /// The width a texel of the view covers at a distance of 1 from the light
+    float texel_size(std::size_t view) const;
+
+    GLuint texture() const;
+    GLuint cache_texture() const;
+    const RenderTargetDesc& desc() const;
+
+    const ShadowMapStats& stats() const;
+
+  private:
+    GLuint texture_ = 0;
+    GLuint cache_texture_ = 0;
+    RenderTargetDesc desc_;
+
+    GLsizei tile_size_ = 0;
+    int columns_ = 1;
+
+    std::vector<glm::mat4> view_projections_;
+    std::vector<Frustum> frustums_;
+
+    // The views the cache was drawn with
+    std::vector<glm::mat4> cached_views_;
+    bool cache_valid_ = false;
+
+    ShadowMapStats stats_;
+};
+
+/// A spot light's single view, covering its cone (and the soft edge past the cutoff) out to
+/// the range
+[[nodiscard]] glm::mat4 spot_light_view_projection(const glm::vec3& position,
+                                                    const glm::vec3& direction,
+                                                    float cutoff_degrees, float range);
+
+/// The six cube face views of a point light in the order +x, -x, +y, -y, +z, -z. Each is a
+/// couple of texels wider than 90 degrees, so filtering at the edge of a face never reads the
+/// tile next to it
+[[nodiscard]] std::array<glm::mat4, 6> point_light_view_projections(const glm::vec3& position,
+                                                                    float range,
+                                                                    GLsizei tile_size);
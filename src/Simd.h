@@ -0,0 +1,137 @@
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPOOKY_SSE2 1
+#include <emmintrin.h>
+#else
+#include <algorithm>
+#endif
+
+/**
+    Four floats worked on together, with SSE2 where the compiler targets it and plain loops
+    everywhere else (so the same code builds for any CPU).
+
+    Comparisons return a 4 bit mask with bit i set when lane i passes, like _mm_movemask_ps.
+*/
+struct Float4
+{
+#ifdef SPOOKY_SSE2
+    __m128 v;
+
+    static Float4 load(const float* values)
+    {
+        return {_mm_loadu_ps(values)};
+    }
+
+    static Float4 broadcast(float value)
+    {
+        return {_mm_set1_ps(value)};
+    }
+
+    void store(float* values) const
+    {
+        _mm_storeu_ps(values, v);
+    }
+
+    friend Float4 operator+(Float4 a, Float4 b)
+    {
+        return {_mm_add_ps(a.v, b.v)};
+    }
+
+    friend Float4 operator-(Float4 a, Float4 b)
+    {
+        return {_mm_sub_ps(a.v, b.v)};
+    }
+
+    friend Float4 operator*(Float4 a, Float4 b)
+    {
+        return {_mm_mul_ps(a.v, b.v)};
+    }
+
+    friend Float4 min(Float4 a, Float4 b)
+    {
+        return {_mm_min_ps(a.v, b.v)};
+    }
+
+    friend Float4 max(Float4 a, Float4 b)
+    {
+        return {_mm_max_ps(a.v, b.v)};
+    }
+
+    friend int less_mask(Float4 a, Float4 b)
+    {
+        return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+    }
+
+    friend int less_equal_mask(Float4 a, Float4 b)
+    {
+        return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v));
+    }
+#else
+    float v[4];
+
+    static Float4 load(const float* values)
+    {
+        return {{values[0], values[1], values[2], values[3]}};
+    }
+
+    static Float4 broadcast(float value)
+    {
+        return {{value, value, value, value}};
+    }
+
+    void store(float* values) const
+    {
+        std::copy(v, v + 4, values);
+    }
+
+    template <typename F>
+    static Float4 apply(Float4 a, Float4 b, F f)
+    {
+        return {{f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3])}};
+    }
+
+    template <typename F>
+    static int mask(Float4 a, Float4 b, F f)
+    {
+        return f(a.v[0], b.v[0]) | f(a.v[1], b.v[1]) << 1 | f(a.v[2], b.v[2]) << 2 |
+               f(a.v[3], b.v[3]) << 3;
+    }
+
+    friend Float4 operator+(Float4 a, Float4 b)
+    {
+        return apply(a, b, [](float x, float y) { return x + y; });
+    }
+
+    friend Float4 operator-(Float4 a, Float4 b)
+    {
+        return apply(a, b, [](float x, float y) { return x - y; });
+    }
+
+    friend Float4 operator*(Float4 a, Float4 b)
+    {
+        return apply(a, b, [](float x, float y) { return x * y; });
+    }
+
+    // Same argument order as _mm_min_ps/_mm_max_ps, so NaNs come out the same
+    friend Float4 min(Float4 a, Float4 b)
+    {
+        return apply(a, b, [](float x, float y) { return x < y ? x : y; });
+    }
+
+    friend Float4 max(Float4 a, Float4 b)
+    {
+        return apply(a, b, [](float x, float y) { return x > y ? x : y; });
+    }
+
+    friend int less_mask(Float4 a, Float4 b)
+    {
+        return mask(a, b, [](float x, float y) { return static_cast<int>(x < y); });
+    }
+
+    friend int less_equal_mask(Float4 a, Float4 b)
+    {
+        return mask(a, b, [](float x, float y) { return static_cast<int>(x <= y); });
+    }
+#endif
+};
@@ -0,0 +1,176 @@
+#include "Simulation.h"
+
+#include <cmath>
+
+#include <SFML/System/Sleep.hpp>
+
+#include "Profiler.h"
+
+namespace
+{
+    /// Lerps between two angles in degrees, taking the shortest way around the circle
+    float interpolate_angle(float from, float to, float t)
+    {
+        float difference = std::fmod(to - from + 540.0f, 360.0f) - 180.0f;
+        return from + difference * t;
+    }
+} // namespace
+
+Transform interpolate(const Transform& from, const Transform& to, float t)
+{
+    Transform transform;
+    transform.position = glm::mix(from.position, to.position, t);
+    for (int i = 0; i < 3; i++)
+    {
+        transform.rotation[i] = interpolate_angle(from.rotation[i], to.rotation[i], t);
+    }
+    return transform;
+}
+
+void interpolate(const SimulationState& from, const SimulationState& to, float t,
+                 SimulationState& out)
+{
+    out.camera = interpolate(from.camera, to.camera, t);
+    out.time = glm::mix(from.time, to.time, t);
+    out.tick = to.tick;
+
+    // Lights are only ever added at startup, so the counts always match
+    out.lights.resize(to.lights.size());
+    for (std::size_t i = 0; i < to.lights.size(); i++)
+    {
+        if (i < from.lights.size())
+        {
+            out.lights[i].position = glm::mix(from.lights[i].position, to.lights[i].position, t);
+            out.lights[i].intensity =
+                glm::mix(from.lights[i].intensity, to.lights[i].intensity, t);
+        }
+        else
+        {
+            out.lights[i] = to.lights[i];
+        }
+    }
+}
+
+SimulationThread::SimulationThread(const SimulationState& initial_state,
+                                   std::vector<OrbitingLight> lights)
+    : lights_(std::move(lights))
+    , previous_state_(initial_state)
+    , state_(initial_state)
+{
+    for (auto& light : lights_)
+    {
+        state_.lights.push_back(
+            {light.position_at(state_.time), light.intensity_at(state_.time)});
+    }
+    previous_state_ = state_;
+
+    // Publish the initial state so the render thread has something to draw before the first
+    // tick has run
+    auto& snapshot = snapshots_.write_buffer();
+    snapshot.previous = previous_state_;
+    snapshot.current = state_;
+    snapshot.current_time = std::chrono::steady_clock::now();
+    snapshots_.publish();
+
+    input_.write_buffer().camera_rotation = state_.camera.rotation;
+    input_.publish();
+}
+
+void SimulationThread::start()
+{
+    thread_ = std::jthread([this](std::stop_token stop_token) { run(stop_token); });
+}
+
+void SimulationThread::stop()
+{
+    if (thread_.joinable())
+    {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+void SimulationThread::set_input(const SimulationInput& input)
+{
+    input_.write_buffer() = input;
+    input_.publish();
+}
+
+const SimulationSnapshot& SimulationThread::latest_snapshot()
+{
+    snapshots_.update();
+    return snapshots_.read_buffer();
+}
+
+void SimulationThread::interpolate_state(SimulationState& out)
+{
+    using Seconds = std::chrono::duration<float>;
+
+    // Rendering runs one tick behind the simulation, blending from the previous tick to the
+    // current one as time moves towards the next tick
+    const auto& snapshot = latest_snapshot();
+    auto since_tick = Seconds(std::chrono::steady_clock::now() - snapshot.current_time);
+    float t = glm::clamp(since_tick.count() * TICK_RATE, 0.0f, 1.0f);
+
+    interpolate(snapshot.previous, snapshot.current, t, out);
+}
+
+void SimulationThread::run(std::stop_token stop_token)
+{
+    Profiler::set_thread_name("Simulation");
+
+    TimeStep<TICK_RATE> time_step;
+    SimulationInput input;
+
+    while (!stop_token.stop_requested())
+    {
+        if (input_.update())
+        {
+            input = input_.read_buffer();
+        }
+
+        bool ticked = false;
+        time_step.update(
+            [&](auto dt)
+            {
+                previous_state_ = state_;
+                tick(input, dt);
+                ticked = true;
+            });
+
+        if (ticked)
+        {
+            // Backdate the tick by the leftover lag, so the render thread's interpolation factor
+            // matches the one the time step would give
+            auto lag = std::chrono::duration<float>(time_step.interpolation() *
+                                                    time_step.time_per_update().asSeconds());
+
+            auto& snapshot = snapshots_.write_buffer();
+            snapshot.previous = previous_state_;
+            snapshot.current = state_;
+            snapshot.current_time =
+                std::chrono::steady_clock::now() -
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(lag);
+            snapshots_.publish();
+        }
+
+        sf::sleep(time_step.time_until_update());
+    }
+}
+
+void SimulationThread::tick(const SimulationInput& input, sf::Time dt)
+{
+    PROFILE_ZONE("Simulation tick");
+    state_.time += dt.asSeconds();
+
+    state_.camera.position += input.translate * dt.asSeconds();
+    state_.camera.rotation = input.camera_rotation;
+
+    for (std::size_t i = 0; i < lights_.size(); i++)
+    {
+        state_.lights[i].position = lights_[i].position_at(state_.time);
+        state_.lights[i].intensity = lights_[i].intensity_at(state_.time);
+    }
+
+    state_.tick++;
+}
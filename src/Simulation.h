@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <SFML/System/Clock.hpp>
+#include <glm/glm.hpp>
+
+#include "SceneGeneration.h"
+#include "Transform.h"
+#include "TripleBuffer.h"
+
+template <int Ticks>
+class TimeStep
+{
+  public:
+    /// Most ticks to run in a single update() before giving up on catching up, stops a slow
+    /// tick from causing an ever growing backlog of ticks (the "spiral of death")
+    static constexpr int MAX_CATCH_UP_TICKS = 5;
+
+    template <typename F>
+    void update(F f)
+    {
+        sf::Time time = timer_.getElapsedTime();
+        sf::Time elapsed = time - last_time_;
+        last_time_ = time;
+        lag_ += elapsed;
+
+        int ticks = 0;
+        while (lag_ >= timePerUpdate_)
+        {
+            if (ticks++ == MAX_CATCH_UP_TICKS)
+            {
+                lag_ = sf::Time::Zero;
+                break;
+            }
+            lag_ -= timePerUpdate_;
+            f(timePerUpdate_);
+        }
+    }
+
+    /// How far between the last tick and the next tick the leftover lag is, between 0 and 1
+    float interpolation() const
+    {
+        return lag_ / timePerUpdate_;
+    }
+
+    /// How long until the next call to update() will run a tick
+    sf::Time time_until_update() const
+    {
+        sf::Time since_update = timer_.getElapsedTime() - last_time_ + lag_;
+        return since_update >= timePerUpdate_ ? sf::Time::Zero : timePerUpdate_ - since_update;
+    }
+
+    sf::Time time_per_update() const
+    {
+        return timePerUpdate_;
+    }
+
+  private:
+    const sf::Time timePerUpdate_ = sf::seconds(1.f / Ticks);
+    sf::Clock timer_;
+    sf::Time last_time_ = sf::Time::Zero;
+    sf::Time lag_ = sf::Time::Zero;
+};
+
+/// Input gathered by the render thread (which owns the window) for the simulation to consume
+struct SimulationInput
+{
+    glm::vec3 translate{0.0f};
+    glm::vec3 camera_rotation{0.0f};
+};
+
+struct LightState
+{
+    glm::vec3 position{0.0f};
+    float intensity = 1.0f;
+};
+
+/// Immutable snapshot of everything that moves, published by the simulation once per tick
+struct SimulationState
+{
+    Transform camera;
+    std::vector<LightState> lights;
+
+    // Simulated seconds, advances by exactly one tick length per tick
+    float time = 0.0f;
+    std::uint64_t tick = 0;
+};
+
+/// The two most recent ticks, rendering blends between them to hide the tick rate
+struct SimulationSnapshot
+{
+    SimulationState previous;
+    SimulationState current;
+
+    // The time `current` was simulated up to, on the clock shared by both threads
+    std::chrono::steady_clock::time_point current_time;
+};
+
+[[nodiscard]] Transform interpolate(const Transform& from, const Transform& to, float t);
+
+/// Writes into `out` rather than returning a new state, so its light list keeps its capacity
+/// from frame to frame
+void interpolate(const SimulationState& from, const SimulationState& to, float t,
+                 SimulationState& out);
+
+/**
+    Runs the fixed timestep simulation on its own thread.
+
+    Input flows in and state snapshots flow out through lock-free triple buffers, so a slow
+    frame never holds up a tick and a slow tick never holds up a frame.
+*/
+class SimulationThread
+{
+  public:
+    /// Ticks per second, rendering interpolates between ticks so this can be kept low
+    static constexpr int TICK_RATE = 30;
+
+    SimulationThread(const SimulationState& initial_state, std::vector<OrbitingLight> lights);
+
+    void start();
+    void stop();
+
+    /// Render thread: hands the most recent input to the simulation
+    void set_input(const SimulationInput& input);
+
+    /// Render thread: returns the newest snapshot the simulation has published
+    const SimulationSnapshot& latest_snapshot();
+
+    /// Render thread: blends the newest snapshot to the current time into `out`, which should be
+    /// kept across frames so the lights are not reallocated every frame
+    void interpolate_state(SimulationState& out);
+
+  private:
+    void run(std::stop_token stop_token);
+    void tick(const SimulationInput& input, sf::Time dt);
+
+    TripleBuffer<SimulationInput> input_;
+    TripleBuffer<SimulationSnapshot> snapshots_;
+
+    const std::vector<OrbitingLight> lights_;
+
+    // Only ever touched by the simulation thread once it has started
+    SimulationState previous_state_;
+    SimulationState state_;
+
+    std::jthread thread_;
+};
@@ -0,0 +1,244 @@
+#include "SpriteAtlas.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // Texels of repeated edge around each sprite, and what each sprite's cell is rounded up to.
+    // The nth mip level averages 2^n texels, so with an 8 texel border on a 16 texel grid the
+    // first 4 levels only ever average texels of one sprite
+    constexpr int BORDER = 8;
+    constexpr int ALIGNMENT = 16;
+
+    int align(int size)
+    {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /// Copies the image into its cell of the atlas, repeating its edge texels out to the edges of
+    /// the cell
+    void copy_to_cell(std::vector<std::uint8_t>& atlas, int atlas_width, const sf::Image& image,
+                      const glm::ivec2& cell, const glm::ivec2& cell_size)
+    {
+        auto width = static_cast<int>(image.getSize().x);
+        auto height = static_cast<int>(image.getSize().y);
+        auto pixels = image.getPixelsPtr();
+        for (int y = 0; y < cell_size.y; y++)
+        {
+            auto source_y = std::clamp(y - BORDER, 0, height - 1);
+            auto source_row = pixels + static_cast<std::size_t>(source_y) * width * 4;
+            auto row =
+                atlas.data() + (static_cast<std::size_t>(cell.y + y) * atlas_width + cell.x) * 4;
+            for (int x = 0; x < cell_size.x; x++)
+            {
+                auto source_x = std::clamp(x - BORDER, 0, width - 1);
+                std::memcpy(row + x * 4, source_row + source_x * 4, 4);
+            }
+        }
+    }
+} // namespace
+
+SkylinePacker::SkylinePacker(int width)
+    : skyline_{{0, 0, width}}
+    , width_(width)
+{
+}
+
+bool SkylinePacker::pack(int width, int height, glm::ivec2& position)
+{
+    // Tries the rectangle at the left of every segment, where it rests on the highest segment
+    // under it, and takes the lowest
+    std::size_t best = skyline_.size();
+    int best_y = 0;
+    for (std::size_t i = 0; i < skyline_.size() && skyline_[i].x + width <= width_; i++)
+    {
+        int y = 0;
+        for (std::size_t j = i; j < skyline_.size() && skyline_[j].x < skyline_[i].x + width; j++)
+        {
+            y = std::max(y, skyline_[j].y);
+        }
+        if (best == skyline_.size() || y < best_y)
+        {
+            best = i;
+            best_y = y;
+        }
+    }
+    if (best == skyline_.size())
+    {
+        return false;
+    }
+    position = {skyline_[best].x, best_y};
+
+    // The rectangle's top replaces the segments under it, the last of which may stick out past
+    // it and only be cut short
+    auto end = position.x + width;
+    auto covered = skyline_.begin() + best;
+    while (covered != skyline_.end() && covered->x + covered->width <= end)
+    {
+        covered = skyline_.erase(covered);
+    }
+    if (covered != skyline_.end() && covered->x < end)
+    {
+        covered->width -= end - covered->x;
+        covered->x = end;
+    }
+    skyline_.insert(skyline_.begin() + best, {position.x, best_y + height, width});
+
+    for (std::size_t i = 1; i < skyline_.size();)
+    {
+        if (skyline_[i - 1].y == skyline_[i].y)
+        {
+            skyline_[i - 1].width += skyline_[i].width;
+            skyline_.erase(skyline_.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    height_ = std::max(height_, best_y + height);
+    return true;
+}
+
+int SkylinePacker::height() const
+{
+    return height_;
+}
+
+int SpriteAtlas::add(const fs::path& diffuse, const fs::path& specular)
+{
+    sprites_.push_back({diffuse, specular});
+    return static_cast<int>(sprites_.size()) - 1;
+}
+
+bool SpriteAtlas::build(const fs::path& name, ThreadPool& thread_pool,
+                        TextureLoader& texture_loader)
+{
+    PROFILE_ZONE("Build sprite atlas");
+    if (sprites_.empty())
+    {
+        std::cerr << "The sprite atlas " << name << " has no sprites\n";
+        return false;
+    }
+
+    // The layout comes from the sizes of the sprites, so they are decoded even when the atlas is
+    // cached
+    struct SpriteImages
+    {
+        sf::Image diffuse;
+        sf::Image specular;
+        bool loaded = false;
+    };
+    std::vector<std::future<SpriteImages>> decoding;
+    for (auto& sprite : sprites_)
+    {
+        decoding.push_back(thread_pool.submit(
+            [&sprite]()
+            {
+                SpriteImages images;
+                images.loaded = load_image(images.diffuse, sprite.diffuse) &&
+                                load_image(images.specular, sprite.specular);
+                return images;
+            }));
+    }
+
+    bool loaded = true;
+    std::vector<SpriteImages> images;
+    std::vector<glm::ivec2> cell_sizes;
+    int area = 0;
+    int widest = 0;
+    for (std::size_t i = 0; i < sprites_.size(); i++)
+    {
+        auto& sprite = images.emplace_back(decoding[i].get());
+        auto size = sprite.diffuse.getSize();
+        if (!sprite.loaded || size != sprite.specular.getSize())
+        {
+            std::cerr << "Failed to load sprite " << sprites_[i].diffuse
+                      << ", its specular map must be the same size\n";
+            loaded = false;
+            continue;
+        }
+
+        auto& cell_size = cell_sizes.emplace_back(align(static_cast<int>(size.x) + BORDER * 2),
+                                                  align(static_cast<int>(size.y) + BORDER * 2));
+        area += cell_size.x * cell_size.y;
+        widest = std::max(widest, cell_size.x);
+    }
+    if (!loaded)
+    {
+        return false;
+    }
+
+    // The tallest sprites go in first, into a strip about as wide as the atlas would be if it
+    // were square
+    auto width = std::max(
+        widest, static_cast<int>(std::bit_ceil(static_cast<unsigned>(std::sqrt(area)))));
+    std::vector<std::size_t> order(sprites_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, std::greater{},
+                             [&](std::size_t i)
+                             {
+                                 return cell_sizes[i].y;
+                             });
+
+    SkylinePacker packer(width);
+    std::vector<glm::ivec2> cells(sprites_.size());
+    for (auto i : order)
+    {
+        packer.pack(cell_sizes[i].x, cell_sizes[i].y, cells[i]);
+    }
+    auto height = packer.height();
+    std::cout << "Packed " << sprites_.size() << " sprites into a " << width << "x" << height
+              << " atlas\n";
+
+    std::vector<std::uint8_t> pixels(static_cast<std::size_t>(width) * height * 4);
+    std::vector<fs::path> sources;
+    rects_.clear();
+    for (std::size_t i = 0; i < sprites_.size(); i++)
+    {
+        pack_specular(images[i].diffuse, &images[i].specular);
+        copy_to_cell(pixels, width, images[i].diffuse, cells[i], cell_sizes[i]);
+        sources.push_back(sprites_[i].diffuse);
+        sources.push_back(sprites_[i].specular);
+
+        // The atlas is flipped when it is uploaded, so the rectangle starts from the bottom
+        auto size = glm::vec2(images[i].diffuse.getSize().x, images[i].diffuse.getSize().y);
+        auto corner = glm::vec2(cells[i].x + BORDER, height - cells[i].y - BORDER - size.y);
+        auto atlas_size = glm::vec2(width, height);
+        rects_.push_back({corner / atlas_size, size / atlas_size});
+    }
+
+    sf::Image atlas;
+    atlas.create(width, height, pixels.data());
+    texture_ = texture_loader.add(name, std::move(atlas), std::move(sources));
+    return true;
+}
+
+SpriteRect SpriteAtlas::rect(int sprite, bool mirrored) const
+{
+    auto rect = rects_[sprite];
+    if (mirrored)
+    {
+        rect.offset.x += rect.size.x;
+        rect.size.x = -rect.size.x;
+    }
+    return rect;
+}
+
+int SpriteAtlas::sprite_count() const
+{
+    return static_cast<int>(sprites_.size());
+}
+
+TextureHandle SpriteAtlas::texture() const
+{
+    return texture_;
+}
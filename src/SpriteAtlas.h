@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TextureLoader.h"
+#include "Util.h"
+
+class ThreadPool;
+
+/// Where a sprite is in its atlas, in texture coordinates. Matches the std430 "Sprites" buffer in
+/// SceneVertex.glsl
+struct SpriteRect
+{
+    glm::vec2 offset{0.0f};
+    glm::vec2 size{1.0f};
+};
+
+/// Packs rectangles into a strip of a fixed width, putting each one at the lowest place on the
+/// skyline (the top edge of everything packed so far) that it fits
+class SkylinePacker
+{
+  public:
+    explicit SkylinePacker(int width);
+
+    /// Finds a place for the rectangle, returning false if it is wider than the strip
+    bool pack(int width, int height, glm::ivec2& position);
+
+    /// The top of the highest rectangle
+    int height() const;
+
+  private:
+    struct Segment
+    {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+    };
+
+    std::vector<Segment> skyline_;
+    int width_;
+    int height_ = 0;
+};
+
+/**
+    Packs the billboard sprites into one texture, with their specular maps in its alpha, so
+    billboards that all look different are still one bind and one draw. Each instance picks its
+    sprite with a rectangle of texture coordinates.
+
+    Every sprite has a border that repeats its edge texels, and starts on a multiple of 16 texels,
+    so the first few mip levels never blend in the sprites next to it, and no compressed block
+    holds two sprites.
+*/
+class SpriteAtlas
+{
+  public:
+    /// Adds a sprite, whose diffuse and specular images must be the same size
+    int add(const fs::path& diffuse, const fs::path& specular);
+
+    /// Decodes and packs every sprite, then adds the atlas to the loader, which caches it
+    /// under the name. Returns false if any sprite failed to load
+    bool build(const fs::path& name, ThreadPool& thread_pool, TextureLoader& texture_loader);
+
+    /// A mirrored sprite has a negative width, so it is read from right to left
+    SpriteRect rect(int sprite, bool mirrored = false) const;
+
+    int sprite_count() const;
+    TextureHandle texture() const;
+
+  private:
+    struct Sprite
+    {
+        fs::path diffuse;
+        fs::path specular;
+    };
+
+    std::vector<Sprite> sprites_;
+    std::vector<SpriteRect> rects_;
+    TextureHandle texture_ = 0;
+};
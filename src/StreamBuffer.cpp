@@ -0,0 +1,160 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "GLCapture.h"
+#include "GLStats.h"
+
+StreamBuffer::~StreamBuffer()
+{
+    for (auto& fence : fences_)
+    {
+        glDeleteSync(fence);
+    }
+    if (buffer_)
+    {
+        glUnmapNamedBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+}
+
+bool StreamBuffer::create(GLsizeiptr segment_size)
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment_);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment_);
+
+    // Keep every segment starting on an alignment that suits any binding
+    auto alignment = std::max(uniform_alignment_, storage_alignment_);
+    segment_size_ = (segment_size + alignment - 1) / alignment * alignment;
+    stats_.segment_size = segment_size_;
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer_);
+    glNamedBufferStorage(buffer_, segment_size_ * SEGMENTS, nullptr, flags);
+    mapped_ = static_cast<std::uint8_t*>(
+        glMapNamedBufferRange(buffer_, 0, segment_size_ * SEGMENTS, flags));
+
+    if (!mapped_)
+    {
+        std::cerr << "Failed to persistently map stream buffer of size "
+                  << segment_size_ * SEGMENTS << ".\n";
+        return false;
+    }
+    return true;
+}
+
+void StreamBuffer::begin_frame()
+{
+    head_ = 0;
+
+    auto& fence = fences_[segment_];
+    if (!fence)
+    {
+        return;
+    }
+
+    // Only flush and wait if the GPU has not already got through this segment
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        stats_.fence_waits++;
+        auto start = std::chrono::steady_clock::now();
+
+        GLenum result;
+        do
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+
+        stats_.fence_wait_ms += std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::end_frame()
+{
+    fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    stats_.frames++;
+    stats_.last_frame_usage = head_;
+    stats_.peak_frame_usage = std::max(stats_.peak_frame_usage, head_);
+
+    segment_ = (segment_ + 1) % SEGMENTS;
+}
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    GLsizeiptr start = (head_ + alignment - 1) / alignment * alignment;
+    if (start + size > segment_size_)
+    {
+        stats_.failed_allocations++;
+        return {};
+    }
+    head_ = start + size;
+
+    StreamAllocation allocation;
+    allocation.offset = segment_ * segment_size_ + start;
+    allocation.data = mapped_ + allocation.offset;
+    allocation.size = size;
+    return allocation;
+}
+
+StreamAllocation StreamBuffer::allocate_uniform(GLsizeiptr size)
+{
+    return allocate(size, uniform_alignment_);
+}
+
+StreamAllocation StreamBuffer::allocate_storage(GLsizeiptr size)
+{
+    return allocate(size, storage_alignment_);
+}
+
+StreamAllocation StreamBuffer::write_data(GLenum target, const void* data, GLsizeiptr size)
+{
+    // Zero sized ranges cannot be bound, there is nothing to read anyway
+    if (size == 0)
+    {
+        return {};
+    }
+
+    auto allocation =
+        target == GL_UNIFORM_BUFFER ? allocate_uniform(size) : allocate_storage(size);
+    if (allocation.valid())
+    {
+        std::memcpy(allocation.data, data, size);
+        GLStats::record_mapped_upload(size);
+        GLCapture::record_mapped_write(buffer_, allocation.offset, data, size);
+    }
+    return allocation;
+}
+
+void StreamBuffer::bind(GLenum target, GLuint binding, const StreamAllocation& allocation)
+{
+    if (allocation.valid())
+    {
+        glBindBufferRange(target, binding, buffer_, allocation.offset, allocation.size);
+    }
+}
+
+StreamAllocation StreamBuffer::bind_data(GLenum target, GLuint binding, const void* data,
+                                         GLsizeiptr size)
+{
+    auto allocation = write_data(target, data, size);
+    bind(target, binding, allocation);
+    return allocation;
+}
+
+GLuint StreamBuffer::id() const
+{
+    return buffer_;
+}
+
+const StreamBufferStats& StreamBuffer::stats() const
+{
+    return stats_;
+}
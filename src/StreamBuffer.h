@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+/// A chunk of the stream buffer handed out for this frame only
+struct StreamAllocation
+{
+    void* data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    bool valid() const
+    {
+        return data != nullptr;
+    }
+};
+
+struct StreamBufferStats
+{
+    std::uint64_t frames = 0;
+
+    // How many times begin_frame() found the GPU still reading the segment it wanted to write
+    std::uint64_t fence_waits = 0;
+    double fence_wait_ms = 0.0;
+
+    // Allocations that did not fit in the segment and were dropped
+    std::uint64_t failed_allocations = 0;
+
+    GLsizeiptr segment_size = 0;
+    GLsizeiptr last_frame_usage = 0;
+    GLsizeiptr peak_frame_usage = 0;
+};
+
+/**
+    Persistently mapped buffer for per-frame dynamic data (uniform blocks, instance data).
+
+    The buffer is split into SEGMENTS segments, each frame writes into its own segment and
+    fences it when done. By the time the ring wraps back around to a segment the GPU has almost
+    always finished reading it, so writes go straight into mapped memory without ever stalling
+    in glNamedBufferSubData.
+*/
+class StreamBuffer
+{
+  public:
+    static constexpr int SEGMENTS = 3;
+
+    StreamBuffer() = default;
+    StreamBuffer(StreamBuffer&& other) noexcept = delete;
+    StreamBuffer(const StreamBuffer& other) = delete;
+    StreamBuffer& operator=(StreamBuffer&& other) noexcept = delete;
+    StreamBuffer& operator=(const StreamBuffer& other) = delete;
+    ~StreamBuffer();
+
+    bool create(GLsizeiptr segment_size);
+
+    /// Waits (if needed) for the GPU to finish with the next segment, call before allocating
+    void begin_frame();
+
+    /// Fences the current segment, call after the last draw that reads this frame's data
+    void end_frame();
+
+    /// Returns an invalid allocation if the segment is full
+    StreamAllocation allocate(GLsizeiptr size, GLsizeiptr alignment);
+    StreamAllocation allocate_uniform(GLsizeiptr size);
+    StreamAllocation allocate_storage(GLsizeiptr size);
+
+    /// Allocates with the alignment for GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER and copies
+    /// the data in, returns an invalid allocation if there was no space or no data
+    StreamAllocation write_data(GLenum target, const void* data, GLsizeiptr size);
+
+    /// Binds an allocation to an indexed binding, does nothing for invalid allocations
+    void bind(GLenum target, GLuint binding, const StreamAllocation& allocation);
+
+    /// write_data() and bind() in one, for data that is only bound once
+    StreamAllocation bind_data(GLenum target, GLuint binding, const void* data, GLsizeiptr size);
+
+    GLuint id() const;
+    const StreamBufferStats& stats() const;
+
+  private:
+    std::array<GLsync, SEGMENTS> fences_{};
+    StreamBufferStats stats_;
+
+    std::uint8_t* mapped_ = nullptr;
+    GLuint buffer_ = 0;
+
+    GLsizeiptr segment_size_ = 0;
+    GLsizeiptr head_ = 0;
+    int segment_ = 0;
+
+    GLint uniform_alignment_ = 256;
+    GLint storage_alignment_ = 256;
+};
@@ -0,0 +1,364 @@
+#include "TextureArrays.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Profiler.h"
+
+namespace
+{
+    // Levels are never streamed out past the one this size, so a texture coming into view is
+    // never drawn as a flat colour while its finer levels upload
+    constexpr GLsizei MIN_STREAMED_SIZE = 32;
+
+    // About two seconds at 60fps, before an array lets go of levels it was not asked for
+    constexpr int FRAMES_BEFORE_COARSER = 120;
+
+    GLsizei coarsest_level(const TextureShape& shape)
+    {
+        GLsizei level = 0;
+        while (level + 1 < shape.levels &&
+               std::max(shape.width, shape.height) >> level > MIN_STREAMED_SIZE)
+        {
+            level++;
+        }
+        return level;
+    }
+
+    /// An array of the shape's levels from `first_level` down
+    GLuint create_array_texture(const TextureShape& shape, GLsizei first_level, int layers)
+    {
+        GLuint texture = 0;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+        glTextureStorage3D(texture, shape.levels - first_level, gl_format(shape.format),
+                           std::max(shape.width >> first_level, 1),
+                           std::max(shape.height >> first_level, 1), layers);
+
+        // Set texture wrapping and min/mag filters
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+} // namespace
+
+TextureShape texture_shape(const TextureData& data)
+{
+    return {data.format, data.width, data.height, static_cast<GLsizei>(data.levels.size())};
+}
+
+TextureArrays::TextureArrays(UploadRing& upload_ring)
+    : upload_ring_(upload_ring)
+{
+}
+
+TextureArrays::~TextureArrays()
+{
+    for (auto& array : arrays_)
+    {
+        glDeleteTextures(1, &array.texture);
+        if (array.pending_texture != 0)
+        {
+            glDeleteTextures(1, &array.pending_texture);
+        }
+    }
+}
+
+bool TextureArrays::reserve(const TextureShape& shape, int count)
+{
+    auto missing = count - free_layer_count(shape);
+    if (missing <= 0)
+    {
+        return true;
+    }
+    if (arrays_.size() >= MAX_ARRAYS)
+    {
+        std::cerr << "Out of texture arrays, " << MAX_ARRAYS << " shapes of texture at most\n";
+        return false;
+    }
+
+    Array array;
+    array.shape = shape;
+    array.texture = create_array_texture(shape, 0, missing);
+    array.layers.resize(missing);
+    array.requested_level = coarsest_level(shape);
+
+    // Handed out from the back, so in order
+    for (int layer = missing - 1; layer >= 0; layer--)
+    {
+        array.free_layers.push_back(layer);
+    }
+    arrays_.push_back(std::move(array));
+    return true;
+}
+
+bool TextureArrays::add(TextureData data, TextureLayer& layer)
+{
+    auto shape = texture_shape(data);
+    if (!reserve(shape, 1))
+    {
+        return false;
+    }
+
+    auto found = std::ranges::find_if(arrays_,
+                                      [&](const Array& array)
+                                      {
+                                          return array.shape == shape &&
+                                                 !array.free_layers.empty();
+                                      });
+    auto& array = *found;
+    layer.array = static_cast<int>(found - arrays_.begin());
+    layer.layer = array.free_layers.back();
+    array.free_layers.pop_back();
+
+    // An array being recreated needs the layer too
+    array.layers[layer.layer] = std::move(data);
+    uploads_.push_back({array.texture, layer.array, layer.layer, array.resident_level,
+                        array.resident_level});
+    if (array.pending_texture != 0)
+    {
+        uploads_.push_back({array.pending_texture, layer.array, layer.layer, array.pending_level,
+                            array.pending_level});
+        array.pending_uploads++;
+    }
+    return true;
+}
+
+void TextureArrays::remove(const TextureLayer& layer)
+{
+    auto& array = arrays_[layer.array];
+    array.free_layers.push_back(layer.layer);
+    array.layers[layer.layer].levels.clear();
+}
+
+void TextureArrays::request(const TextureLayer& layer, float screen_size)
+{
+    // Each level halves the texture, so the level needed is how many times it can be halved
+    // before it is smaller than it is on screen
+    auto& array = arrays_[layer.array];
+    auto texels = static_cast<float>(std::max(array.shape.width, array.shape.height));
+    auto level = static_cast<GLsizei>(std::floor(std::log2(texels / std::max(screen_size, 1.0f))));
+    level = std::clamp(level, 0, coarsest_level(array.shape));
+    array.requested_level = std::min(array.requested_level, level);
+}
+
+void TextureArrays::stream(std::size_t budget_bytes)
+{
+    PROFILE_ZONE("Stream textures");
+    stats_.frames++;
+    stats_.budget_bytes = budget_bytes;
+    stats_.full_bytes = 0;
+    stats_.requested_bytes = 0;
+
+    std::vector<GLsizei> levels;
+    for (auto& array : arrays_)
+    {
+        if (array.requested_level < array.target_level)
+        {
+            array.target_level = array.requested_level;
+            array.coarser_frames = 0;
+        }
+        else if (array.requested_level == array.target_level)
+        {
+            array.coarser_frames = 0;
+        }
+        else if (++array.coarser_frames >= FRAMES_BEFORE_COARSER)
+        {
+            array.target_level = array.requested_level;
+            array.coarser_frames = 0;
+        }
+        array.requested_level = coarsest_level(array.shape);
+
+        stats_.full_bytes += array_size(array, 0);
+        stats_.requested_bytes += array_size(array, array.target_level);
+        levels.push_back(array.target_level);
+    }
+
+    // Drops the finest level of the largest array until everything fits
+    auto total = stats_.requested_bytes;
+    while (total > budget_bytes)
+    {
+        auto largest = arrays_.size();
+        std::size_t largest_size = 0;
+        for (std::size_t i = 0; i < arrays_.size(); i++)
+        {
+            auto size = array_size(arrays_[i], levels[i]);
+            if (levels[i] < coarsest_level(arrays_[i].shape) && size > largest_size)
+            {
+                largest = i;
+                largest_size = size;
+            }
+        }
+        if (largest == arrays_.size())
+        {
+            break;
+        }
+        total -= largest_size - array_size(arrays_[largest], levels[largest] + 1);
+        levels[largest]++;
+    }
+
+    // One array is recreated at a time. A recreation the levels have moved away from since it
+    // started is thrown away
+    stats_.over_budget_arrays = 0;
+    bool recreating = false;
+    for (std::size_t i = 0; i < arrays_.size(); i++)
+    {
+        auto& array = arrays_[i];
+        stats_.over_budget_arrays += levels[i] != array.target_level;
+        if (array.pending_texture != 0 && array.pending_level != levels[i])
+        {
+            std::erase_if(uploads_,
+                          [&](const LayerUpload& upload)
+                          {
+                              return upload.texture == array.pending_texture;
+                          });
+            glDeleteTextures(1, &array.pending_texture);
+            array.pending_texture = 0;
+        }
+        recreating |= array.pending_texture != 0;
+    }
+    for (std::size_t i = 0; i < arrays_.size() && !recreating; i++)
+    {
+        auto& array = arrays_[i];
+        if (levels[i] == array.resident_level)
+        {
+            continue;
+        }
+
+        array.pending_texture = create_array_texture(array.shape, levels[i],
+                                                     static_cast<int>(array.layers.size()));
+        array.pending_level = levels[i];
+        array.pending_uploads = 0;
+        for (std::size_t layer = 0; layer < array.layers.size(); layer++)
+        {
+            if (!array.layers[layer].levels.empty())
+            {
+                uploads_.push_back({array.pending_texture, static_cast<int>(i),
+                                    static_cast<int>(layer), levels[i], levels[i]});
+                array.pending_uploads++;
+            }
+        }
+        if (array.pending_uploads == 0)
+        {
+            finish_pending(array);
+        }
+        recreating = true;
+    }
+
+    upload_ring_.begin_frame();
+    upload_queued();
+    upload_ring_.end_frame();
+    stats_.queued_uploads = uploads_.size();
+
+    stats_.resident_bytes = 0;
+    for (auto& array : arrays_)
+    {
+        stats_.resident_bytes += array_size(array, array.resident_level);
+    }
+}
+
+void TextureArrays::bind(GLuint first_unit) const
+{
+    for (std::size_t i = 0; i < arrays_.size(); i++)
+    {
+        glBindTextureUnit(first_unit + static_cast<GLuint>(i), arrays_[i].texture);
+    }
+}
+
+int TextureArrays::array_count() const
+{
+    return static_cast<int>(arrays_.size());
+}
+
+const TextureStreamingStats& TextureArrays::stats() const
+{
+    return stats_;
+}
+
+int TextureArrays::free_layer_count(const TextureShape& shape) const
+{
+    int count = 0;
+    for (auto& array : arrays_)
+    {
+        if (array.shape == shape)
+        {
+            count += static_cast<int>(array.free_layers.size());
+        }
+    }
+    return count;
+}
+
+std::size_t TextureArrays::array_size(const Array& array, GLsizei level) const
+{
+    std::size_t size = 0;
+    for (; level < array.shape.levels; level++)
+    {
+        size += level_size(array.shape.format, std::max(array.shape.width >> level, 1),
+                           std::max(array.shape.height >> level, 1));
+    }
+    return size * array.layers.size();
+}
+
+void TextureArrays::upload_queued()
+{
+    while (!uploads_.empty())
+    {
+        auto& upload = uploads_.front();
+        auto& array = arrays_[upload.array];
+        auto& data = array.layers[upload.layer];
+
+        // Removed layers have nothing to upload
+        if (!data.levels.empty())
+        {
+            auto height = std::max(array.shape.height >> upload.level, 1);
+            TextureUpload level;
+            level.texture = upload.texture;
+            level.level = upload.level - upload.first_level;
+            level.layer = upload.layer;
+            level.width = std::max(array.shape.width >> upload.level, 1);
+            level.height = height;
+            level.format = array.shape.format;
+            level.texels = data.levels[upload.level].data();
+
+            auto rows = upload_ring_.upload_rows(level, upload.row);
+            if (rows == 0)
+            {
+                return;
+            }
+            upload.row += rows;
+            if (upload.row < height)
+            {
+                continue;
+            }
+            upload.row = 0;
+            if (++upload.level < array.shape.levels)
+            {
+                continue;
+            }
+        }
+
+        auto texture = upload.texture;
+        uploads_.pop_front();
+        if (texture == array.pending_texture && --array.pending_uploads == 0)
+        {
+            finish_pending(array);
+        }
+    }
+}
+
+void TextureArrays::finish_pending(Array& array)
+{
+    // Anything still queued for the old texture is in the new one already
+    std::erase_if(uploads_,
+                  [&](const LayerUpload& upload)
+                  {
+                      return upload.texture == array.texture;
+                  });
+    glDeleteTextures(1, &array.texture);
+    array.texture = array.pending_texture;
+    array.resident_level = array.pending_level;
+    array.pending_texture = 0;
+    stats_.rebuilds++;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "TextureData.h"
+#include "UploadRing.h"
+
+/// Where a texture lives: a layer of the array bound to unit `first_unit + array`
+struct TextureLayer
+{
+    int array = 0;
+    int layer = 0;
+};
+
+/// Textures can only share an array when all of these match
+struct TextureShape
+{
+    TextureFormat format = TextureFormat::RGBA8;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLsizei levels = 0;
+
+    auto operator<=>(const TextureShape& other) const = default;
+};
+
+[[nodiscard]] TextureShape texture_shape(const TextureData& data);
+
+struct TextureStreamingStats
+{
+    std::uint64_t frames = 0;
+
+    // Every level of every texture, what would be on the GPU without streaming
+    std::size_t full_bytes = 0;
+
+    // The levels on the GPU now, the levels the last frame asked for, and the budget that the
+    // levels asked for are cut down to
+    std::size_t resident_bytes = 0;
+    std::size_t requested_bytes = 0;
+    std::size_t budget_bytes = 0;
+
+    // Arrays the budget kept coarser than they were asked for in the last frame
+    int over_budget_arrays = 0;
+
+    // Arrays recreated at another level, and the layers still waiting to upload
+    std::uint64_t rebuilds = 0;
+    std::size_t queued_uploads = 0;
+};
+
+/**
+    Packs textures of the same shape into the layers of GL_TEXTURE_2D_ARRAYs, so every material
+    texture can be reached from the same few bindings and picking a material is only setting
+    which array and layer to sample.
+
+    An array never changes size. When every layer of a shape is taken another array is created
+    for it, so nothing has to be copied, and reserve() sizes that array for a whole batch. Removed
+    layers are kept and given to the next texture of the same shape.
+
+    There are at most MAX_ARRAYS arrays, as each needs a texture unit of its own.
+
+    Every level of every texture is kept in memory, and each array only has the levels from the
+    finest one its textures were asked for on the GPU. A texture that gets closer asks for finer
+    levels, and one that is out of view or far away lets them go. When the levels asked for do
+    not fit in the budget, the finest level of the largest array is dropped until they do.
+
+    An array changes level by being created again with the new levels, which is uploaded while
+    the old one is still drawn with, and swapped in once complete.
+
+    Every upload, of new textures as well as of recreated arrays, is queued and goes through the
+    upload ring during stream(), as much as the ring's budget allows each frame. Textures added
+    at startup are uploaded over the first frames, rather than holding up the first one.
+*/
+class TextureArrays
+{
+  public:
+    static constexpr int MAX_ARRAYS = 8;
+
+    explicit TextureArrays(UploadRing& upload_ring);
+    TextureArrays(TextureArrays&& other) noexcept = delete;
+    TextureArrays(const TextureArrays& other) = delete;
+    TextureArrays& operator=(TextureArrays&& other) noexcept = delete;
+    TextureArrays& operator=(const TextureArrays& other) = delete;
+    ~TextureArrays();
+
+    /// Makes sure there are `count` free layers of the shape, creating one array for all that
+    /// are missing
+    bool reserve(const TextureShape& shape, int count);
+
+    /// Puts the texture in a free layer of its shape and queues the upload of the levels its
+    /// array has resident, keeping every level for streaming. Returns false (and leaves `layer`
+    /// alone) if there is no free layer and no room for another array
+    bool add(TextureData data, TextureLayer& layer);
+
+    /// Frees the layer for the next texture of its shape, its texels are left as they are
+    void remove(const TextureLayer& layer);
+
+    /// Asks for the texture to have the levels it needs this frame when the whole of it covers
+    /// `screen_size` pixels across
+    void request(const TextureLayer& layer, float screen_size);
+
+    /// Moves each array toward the levels asked for since the last call, within the budget, and
+    /// uploads what the upload ring has room for. Arrays only go coarser after going unused for
+    /// a while, so looking around does not keep recreating them
+    void stream(std::size_t budget_bytes);
+
+    /// Binds array i to unit first_unit + i
+    void bind(GLuint first_unit) const;
+
+    int array_count() const;
+
+    const TextureStreamingStats& stats() const;
+
+  private:
+    struct Array
+    {
+        TextureShape shape;
+        GLuint texture = 0;
+        std::vector<int> free_layers;
+
+        // Every level of each layer, empty for free layers
+        std::vector<TextureData> layers;
+
+        // The finest level on the GPU, the finest asked for this frame, and the level that is
+        // being streamed to
+        GLsizei resident_level = 0;
+        GLsizei requested_level = 0;
+        GLsizei target_level = 0;
+        int coarser_frames = 0;
+
+        // The array being uploaded at another level, and how many of its layers are left
+        GLuint pending_texture = 0;
+        GLsizei pending_level = 0;
+        int pending_uploads = 0;
+    };
+
+    /// The levels of a layer waiting to be uploaded into an array texture, from `level` and
+    /// `row` on
+    struct LayerUpload
+    {
+        GLuint texture = 0;
+        int array = 0;
+        int layer = 0;
+
+        // The level of the texture data that is level 0 of the texture
+        GLsizei first_level = 0;
+        GLsizei level = 0;
+        GLsizei row = 0;
+    };
+
+    int free_layer_count(const TextureShape& shape) const;
+
+    /// The bytes of the array's layers from `level` down
+    std::size_t array_size(const Array& array, GLsizei level) const;
+
+    /// Uploads from the front of the queue until the ring is out of room for the frame
+    void upload_queued();
+
+    void finish_pending(Array& array);
+
+    std::vector<Array> arrays_;
+    std::deque<LayerUpload> uploads_;
+    UploadRing& upload_ring_;
+    TextureStreamingStats stats_;
+};
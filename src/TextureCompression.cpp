@@ -0,0 +1,225 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+    using Block = std::array<glm::vec4, 16>;
+
+    /// The 16 texels of a block in row order, blocks over the edge repeat the last row or column
+    Block read_block(const std::uint8_t* pixels, GLsizei width, GLsizei height, GLsizei block_x,
+                     GLsizei block_y)
+    {
+        Block block;
+        for (int i = 0; i < 16; i++)
+        {
+            auto x = std::min(block_x * 4 + i % 4, width - 1);
+            auto y = std::min(block_y * 4 + i / 4, height - 1);
+            auto texel = pixels + (static_cast<std::size_t>(y) * width + x) * 4;
+            block[i] = glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+        }
+        return block;
+    }
+
+    void write_u16(std::uint8_t* out, std::uint16_t value)
+    {
+        out[0] = static_cast<std::uint8_t>(value);
+        out[1] = static_cast<std::uint8_t>(value >> 8);
+    }
+
+    void write_u32(std::uint8_t* out, std::uint32_t value)
+    {
+        write_u16(out, static_cast<std::uint16_t>(value));
+        write_u16(out + 2, static_cast<std::uint16_t>(value >> 16));
+    }
+
+    std::uint16_t pack_565(const glm::vec3& colour)
+    {
+        auto quantise = [](float value, int max)
+        {
+            return static_cast<int>(std::lround(std::clamp(value, 0.0f, 255.0f) * max / 255.0f));
+        };
+        return static_cast<std::uint16_t>(quantise(colour.x, 31) << 11 |
+                                          quantise(colour.y, 63) << 5 | quantise(colour.z, 31));
+    }
+
+    /// Expands a 5:6:5 colour to [0, 255] the way the hardware does, by repeating the top bits
+    glm::vec3 unpack_565(std::uint16_t colour)
+    {
+        int r = colour >> 11 & 31;
+        int g = colour >> 5 & 63;
+        int b = colour & 31;
+        return glm::vec3(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2);
+    }
+
+    /// The 8 byte colour block of BC3, always in the four colour mode
+    void encode_colour_block(const Block& block, std::uint8_t* out)
+    {
+        glm::vec3 mean{0.0f};
+        glm::vec3 low{255.0f};
+        glm::vec3 high{0.0f};
+        for (auto& texel : block)
+        {
+            mean += glm::vec3{texel};
+            low = glm::min(low, glm::vec3{texel});
+            high = glm::max(high, glm::vec3{texel});
+        }
+        mean /= 16.0f;
+
+        // The line the colours lie closest to is along the principal axis of their covariance,
+        // found by power iteration starting from the diagonal of their bounds
+        glm::mat3 covariance{0.0f};
+        for (auto& texel : block)
+        {
+            auto offset = glm::vec3{texel} - mean;
+            covariance += glm::outerProduct(offset, offset);
+        }
+        auto axis = high - low;
+        for (int i = 0; i < 8 && glm::dot(axis, axis) > 1e-6f; i++)
+        {
+            axis = glm::normalize(covariance * axis);
+        }
+        if (glm::dot(axis, axis) <= 1e-6f)
+        {
+            axis = glm::vec3{0.0f};
+        }
+
+        float min_t = 0.0f;
+        float max_t = 0.0f;
+        for (auto& texel : block)
+        {
+            auto t = glm::dot(glm::vec3{texel} - mean, axis);
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+
+        // The ends are pulled in a little, as fewer texels sit on them than between them
+        auto inset = (max_t - min_t) / 16.0f;
+        auto colour0 = pack_565(mean + axis * (max_t - inset));
+        auto colour1 = pack_565(mean + axis * (min_t + inset));
+        if (colour0 < colour1)
+        {
+            std::swap(colour0, colour1);
+        }
+
+        // With equal ends every texel is index 0, the first end
+        std::uint32_t indices = 0;
+        if (colour0 != colour1)
+        {
+            auto end0 = unpack_565(colour0);
+            auto end1 = unpack_565(colour1);
+            std::array<glm::vec3, 4> palette = {
+                end0,
+                end1,
+                (end0 * 2.0f + end1) / 3.0f,
+                (end0 + end1 * 2.0f) / 3.0f,
+            };
+            for (int i = 0; i < 16; i++)
+            {
+                std::uint32_t best = 0;
+                float best_distance = std::numeric_limits<float>::max();
+                for (std::uint32_t j = 0; j < 4; j++)
+                {
+                    auto offset = glm::vec3{block[i]} - palette[j];
+                    auto distance = glm::dot(offset, offset);
+                    if (distance < best_distance)
+                    {
+                        best = j;
+                        best_distance = distance;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        write_u16(out, colour0);
+        write_u16(out + 2, colour1);
+        write_u32(out + 4, indices);
+    }
+
+    /// The 8 byte block of one channel, the alpha block of BC3
+    void encode_channel_block(const Block& block, int channel, std::uint8_t* out)
+    {
+        float low = 255.0f;
+        float high = 0.0f;
+        for (auto& texel : block)
+        {
+            low = std::min(low, texel[channel]);
+            high = std::max(high, texel[channel]);
+        }
+        auto value0 = static_cast<std::uint8_t>(std::lround(high));
+        auto value1 = static_cast<std::uint8_t>(std::lround(low));
+
+        // Eight steps from value0 down to value1. Indices 0 and 1 are the ends, and 2 to 7 the
+        // steps between them in order
+        std::uint64_t indices = 0;
+        if (value0 > value1)
+        {
+            auto step = static_cast<float>(value0 - value1) / 7.0f;
+            for (int i = 0; i < 16; i++)
+            {
+                auto steps = std::lround((value0 - block[i][channel]) / step);
+                auto t = std::clamp(static_cast<int>(steps), 0, 7);
+                std::uint64_t index = t == 0 ? 0 : t == 7 ? 1 : t + 1;
+                indices |= index << (i * 3);
+            }
+        }
+
+        out[0] = value0;
+        out[1] = value1;
+        for (int i = 0; i < 6; i++)
+        {
+            out[2 + i] = static_cast<std::uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    std::vector<std::uint8_t> encode_level(const std::uint8_t* pixels, GLsizei width,
+                                           GLsizei height, TextureFormat format)
+    {
+        std::vector<std::uint8_t> level(level_size(format, width, height));
+        auto out = level.data();
+        for (GLsizei block_y = 0; block_y < (height + 3) / 4; block_y++)
+        {
+            for (GLsizei block_x = 0; block_x < (width + 3) / 4; block_x++)
+            {
+                auto block = read_block(pixels, width, height, block_x, block_y);
+                switch (format)
+                {
+                    case TextureFormat::BC3:
+                        encode_channel_block(block, 3, out);
+                        encode_colour_block(block, out + 8);
+                        out += 16;
+                        break;
+
+                    case TextureFormat::RGBA8:
+                        break;
+                }
+            }
+        }
+        return level;
+    }
+} // namespace
+
+TextureData compress_texture(const TextureData& texture, TextureFormat format)
+{
+    if (!is_compressed(format))
+    {
+        return texture;
+    }
+
+    TextureData compressed{format, texture.width, texture.height, {}};
+    auto width = texture.width;
+    auto height = texture.height;
+    for (auto& level : texture.levels)
+    {
+        compressed.levels.push_back(encode_level(level.data(), width, height, format));
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return compressed;
+}
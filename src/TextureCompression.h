@@ -0,0 +1,6 @@
+#pragma once
+
+#include "TextureData.h"
+
+/// Encodes every level of an RGBA8 texture to the block format (BC3)
+[[nodiscard]] TextureData compress_texture(const TextureData& texture, TextureFormat format);
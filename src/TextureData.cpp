@@ -0,0 +1,177 @@
+#include "TextureData.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+
+namespace
+{
+    // The parts of the DDS header that are used, see the DDS_HEADER docs
+    constexpr std::uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    constexpr std::uint32_t DDSD_CAPS = 0x1;
+    constexpr std::uint32_t DDSD_HEIGHT = 0x2;
+    constexpr std::uint32_t DDSD_WIDTH = 0x4;
+    constexpr std::uint32_t DDSD_PITCH = 0x8;
+    constexpr std::uint32_t DDSD_PIXELFORMAT = 0x1000;
+    constexpr std::uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    constexpr std::uint32_t DDSD_LINEARSIZE = 0x80000;
+    constexpr std::uint32_t DDPF_ALPHAPIXELS = 0x1;
+    constexpr std::uint32_t DDPF_FOURCC = 0x4;
+    constexpr std::uint32_t DDPF_RGB = 0x40;
+    constexpr std::uint32_t DDSCAPS_COMPLEX = 0x8;
+    constexpr std::uint32_t DDSCAPS_TEXTURE = 0x1000;
+    constexpr std::uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+    struct DDSPixelFormat
+    {
+        std::uint32_t size = sizeof(DDSPixelFormat);
+        std::uint32_t flags = 0;
+        std::uint32_t four_cc = 0;
+        std::uint32_t rgb_bit_count = 0;
+        std::array<std::uint32_t, 4> masks{};
+
+        bool operator==(const DDSPixelFormat& other) const = default;
+    };
+
+    struct DDSHeader
+    {
+        std::uint32_t size = sizeof(DDSHeader);
+        std::uint32_t flags = 0;
+        std::uint32_t height = 0;
+        std::uint32_t width = 0;
+        std::uint32_t pitch_or_linear_size = 0;
+        std::uint32_t depth = 0;
+        std::uint32_t mip_map_count = 0;
+        std::array<std::uint32_t, 11> reserved{};
+        DDSPixelFormat pixel_format;
+        std::array<std::uint32_t, 4> caps{};
+        std::uint32_t reserved2 = 0;
+    };
+    static_assert(sizeof(DDSHeader) == 124);
+
+    DDSPixelFormat dds_pixel_format(TextureFormat format)
+    {
+        auto four_cc = [](const char (&name)[5])
+        {
+            DDSPixelFormat pixel_format;
+            pixel_format.flags = DDPF_FOURCC;
+            pixel_format.four_cc = static_cast<std::uint32_t>(name[0]) |
+                                   static_cast<std::uint32_t>(name[1]) << 8 |
+                                   static_cast<std::uint32_t>(name[2]) << 16 |
+                                   static_cast<std::uint32_t>(name[3]) << 24;
+            return pixel_format;
+        };
+        switch (format)
+        {
+            case TextureFormat::RGBA8:
+            {
+                DDSPixelFormat pixel_format;
+                pixel_format.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+                pixel_format.rgb_bit_count = 32;
+                pixel_format.masks = {0xFF, 0xFF00, 0xFF0000, 0xFF000000};
+                return pixel_format;
+            }
+            case TextureFormat::BC3:
+                return four_cc("DXT5");
+        }
+        return {};
+    }
+} // namespace
+
+GLenum gl_format(TextureFormat format)
+{
+    switch (format)
+    {
+        case TextureFormat::RGBA8:
+            return GL_RGBA8;
+        case TextureFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    }
+    return GL_NONE;
+}
+
+bool is_compressed(TextureFormat format)
+{
+    return format != TextureFormat::RGBA8;
+}
+
+std::size_t level_size(TextureFormat format, GLsizei width, GLsizei height)
+{
+    if (format == TextureFormat::RGBA8)
+    {
+        return static_cast<std::size_t>(width) * height * 4;
+    }
+
+    // Every 4x4 block (including the ones hanging over the edge) takes 16 bytes
+    return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
+
+GLsizei mip_level_count(GLsizei width, GLsizei height)
+{
+    return std::bit_width(static_cast<unsigned>(std::max({width, height, 1})));
+}
+
+bool save_texture_data(const fs::path& path, const TextureData& texture)
+{
+    DDSHeader header;
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+    header.height = static_cast<std::uint32_t>(texture.height);
+    header.width = static_cast<std::uint32_t>(texture.width);
+    header.mip_map_count = static_cast<std::uint32_t>(texture.levels.size());
+    header.pixel_format = dds_pixel_format(texture.format);
+    header.caps[0] = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+    if (is_compressed(texture.format))
+    {
+        header.flags |= DDSD_LINEARSIZE;
+        header.pitch_or_linear_size = static_cast<std::uint32_t>(texture.levels.front().size());
+    }
+    else
+    {
+        header.flags |= DDSD_PITCH;
+        header.pitch_or_linear_size = static_cast<std::uint32_t>(texture.width * 4);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto& level : texture.levels)
+    {
+        file.write(reinterpret_cast<const char*>(level.data()),
+                   static_cast<std::streamsize>(level.size()));
+    }
+    if (!file)
+    {
+        std::cerr << "Failed to write texture " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool load_texture_data(const fs::path& path, TextureFormat format, TextureData& texture)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::uint32_t magic = 0;
+    DDSHeader header;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || magic != DDS_MAGIC || header.size != sizeof(DDSHeader) ||
+        header.pixel_format != dds_pixel_format(format) || header.width == 0 ||
+        header.height == 0 || header.mip_map_count == 0 || header.mip_map_count > 32)
+    {
+        return false;
+    }
+
+    auto width = static_cast<GLsizei>(header.width);
+    auto height = static_cast<GLsizei>(header.height);
+    texture = {format, width, height, {}};
+    for (std::uint32_t i = 0; i < header.mip_map_count; i++)
+    {
+        auto& level = texture.levels.emplace_back(level_size(format, width, height));
+        file.read(reinterpret_cast<char*>(level.data()),
+                  static_cast<std::streamsize>(level.size()));
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Util.h"
+
+// S3TC is not core GL, but every desktop driver supports it. glad was generated without the
+// extension, so its format is defined here
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum class TextureFormat
+{
+    // Uncompressed, 32 bits per texel
+    RGBA8,
+
+    // A 4 bits per texel colour block plus a 4 bits per texel alpha block, for colour with the
+    // specular map in alpha
+    BC3,
+};
+
+/// The texels of a 2D texture and all of its mip levels down to 1x1, ready to upload
+struct TextureData
+{
+    TextureFormat format = TextureFormat::RGBA8;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    std::vector<std::vector<std::uint8_t>> levels;
+};
+
+[[nodiscard]] GLenum gl_format(TextureFormat format);
+
+[[nodiscard]] bool is_compressed(TextureFormat format);
+
+/// The size in bytes of a mip level with the given size
+[[nodiscard]] std::size_t level_size(TextureFormat format, GLsizei width, GLsizei height);
+
+/// The number of levels in a full mip chain, halving the larger side down to 1
+[[nodiscard]] GLsizei mip_level_count(GLsizei width, GLsizei height);
+
+/// Writes and reads the texture as a DDS file. Loading fails if the file is in another format
+bool save_texture_data(const fs::path& path, const TextureData& texture);
+bool load_texture_data(const fs::path& path, TextureFormat format, TextureData& texture);
@@ -0,0 +1,272 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "AssetPack.h"
+#include "Mipmaps.h"
+#include "Profiler.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const fs::path CACHE_DIRECTORY = "cache/textures";
+
+    /// eg assets/textures/crate+specular is cached as
+    /// cache/textures/assets/textures/crate+specular.bc3.dds
+    fs::path cache_path(const fs::path& path, TextureFormat format)
+    {
+        const char* formats[] = {".rgba8.dds", ".bc3.dds"};
+        auto cached = CACHE_DIRECTORY / path.relative_path();
+        return cached.replace_extension(formats[static_cast<int>(format)]);
+    }
+
+    bool cache_is_current(const std::vector<fs::path>& sources, const fs::path& cached)
+    {
+        std::error_code error;
+        auto cached_time = fs::last_write_time(cached, error);
+        if (error)
+        {
+            return false;
+        }
+        for (auto& source : sources)
+        {
+            auto source_time = AssetPack::last_write_time(source, error);
+            if (error || cached_time < source_time)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Written to a file of its own first, so nothing reads a half written cache
+    void write_cache(const fs::path& cached, const TextureData& data, TextureHandle handle)
+    {
+        std::error_code error;
+        fs::create_directories(cached.parent_path(), error);
+
+        auto temporary = cached;
+        temporary += ".tmp" + std::to_string(handle);
+        if (!save_texture_data(temporary, data))
+        {
+            fs::remove(temporary, error);
+            return;
+        }
+        fs::rename(temporary, cached, error);
+        if (error)
+        {
+            std::cerr << "Failed to write texture cache " << cached << ": " << error.message()
+                      << '\n';
+            fs::remove(temporary, error);
+        }
+    }
+
+    bool supports_s3tc()
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        std::vector<GLint> formats(count);
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+        return std::ranges::find(formats, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) != formats.end();
+    }
+} // namespace
+
+bool load_image(sf::Image& image, const fs::path& path)
+{
+    if (auto asset = AssetPack::find(path))
+    {
+        return image.loadFromMemory(asset->data(), asset->size());
+    }
+    return image.loadFromFile(path.string());
+}
+
+void pack_specular(sf::Image& image, const sf::Image* specular)
+{
+    auto size = image.getSize();
+    auto specular_size = specular ? specular->getSize() : sf::Vector2u{};
+    std::vector<std::uint8_t> pixels(image.getPixelsPtr(),
+                                     image.getPixelsPtr() + std::size_t{size.x} * size.y * 4);
+    for (unsigned y = 0; y < size.y; y++)
+    {
+        for (unsigned x = 0; x < size.x; x++)
+        {
+            std::uint8_t value = 0;
+            if (specular)
+            {
+                auto specular_x = x * specular_size.x / size.x;
+                auto specular_y = y * specular_size.y / size.y;
+                value = specular->getPixelsPtr()[(std::size_t{specular_y} * specular_size.x +
+                                                  specular_x) * 4];
+            }
+            pixels[(std::size_t{y} * size.x + x) * 4 + 3] = value;
+        }
+    }
+    image.create(size.x, size.y, pixels.data());
+}
+
+TextureLoader::TextureLoader(ThreadPool& thread_pool, TextureArrays& texture_arrays,
+                             bool compress)
+    : thread_pool_(thread_pool)
+    , texture_arrays_(texture_arrays)
+    , compress_(compress)
+{
+    if (compress_ && !supports_s3tc())
+    {
+        std::cout << "S3TC texture compression is not supported, textures are uncompressed\n";
+        compress_ = false;
+    }
+}
+
+TextureHandle TextureLoader::add_packed(const fs::path& diffuse, const fs::path& specular)
+{
+    std::cout << "Loading texture " << diffuse << " with specular map " << specular << '\n';
+
+    // eg assets/textures/crate.png is cached as assets/textures/crate+specular
+    auto name = diffuse;
+    name.replace_filename(diffuse.stem().string() + "+specular");
+    std::vector<fs::path> sources = {diffuse};
+    if (!specular.empty())
+    {
+        sources.push_back(specular);
+    }
+    return add_texture(name, std::move(sources),
+                       [diffuse, specular](sf::Image& image)
+                       {
+                           sf::Image specular_image;
+                           if (!load_image(image, diffuse) ||
+                               (!specular.empty() && !load_image(specular_image, specular)))
+                           {
+                               return false;
+                           }
+                           pack_specular(image, specular.empty() ? nullptr : &specular_image);
+                           return true;
+                       });
+}
+
+TextureHandle TextureLoader::add(const fs::path& name, sf::Image image,
+                                 std::vector<fs::path> sources)
+{
+    return add_texture(name, std::move(sources),
+                       [image = std::move(image)](sf::Image& decoded)
+                       {
+                           decoded = image;
+                           return true;
+                       });
+}
+
+TextureHandle TextureLoader::add_texture(const fs::path& name, std::vector<fs::path> sources,
+                                         std::function<bool(sf::Image&)> decode)
+{
+    auto handle = layers_.size();
+    layers_.emplace_back();
+
+    auto format = compress_ ? TextureFormat::BC3 : TextureFormat::RGBA8;
+    auto decoded = thread_pool_.submit(
+        [name, sources = std::move(sources), decode = std::move(decode), handle, format]()
+        {
+            PROFILE_ZONE("Decode texture");
+            DecodedTexture decoded;
+            auto cached = cache_path(name, format);
+            if (cache_is_current(sources, cached) &&
+                load_texture_data(cached, format, decoded.data))
+            {
+                return decoded;
+            }
+
+            sf::Image image;
+            if (!decode(image))
+            {
+                return DecodedTexture{};
+            }
+            image.flipVertically();
+
+            auto size = image.getSize();
+            decoded.data = compress_texture(build_mipmaps(image.getPixelsPtr(),
+                                                          static_cast<GLsizei>(size.x),
+                                                          static_cast<GLsizei>(size.y)),
+                                            format);
+            decoded.converted = true;
+            write_cache(cached, decoded.data, handle);
+            return decoded;
+        });
+    pending_.push_back({name, handle, std::move(decoded)});
+    return handle;
+}
+
+bool TextureLoader::upload()
+{
+    PROFILE_ZONE("Upload textures");
+    std::vector<TextureData> textures;
+    std::map<TextureShape, int> shapes;
+
+    // Logged here rather than on the workers, whose lines would interleave
+    std::vector<const fs::path*> converted;
+    for (auto& pending : pending_)
+    {
+        auto decoded = pending.decoded.get();
+        if (decoded.converted)
+        {
+            converted.push_back(&pending.path);
+        }
+        auto& data = textures.emplace_back(std::move(decoded.data));
+        if (!data.levels.empty())
+        {
+            shapes[texture_shape(data)]++;
+        }
+    }
+
+    // Each shape gets one array for the whole batch
+    bool loaded = true;
+    for (auto& [shape, count] : shapes)
+    {
+        loaded &= texture_arrays_.reserve(shape, count);
+    }
+
+    std::size_t uploaded_bytes = 0;
+    std::size_t uncompressed_bytes = 0;
+    for (std::size_t i = 0; i < pending_.size(); i++)
+    {
+        auto& pending = pending_[i];
+        auto& data = textures[i];
+        std::size_t size = 0;
+        std::size_t uncompressed_size = 0;
+        for (std::size_t level = 0; level < data.levels.size(); level++)
+        {
+            size += data.levels[level].size();
+            uncompressed_size += level_size(TextureFormat::RGBA8,
+                                            std::max(data.width >> level, 1),
+                                            std::max(data.height >> level, 1));
+        }
+
+        // The arrays keep the levels for streaming
+        if (data.levels.empty() || !texture_arrays_.add(std::move(data), layers_[pending.handle]))
+        {
+            std::cerr << "Failed to load texture " << pending.path << '\n';
+            loaded = false;
+            continue;
+        }
+        uploaded_bytes += size;
+        uncompressed_bytes += uncompressed_size;
+    }
+
+    if (!pending_.empty())
+    {
+        std::cout << "Loaded " << pending_.size() << " textures into "
+                  << texture_arrays_.array_count() << " texture arrays, " << uploaded_bytes / 1024
+                  << " KB (" << uncompressed_bytes / 1024 << " KB as RGBA8)\n";
+    }
+    for (auto path : converted)
+    {
+        std::cout << "Converted texture " << *path << " and cached it\n";
+    }
+    pending_.clear();
+    return loaded;
+}
+
+const TextureLayer& TextureLoader::layer(TextureHandle handle) const
+{
+    return layers_[handle];
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+#include <glad/glad.h>
+
+#include "TextureArrays.h"
+#include "TextureData.h"
+#include "Util.h"
+
+class ThreadPool;
+
+/// Decodes the image from the asset pack when it has the file, else from the file
+bool load_image(sf::Image& image, const fs::path& path);
+
+/// Replaces the alpha of the image with the red channel of the specular map, which is scaled to
+/// the size of the image. A null specular map is no specular
+void pack_specular(sf::Image& image, const sf::Image* specular);
+
+/// Stays valid for the life of the loader, the layer it refers to is known after upload()
+using TextureHandle = std::size_t;
+
+/**
+    Loads a batch of textures from image files.
+
+    Each file is decoded and flipped on the thread pool as soon as it is added, while the rest
+    of the startup carries on. upload() then waits for every image and puts them in layers of
+    the texture arrays on the thread with the GL context, which upload them over the next
+    frames, so the decoding of every texture overlaps and nothing waits on the uploads.
+
+    Every texture is colour with a specular map in alpha. The worker also builds every mip level
+    (averaging colour as linear light) and, when compressing, encodes them to BC3. The result is
+    cached as a DDS file under cache/textures, and later runs load the cache instead of the image
+    for as long as it is newer than the image, so a warm start only reads and uploads the levels.
+*/
+class TextureLoader
+{
+  public:
+    TextureLoader(ThreadPool& thread_pool, TextureArrays& texture_arrays, bool compress);
+    TextureLoader(TextureLoader&& other) noexcept = delete;
+    TextureLoader(const TextureLoader& other) = delete;
+    TextureLoader& operator=(TextureLoader&& other) noexcept = delete;
+    TextureLoader& operator=(const TextureLoader& other) = delete;
+
+    /// Starts decoding the diffuse map with the red channel of the specular map in its alpha, so
+    /// both are read with one fetch. The specular map is scaled to the size of the diffuse map,
+    /// and with no specular map the alpha is 0
+    [[nodiscard]] TextureHandle add_packed(const fs::path& diffuse, const fs::path& specular);
+
+    /// Adds an image made at runtime, eg an atlas, which is cached under the name for as long
+    /// as the cache is newer than every one of the files it was made from
+    [[nodiscard]] TextureHandle add(const fs::path& name, sf::Image image,
+                                    std::vector<fs::path> sources);
+
+    /// Adds every texture added since the last call to the texture arrays, with mipmaps,
+    /// returning false if any failed to load
+    bool upload();
+
+    /// Where the texture was uploaded to
+    const TextureLayer& layer(TextureHandle handle) const;
+
+  private:
+    /// Builds the texture on the thread pool, decoding the image only if the cache is stale
+    TextureHandle add_texture(const fs::path& name, std::vector<fs::path> sources,
+                              std::function<bool(sf::Image&)> decode);
+
+    struct DecodedTexture
+    {
+        // Has no levels if the file could not be loaded
+        TextureData data;
+
+        // False if it was read from the cache
+        bool converted = false;
+    };
+
+    struct PendingTexture
+    {
+        fs::path path;
+        TextureHandle handle = 0;
+        std::future<DecodedTexture> decoded;
+    };
+
+    ThreadPool& thread_pool_;
+    TextureArrays& texture_arrays_;
+    bool compress_;
+    std::vector<PendingTexture> pending_;
+    std::vector<TextureLayer> layers_;
+};
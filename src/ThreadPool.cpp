@@ -0,0 +1,73 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(unsigned worker_count)
+{
+    workers_.reserve(worker_count);
+    for (unsigned i = 0; i < worker_count; i++)
+    {
+        workers_.emplace_back(
+            [this, i]()
+            {
+                Profiler::set_thread_name("Worker " + std::to_string(i));
+                worker_loop();
+            });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    workers_.clear();
+}
+
+unsigned ThreadPool::default_worker_count()
+{
+    auto cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+std::size_t ThreadPool::worker_count() const
+{
+    return workers_.size();
+}
+
+void ThreadPool::push_job(std::function<void()> job)
+{
+    // With no workers the job has to run on the calling thread
+    if (workers_.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::scoped_lock lock(mutex_);
+        jobs_.push(std::move(job));
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_ && jobs_.empty())
+            {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+    Fixed set of worker threads that run jobs submitted from any thread.
+
+    parallel_for() splits a range into chunks and has the calling thread work through chunks
+    too, so it is safe to call with a pool of zero workers and never deadlocks waiting on
+    itself.
+*/
+class ThreadPool
+{
+  public:
+    /// Defaults to one worker per core, less one for the calling thread
+    explicit ThreadPool(unsigned worker_count = default_worker_count());
+    ThreadPool(ThreadPool&& other) noexcept = delete;
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(ThreadPool&& other) noexcept = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+    ~ThreadPool();
+
+    static unsigned default_worker_count();
+
+    /// Runs the job on a worker thread
+    template <typename F>
+    auto submit(F f) -> std::future<decltype(f())>
+    {
+        using Result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(f));
+        auto future = task->get_future();
+        push_job([task]() { (*task)(); });
+        return future;
+    }
+
+    /// Calls f(begin, end) over [0, count) in chunks of chunk_size and waits for them all
+    template <typename F>
+    void parallel_for(std::size_t count, std::size_t chunk_size, F f)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        chunk_size = std::max<std::size_t>(chunk_size, 1);
+        std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+
+        std::atomic<std::size_t> next_chunk = 0;
+        auto run_chunks = [&]()
+        {
+            for (auto chunk = next_chunk++; chunk < chunks; chunk = next_chunk++)
+            {
+                auto begin = chunk * chunk_size;
+                f(begin, std::min(begin + chunk_size, count));
+            }
+        };
+
+        // Workers that start after every chunk has been claimed simply return
+        auto helpers = std::min<std::size_t>(workers_.size(), chunks - 1);
+        std::vector<std::future<void>> futures;
+        futures.reserve(helpers);
+        for (std::size_t i = 0; i < helpers; i++)
+        {
+            futures.push_back(submit(run_chunks));
+        }
+        run_chunks();
+        for (auto& future : futures)
+        {
+            future.wait();
+        }
+    }
+
+    std::size_t worker_count() const;
+
+  private:
+    void push_job(std::function<void()> job);
+    void worker_loop();
+
+    std::vector<std::jthread> workers_;
+    std::queue<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct Transform
+{
+    glm::vec3 position{0.0f};
+    glm::vec3 rotation{0.0f};
+};
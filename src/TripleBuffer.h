@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+    Lock-free triple buffer for handing values from exactly one writer thread to exactly one
+    reader thread.
+
+    The writer fills write_buffer() and calls publish(), the reader calls update() and then
+    reads read_buffer(). Neither side ever blocks: the writer always has a free slot to write
+    into, and the reader always sees the most recently published value (older unread values
+    are simply dropped).
+*/
+template <typename T>
+class TripleBuffer
+{
+  public:
+    /// The slot owned by the writer, only valid to touch from the writer thread
+    T& write_buffer()
+    {
+        return buffers_[write_index_];
+    }
+
+    /// Makes the write buffer visible to the reader and gives the writer a new slot
+    void publish()
+    {
+        auto previous = middle_.exchange(write_index_ | DIRTY_BIT, std::memory_order_acq_rel);
+        write_index_ = previous & INDEX_MASK;
+    }
+
+    /// Swaps in the latest published value, returns false if nothing new was published
+    bool update()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & DIRTY_BIT))
+        {
+            return false;
+        }
+        auto previous = middle_.exchange(read_index_, std::memory_order_acq_rel);
+        read_index_ = previous & INDEX_MASK;
+        return true;
+    }
+
+    /// The slot owned by the reader, only valid to touch from the reader thread
+    const T& read_buffer() const
+    {
+        return buffers_[read_index_];
+    }
+
+  private:
+    static constexpr std::uint8_t DIRTY_BIT = 0x4;
+    static constexpr std::uint8_t INDEX_MASK = 0x3;
+
+    std::array<T, 3> buffers_;
+
+    // Index of the slot sitting between the reader and the writer, with the dirty bit set
+    // when it holds a value the reader has not yet seen
+    std::atomic<std::uint8_t> middle_{1};
+    std::uint8_t write_index_ = 0;
+    std::uint8_t read_index_ = 2;
+};
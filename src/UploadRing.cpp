@@ -0,0 +1,158 @@
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLCapture.h"
+
+namespace
+{
+    // Suits the 16 byte blocks of BC3 and the 4 byte rows of RGBA8
+    constexpr GLsizeiptr ALIGNMENT = 16;
+} // namespace
+
+UploadRing::~UploadRing()
+{
+    for (auto& fence : fences_)
+    {
+        glDeleteSync(fence.sync);
+    }
+    if (buffer_)
+    {
+        glUnmapNamedBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+}
+
+bool UploadRing::create(GLsizeiptr size, GLsizeiptr frame_budget)
+{
+    stats_.size = size;
+    stats_.frame_budget = frame_budget;
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer_);
+    glNamedBufferStorage(buffer_, size, nullptr, flags);
+    mapped_ = static_cast<std::uint8_t*>(glMapNamedBufferRange(buffer_, 0, size, flags));
+
+    if (!mapped_)
+    {
+        std::cerr << "Failed to persistently map upload ring of size " << size << ".\n";
+        return false;
+    }
+    return true;
+}
+
+void UploadRing::begin_frame()
+{
+    // Fences are passed in order, so this stops at the first the GPU has not reached
+    while (!fences_.empty() && glClientWaitSync(fences_.front().sync, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        glDeleteSync(fences_.front().sync);
+        used_ -= fences_.front().size;
+        fences_.pop_front();
+    }
+    frame_used_ = 0;
+    frame_uploaded_ = 0;
+    budget_used_ = false;
+}
+
+void UploadRing::end_frame()
+{
+    if (frame_used_ > 0)
+    {
+        fences_.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frame_used_});
+    }
+
+    stats_.frames++;
+    stats_.budget_frames += budget_used_;
+    stats_.last_frame_bytes = static_cast<std::size_t>(frame_uploaded_);
+}
+
+GLsizei UploadRing::upload_rows(const TextureUpload& upload, GLsizei first_row)
+{
+    // Compressed levels are uploaded in rows of blocks
+    GLsizei row_height = is_compressed(upload.format) ? 4 : 1;
+    auto row_size = static_cast<GLsizeiptr>(level_size(upload.format, upload.width, row_height));
+    auto rows_left = (upload.height - first_row + row_height - 1) / row_height;
+
+    auto budget_left = stats_.frame_budget - frame_uploaded_;
+    auto rows = static_cast<GLsizei>(std::min<GLsizeiptr>(rows_left, budget_left / row_size));
+    if (rows == 0)
+    {
+        budget_used_ = true;
+        return 0;
+    }
+
+    // Half as many rows until they fit in the space the GPU is done with
+    GLsizeiptr offset = -1;
+    for (; rows > 0; rows /= 2)
+    {
+        offset = allocate(rows * row_size);
+        if (offset >= 0)
+        {
+            break;
+        }
+    }
+    if (offset < 0)
+    {
+        stats_.full_waits++;
+        return 0;
+    }
+
+    auto size = rows * row_size;
+    std::memcpy(mapped_ + offset, upload.texels + first_row / row_height * row_size, size);
+    frame_uploaded_ += size;
+    stats_.uploaded_bytes += size;
+
+    // The last row of blocks may hang over the edge of the level
+    auto height = std::min(rows * row_height, upload.height - first_row);
+    auto pixels = reinterpret_cast<const void*>(offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+    GLCapture::set_pixel_unpack_memory(mapped_);
+    if (is_compressed(upload.format))
+    {
+        glCompressedTextureSubImage3D(upload.texture, upload.level, 0, first_row, upload.layer,
+                                      upload.width, height, 1, gl_format(upload.format),
+                                      static_cast<GLsizei>(size), pixels);
+    }
+    else
+    {
+        glTextureSubImage3D(upload.texture, upload.level, 0, first_row, upload.layer,
+                            upload.width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+    GLCapture::set_pixel_unpack_memory(nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return height;
+}
+
+const UploadRingStats& UploadRing::stats() const
+{
+    return stats_;
+}
+
+GLsizeiptr UploadRing::allocate(GLsizeiptr size)
+{
+    if (used_ == 0)
+    {
+        head_ = 0;
+    }
+
+    // The GPU is reading from head_ back around to head_ - used_, so everything else is free.
+    // What is skipped over to align or to wrap around is used until this frame is done
+    auto start = (head_ + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    if (start + size > stats_.size)
+    {
+        start = 0;
+    }
+    auto skipped = start >= head_ ? start - head_ : stats_.size - head_;
+    if (used_ + skipped + size > stats_.size)
+    {
+        return -1;
+    }
+
+    head_ = start + size;
+    used_ += skipped + size;
+    frame_used_ += skipped + size;
+    return start;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include <glad/glad.h>
+
+#include "TextureData.h"
+
+struct UploadRingStats
+{
+    std::uint64_t frames = 0;
+
+    // Every byte copied into textures through the ring, and the bytes of the last frame
+    std::uint64_t uploaded_bytes = 0;
+    std::size_t last_frame_bytes = 0;
+
+    // Frames that used up their budget, and uploads put off because the GPU was still reading
+    // the part of the ring they needed
+    std::uint64_t budget_frames = 0;
+    std::uint64_t full_waits = 0;
+
+    GLsizeiptr size = 0;
+    GLsizeiptr frame_budget = 0;
+};
+
+/// One mip level of one layer of an array texture, with its texels in client memory
+struct TextureUpload
+{
+    GLuint texture = 0;
+    GLint level = 0;
+    GLint layer = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    TextureFormat format = TextureFormat::RGBA8;
+    const std::uint8_t* texels = nullptr;
+};
+
+/**
+    Uploads texels through a persistently mapped GL_PIXEL_UNPACK_BUFFER, so uploading only
+    copies into mapped memory and queues the copy into the texture, instead of the driver
+    copying the texels out of client memory before the call returns.
+
+    The buffer is used as a ring. Each frame's uploads are fenced, and the space is only written
+    again once the GPU has passed the fence. Nothing ever waits on a fence: when the ring is
+    full, or the frame has uploaded its budget, upload_rows() uploads nothing and the caller
+    tries again next frame. Levels larger than what is left are uploaded a band of rows at a
+    time.
+*/
+class UploadRing
+{
+  public:
+    UploadRing() = default;
+    UploadRing(UploadRing&& other) noexcept = delete;
+    UploadRing(const UploadRing& other) = delete;
+    UploadRing& operator=(UploadRing&& other) noexcept = delete;
+    UploadRing& operator=(const UploadRing& other) = delete;
+    ~UploadRing();
+
+    bool create(GLsizeiptr size, GLsizeiptr frame_budget);
+
+    /// Frees the space of every frame the GPU has finished uploading
+    void begin_frame();
+
+    /// Fences this frame's uploads
+    void end_frame();
+
+    /// Uploads as many rows of the level from `first_row` as fit, returning how many (0 if
+    /// nothing fit). Rows of block compressed formats go in whole blocks, 4 at a time
+    GLsizei upload_rows(const TextureUpload& upload, GLsizei first_row);
+
+    const UploadRingStats& stats() const;
+
+  private:
+    struct Fence
+    {
+        GLsync sync = nullptr;
+        GLsizeiptr size = 0;
+    };
+
+    /// Returns the offset of `size` bytes, or -1 if the ring is full
+    GLsizeiptr allocate(GLsizeiptr size);
+
+    std::deque<Fence> fences_;
+    UploadRingStats stats_;
+
+    std::uint8_t* mapped_ = nullptr;
+    GLuint buffer_ = 0;
+
+    GLsizeiptr head_ = 0;
+
+    // Bytes the GPU may still be reading, including this frame's
+    GLsizeiptr used_ = 0;
+    GLsizeiptr frame_used_ = 0;
+    GLsizeiptr frame_uploaded_ = 0;
+    bool budget_used_ = false;
+};
@@ -3,18 +3,25 @@
 #include <fstream>
 #include <iostream>
 
+#include "AssetPack.h"
+
 std::string read_file_to_string(const std::filesystem::path& file_path)
 {
-    std::ifstream in_file(file_path);
+    if (auto asset = AssetPack::find(file_path))
+    {
+        return {asset->begin(), asset->end()};
+    }
 
+    // Sized up front and read in one go, rather than a character at a time
+    std::ifstream in_file(file_path, std::ios::binary | std::ios::ate);
     if (!in_file)
     {
-        std::cout << "Failed to open file " << file_path << std::endl;
+        std::cerr << "Failed to open file " << file_path << '\n';
         return "";
     }
 
-    std::string content((std::istreambuf_iterator<char>(in_file)),
-                        (std::istreambuf_iterator<char>()));
-
+    std::string content(static_cast<std::size_t>(in_file.tellg()), '\0');
+    in_file.seekg(0);
+    in_file.read(content.data(), static_cast<std::streamsize>(content.size()));
     return content;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 namespace fs = std::filesystem;
 
+/// From the asset pack when it has the file, see AssetPack.h
 std::string read_file_to_string(const std::filesystem::path& file_path);
 
 template <typename N, typename T>
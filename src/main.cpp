@@ -1,17 +1,40 @@
+#include <algorithm>
 #include <array>
+#include <limits>
 #include <numbers>
+#include <optional>
 
-#include <SFML/Graphics/Image.hpp>
 #include <SFML/Window/Event.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "GLDebugEnable.h"
+#include "AssetPack.h"
+#include "Benchmark.h"
+#include "CascadedShadowMap.h"
+#include "Frustum.h"
+#include "GLCapture.h"
+#include "GLStats.h"
 #include "GUI.h"
+#include "HeadlessContext.h"
+#include "LightClusters.h"
 #include "Lights.h"
 #include "MeshGeneration.h"
+#include "Options.h"
+#include "PrepassTuner.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "RenderScale.h"
+#include "RenderTargetPool.h"
+#include "SceneGeneration.h"
 #include "Shader.h"
+#include "ShadowMap.h"
+#include "Simulation.h"
+#include "SpriteAtlas.h"
+#include "StreamBuffer.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
 #include "Util.h"
 
 #include <imgui.h>
@@ -22,38 +45,76 @@
 
 namespace
 {
-    struct Transform
+    /// What a pass draws the scene for
+    enum class SceneDraw
     {
-        glm::vec3 position{0.0f};
-        glm::vec3 rotation{0.0f};
+        // Only the depth, for the depth pre-pass
+        Depth,
+
+        // Lit as it is drawn
+        Forward,
+
+        // The surfaces written to the G-buffer, to be lit afterwards
+        GBuffer,
     };
 
-    template <int Ticks>
-    class TimeStep
+    // The flashlight's shadow map covers its cone out to here, past it the light is too dim for
+    // a shadow to be seen
+    constexpr float FLASHLIGHT_RANGE = 64.0f;
+
+    constexpr GLsizei SPOT_SHADOW_SIZE = 1024;
+    constexpr GLsizei POINT_SHADOW_TILE_SIZE = 512;
+
+    // The moonlight's shadows split the view into cascades up to this distance
+    constexpr int MOONLIGHT_CASCADES = 4;
+    constexpr GLsizei MOONLIGHT_SHADOW_SIZE = 1024;
+    constexpr float MOONLIGHT_SHADOW_DISTANCE = 128.0f;
+
+    // Texture uploads are copied through a ring of this size, at most UPLOAD_FRAME_BUDGET bytes
+    // a frame
+    constexpr GLsizeiptr UPLOAD_RING_SIZE = 16 * 1024 * 1024;
+    constexpr GLsizeiptr UPLOAD_FRAME_BUDGET = 4 * 1024 * 1024;
+
+    // Texels a position is pushed along its normal before sampling a shadow map, so surfaces do
+    // not shadow themselves
+    constexpr float SHADOW_NORMAL_OFFSET = 1.5f;
+
+    /// Matches the std140 "Camera" uniform block in the scene shaders
+    struct CameraBlock
     {
-      public:
-        template <typename F>
-        void update(F f)
-        {
-            sf::Time time = timer_.getElapsedTime();
-            sf::Time elapsed = time - last_time_;
-            last_time_ = time;
-            lag_ += elapsed;
-            while (lag_ >= timePerUpdate_)
-            {
-                lag_ -= timePerUpdate_;
-                f(dt_.restart());
-            }
-        }
+        glm::mat4 projection_matrix{1.0f};
+        glm::mat4 view_matrix{1.0f};
+        glm::vec3 eye_position{0.0f};
+        float padding = 0.0f;
+    };
 
-      private:
-        const sf::Time timePerUpdate_ = sf::seconds(1.f / Ticks);
-        sf::Clock timer_;
-        sf::Clock dt_;
-        sf::Time last_time_ = sf::Time::Zero;
-        sf::Time lag_ = sf::Time::Zero;
+    /// The casters in each cascade of the moonlight's shadow map. The lists of the static
+    /// casters are kept between frames, as they are only culled again when a cascade moves
+    struct CascadeCasterLists
+    {
+        std::vector<std::vector<glm::mat4>> terrain;
+        std::vector<std::vector<glm::mat4>> boxes;
+        std::vector<std::vector<glm::mat4>> models;
+        std::vector<std::vector<glm::mat4>> billboards;
     };
 
+    glm::mat4 create_projection(unsigned width, unsigned height)
+    {
+        return glm::perspective(glm::radians(75.0f), static_cast<float>(width) / height, 1.0f,
+                                256.0f);
+    }
+
+    glm::mat4 create_model_matrix(const Transform& transform)
+    {
+        glm::mat4 mat{1.0f};
+        mat = glm::translate(mat, transform.position);
+        mat = glm::rotate(mat, glm::radians(transform.rotation.x), {1, 0, 0});
+        mat = glm::rotate(mat, glm::radians(transform.rotation.y), {0, 1, 0});
+        mat = glm::rotate(mat, glm::radians(transform.rotation.z), {0, 0, 1});
+
+        return mat;
+    }
+
     glm::vec3 get_keyboard_input(const Transform& transform, bool flying)
     {
 
@@ -118,41 +179,116 @@ namespace
     }
 } // namespace
 
-int main()
+int main(int argc, char** argv)
 {
-    sf::ContextSettings context_settings;
-    context_settings.depthBits = 24;
-    context_settings.stencilBits = 8;
-    context_settings.antialiasingLevel = 4;
-    context_settings.majorVersion = 4;
-    context_settings.minorVersion = 5;
-    context_settings.attributeFlags = sf::ContextSettings::Core;
-
-    sf::Window window({1600, 900}, "SpookyGL", sf::Style::Default, context_settings);
-    window.setVerticalSyncEnabled(true);
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        return -1;
+    }
+    auto width = static_cast<unsigned>(options.width);
+    auto height = static_cast<unsigned>(options.height);
+
+    // Mapped before anything reads an asset. Without a pack the loose files are read
+    if (!options.asset_pack.empty() && !AssetPack::open(options.asset_pack))
+    {
+        return -1;
+    }
+
+    // In headless mode there is no window (and so no input, GUI or vsync), everything is
+    // rendered into the framebuffer only
+    std::unique_ptr<sf::Window> window;
+    HeadlessContext headless_context;
     bool mouse_locked = false;
 
-    window.setActive(true);
+    if (options.headless)
+    {
+        if (!headless_context.create())
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        sf::ContextSettings context_settings;
+        context_settings.depthBits = 24;
+        context_settings.stencilBits = 8;
+        context_settings.antialiasingLevel = 4;
+        context_settings.majorVersion = 4;
+        context_settings.minorVersion = 5;
+        context_settings.attributeFlags = sf::ContextSettings::Core;
+
+        window = std::make_unique<sf::Window>(sf::VideoMode{width, height}, "SpookyGL",
+                                              sf::Style::Default, context_settings);
+        window->setVerticalSyncEnabled(true);
+        window->setActive(true);
+
+        if (!gladLoadGL())
+        {
+            std::cerr << "Failed to init OpenGL - Is OpenGL linked correctly?\n";
+            return -1;
+        }
+    }
 
-    if (!gladLoadGL())
+    // Capturing has to start before anything is created so the capture has every resource
+    if (!options.capture_path.empty())
     {
-        std::cerr << "Failed to init OpenGL - Is OpenGL linked correctly?\n";
-        return -1;
+        GLCapture::start(options.capture_path, options.capture_start, options.capture_frames,
+                         width, height);
     }
-    glViewport(0, 0, 1600, 900);
+    glViewport(0, 0, width, height);
     init_opengl_debugging();
-    GUI::init(&window);
+    if (window)
+    {
+        GUI::init(window.get());
+    }
+
+    // ---------------------------
+    // ==== Generate the scene ====
+    // ---------------------------
+    ThreadPool thread_pool;
+    Scene scene = generate_scene(options.scene, thread_pool);
+
+    // ------------------------------------
+    // ==== Create the OpenGL Textures ====
+    // ------------------------------------
+    // The files decode on the worker threads while the meshes are built and the model is
+    // imported, and are queued together once everything else is set up. The queue is uploaded
+    // through the upload ring over the first frames
+    UploadRing upload_ring;
+    if (!upload_ring.create(UPLOAD_RING_SIZE, UPLOAD_FRAME_BUDGET))
+    {
+        return -1;
+    }
+    TextureArrays texture_arrays(upload_ring);
+    TextureLoader texture_loader(thread_pool, texture_arrays, !options.no_texture_compression);
+
+    // Every billboard sprite is packed into one atlas, so they are all drawn at once. It is built
+    // first, as building waits for its sprites to decode, which would otherwise queue behind
+    // every other texture
+    SpriteAtlas billboard_atlas;
+    billboard_atlas.add("assets/textures/person.png", "assets/textures/person_specular.png");
+    if (!billboard_atlas.build("assets/textures/billboards", thread_pool, texture_loader))
+    {
+        return -1;
+    }
+
+    // The specular maps are packed into the alpha of the diffuse maps
+    TextureHandle grass_texture = texture_loader.add_packed("assets/textures/grass_03.png",
+                                                            "assets/textures/grass_specular.png");
+    TextureHandle crate_texture = texture_loader.add_packed("assets/textures/crate.png",
+                                                            "assets/textures/crate_specular.png");
 
     // ---------------------------
     // ==== Create the Meshes ====
     // ---------------------------
     Mesh billboard_mesh = generate_quad_mesh(1.0f, 2.0f);
-    Mesh terrain_mesh = generate_terrain_mesh(128);
+    Mesh terrain_mesh = generate_terrain_mesh(scene.terrain_size);
     Mesh light_mesh = generate_cube_mesh({0.2f, 0.2f, 0.2f});
     Mesh box_mesh = generate_cube_mesh({2.0f, 2.0f, 2.0f});
 
     Model backpack;
-    backpack.load_from_file("assets/models/backpack/backpack.obj");
+    backpack.load_from_file("assets/models/backpack/backpack.obj", texture_loader);
 
     // ----------------------------------------
     // ==== Create the OpenGL vertex array ====
@@ -202,85 +338,65 @@ int main()
     auto light_vertex_array = buffer_mesh(light_mesh);
     auto box_vertex_array = buffer_mesh(box_mesh);
 
+    // The light volumes of the deferred lighting, enclosing a unit sphere and a unit cone
+    Mesh sphere_mesh = generate_sphere_mesh(16, 8);
+    Mesh cone_mesh = generate_cone_mesh(16);
+    auto sphere_vertex_array = buffer_mesh(sphere_mesh);
+    auto cone_vertex_array = buffer_mesh(cone_mesh);
+
     for (auto& mesh : backpack.meshes)
     {
         mesh.vertex_array = buffer_mesh(mesh);
     }
 
+    // For culling the shadow casters
+    auto terrain_bounds = compute_bounding_sphere(terrain_mesh);
+    auto box_bounds = compute_bounding_sphere(box_mesh);
+    auto model_bounds = compute_bounding_sphere(backpack.meshes);
+    auto billboard_bounds = compute_bounding_sphere(billboard_mesh);
+
     // ------------------------------------
-    // ==== Create the OpenGL Textures ====
+    // ==== Upload the OpenGL Textures ====
     // ------------------------------------
-    auto load_texture = [](const fs::path& path)
-    {
-        std::cout << "Loading texture " << path << '\n';
-        GLuint texture;
-        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-
-        // Load the texture from file
-        sf::Image image;
-        image.loadFromFile(path.string());
-        image.flipVertically();
-        auto w = image.getSize().x;
-        auto h = image.getSize().y;
-        auto data = image.getPixelsPtr();
-
-        // Set the storage
-        glTextureStorage2D(texture, 8, GL_RGBA8, w, h);
-        // glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Upload the texture to the GPU to cover the whole created texture
-        glTextureSubImage2D(texture, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateTextureMipmap(texture);
-
-        // Set texture wrapping and min/mag filters
-        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        return texture;
-    };
-
-    GLuint person_texture = load_texture("assets/textures/person.png");
-    GLuint person_specular = load_texture("assets/textures/person_specular.png");
-
-    GLuint grass_texture = load_texture("assets/textures/grass_03.png");
-    GLuint grass_specular = load_texture("assets/textures/grass_specular.png");
-
-    GLuint crate_texture = load_texture("assets/textures/crate.png");
-    GLuint crate_specular_texture = load_texture("assets/textures/crate_specular.png");
-
-    // ---------------------------------------
-    // ==== Create the OpenGL Framebuffer ====
-    // ---------------------------------------
-    std::cout << "Creating framebuffer\n";
-    auto fbo_x = window.getSize().x;
-    auto fbo_y = window.getSize().y;
-    GLuint fbo;
-    glCreateFramebuffers(1, &fbo);
+    if (!texture_loader.upload())
+    {
+        return -1;
+    }
 
-    // Attach the texture to the framebuffer
-    GLuint fbo_texture;
-    glCreateTextures(GL_TEXTURE_2D, 1, &fbo_texture);
-    glTextureStorage2D(fbo_texture, 1, GL_RGB8, fbo_x, fbo_y);
+    // Only the texture levels close enough to be seen are kept on the GPU, within this budget
+    int texture_budget = options.texture_budget;
 
-    glTextureParameteri(fbo_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(fbo_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // ----------------------------
+    // ==== The render targets ====
+    // ----------------------------
+    // Targets are taken from the pool each frame at the largest render scale, and each frame
+    // renders into the part of them covered by the current scale. The pool keeps them between
+    // frames, so they are only created again when the window is resized
+    RenderTargetPool render_targets;
+    RenderGraph render_graph;
+    RenderScaleGovernor render_scale(options.render_scale / 100.0f);
+    if (options.target_fps > 0)
+    {
+        render_scale.enabled = true;
+        render_scale.target_frame_ms = 1000.0f / options.target_fps;
+    }
 
-    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, fbo_texture, 0);
+    PrepassTuner prepass_tuner;
+    prepass_tuner.mode = options.depth_prepass.value_or(window ? DepthPrepassMode::Auto
+                                                               : DepthPrepassMode::Off);
 
-    // Attatch a render buffer to the frame buffer
-    GLuint rbo;
-    glCreateRenderbuffers(1, &rbo);
-    glNamedRenderbufferStorage(rbo, GL_DEPTH24_STENCIL8, fbo_x, fbo_y);
-    glNamedFramebufferRenderbuffer(fbo, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+    // The flashlight's shadow map, and the six cube faces of the nearest point light's in a
+    // grid of 3x2 tiles
+    ShadowMap spot_shadow_map;
+    spot_shadow_map.create(SPOT_SHADOW_SIZE, 1, 1);
+    ShadowMap point_shadow_map;
+    point_shadow_map.create(POINT_SHADOW_TILE_SIZE, 3, 2);
 
-    if (auto status =
-            glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cerr << "Framebuffer incomplete. Status: " << status << '\n';
-        return -1;
-    }
+    // The moonlight's cascades, one per layer of a texture array
+    CascadedShadowMap moonlight_shadow_map;
+    moonlight_shadow_map.create(MOONLIGHT_SHADOW_SIZE, MOONLIGHT_CASCADES,
+                                MOONLIGHT_SHADOW_DISTANCE);
+    CascadeCasterLists cascade_casters;
 
     // --------------------------------------------------
     // ==== Create empty VBO for rendering to window ====
@@ -288,6 +404,26 @@ int main()
     GLuint fbo_vbo;
     glCreateVertexArrays(1, &fbo_vbo);
 
+    // --------------------------------------------
+    // ==== Create the per-frame stream buffer ====
+    // --------------------------------------------
+    // Big enough for the camera block, a model matrix for every entity and every light, the
+    // light clusters, the entities again for each of the 7 shadow map views and the moonlight's
+    // cascades, with slack for the alignment of each allocation
+    auto light_count = scene.lights.size() + scene.spot_lights.size();
+    auto entity_count = scene.boxes.size() + scene.people.size() + scene.models.size() + 1;
+    auto instance_count =
+        entity_count * (8 + CascadedShadowMap::MAX_CASCADES) + light_count + 16;
+    auto stream_buffer_size =
+        64 * 1024 + sizeof(glm::mat4) * instance_count + sizeof(ClusterLight) * light_count +
+        sizeof(LightClusters::Cluster) * LightClusters::CLUSTER_COUNT +
+        sizeof(std::uint32_t) * LightClusters::MAX_LIGHT_INDICES;
+    StreamBuffer stream_buffer;
+    if (!stream_buffer.create(stream_buffer_size))
+    {
+        return -1;
+    }
+
     // ----------------------
     // ==== Load shaders ====
     // ----------------------
@@ -298,6 +434,37 @@ int main()
         return -1;
     }
 
+    // Only writes depth, for the depth pre-pass
+    Shader depth_shader;
+    if (!depth_shader.load_from_file("assets/shaders/DepthVertex.glsl",
+                                     "assets/shaders/DepthFragment.glsl"))
+    {
+        return -1;
+    }
+
+    // Writes the surfaces to the G-buffer, and lights them from it
+    Shader gbuffer_shader;
+    if (!gbuffer_shader.load_from_file("assets/shaders/SceneVertex.glsl",
+                                       "assets/shaders/GBufferFragment.glsl"))
+    {
+        return -1;
+    }
+
+    Shader deferred_shader;
+    if (!deferred_shader.load_from_file("assets/shaders/DeferredVertex.glsl",
+                                        "assets/shaders/DeferredFragment.glsl"))
+    {
+        return -1;
+    }
+
+    // Draws every cascade of the moonlight's shadow map at once, into the layer of each instance
+    Shader cascade_shadow_shader;
+    if (!cascade_shadow_shader.load_from_file("assets/shaders/CascadeShadowVertex.glsl",
+                                              "assets/shaders/DepthFragment.glsl"))
+    {
+        return -1;
+    }
+
     Shader fbo_shader;
     if (!fbo_shader.load_from_file("assets/shaders/ScreenVertex.glsl",
                                    "assets/shaders/ScreenFragment.glsl"))
@@ -310,43 +477,72 @@ int main()
     // -----------------------------------
     Transform camera_transform;
     Transform terrain_transform;
-    Transform light_transform;
-    std::vector<Transform> box_transforms;
-    for (int i = 0; i < 25; i++)
-    {
-        float x = static_cast<float>(rand() % 120) + 3;
-        float z = static_cast<float>(rand() % 120) + 3;
-        float r = static_cast<float>(rand() % 360);
 
-        box_transforms.push_back({{x, 0.0f, z}, {0.0f, r, 0}});
-    }
+    camera_transform.position = {80.0f, 1.0f, 35.0f};
+    camera_transform.rotation = {0.0f, 201.0f, 0.0f};
 
-    std::vector<Transform> people_transforms;
-    for (int i = 0; i < 50; i++)
-    {
-        float x = static_cast<float>(rand() % 120) + 3;
-        float z = static_cast<float>(rand() % 120) + 3;
+    // Boxes and models never move, so their matrices only need creating once
+    std::vector<glm::mat4> terrain_mats = {create_model_matrix(terrain_transform)};
 
-        people_transforms.push_back({{x, 0.0f, z}, {0.0f, 0.0, 0}});
+    std::vector<glm::mat4> box_mats(scene.boxes.size());
+    std::vector<glm::mat4> model_mats(scene.models.size());
+    std::vector<glm::mat4> billboard_mats(scene.people.size());
+    std::vector<glm::mat4> light_mats(light_count);
+    std::vector<ClusterLight> cluster_lights(light_count);
+
+    std::transform(scene.boxes.begin(), scene.boxes.end(), box_mats.begin(), create_model_matrix);
+    std::transform(scene.models.begin(), scene.models.end(), model_mats.begin(),
+                   create_model_matrix);
+
+    // The atlas rectangle of every billboard, in the same order as its matrix. Every other
+    // round of the sprites is mirrored, for more variety from the same sprites
+    std::vector<SpriteRect> billboard_sprites(std::max<std::size_t>(scene.people.size(), 1));
+    for (std::size_t i = 0; i < scene.people.size(); i++)
+    {
+        auto round = i / billboard_atlas.sprite_count();
+        billboard_sprites[i] = billboard_atlas.rect(
+            static_cast<int>(i % billboard_atlas.sprite_count()), round % 2 == 1);
     }
+    GLuint billboard_sprite_buffer = 0;
+    glCreateBuffers(1, &billboard_sprite_buffer);
+    glNamedBufferStorage(billboard_sprite_buffer, sizeof(SpriteRect) * billboard_sprites.size(),
+                         billboard_sprites.data(), 0x0);
 
-    camera_transform.position = {80.0f, 1.0f, 35.0f};
-    camera_transform.rotation = {0.0f, 201.0f, 0.0f};
-    light_transform.position = {20.0f, 5.0f, 20.0f};
+    // The spot lights never move either, and come after the point lights in the light list
+    for (std::size_t i = 0; i < scene.spot_lights.size(); i++)
+    {
+        auto& spot_light = scene.spot_lights[i];
+        auto index = scene.lights.size() + i;
+        light_mats[index] = glm::translate(glm::mat4{1.0f}, spot_light.position);
+
+        cluster_lights[index].position = spot_light.position;
+        cluster_lights[index].colour = spot_light.colour;
+        cluster_lights[index].direction = spot_light.direction;
+        cluster_lights[index].cutoff = glm::cos(glm::radians(spot_light.cutoff));
+    }
+    LightClusters light_clusters;
 
-    glm::mat4 camera_projection =
-        glm::perspective(glm::radians(75.0f), 1600.0f / 900.0f, 1.0f, 256.0f);
+    glm::mat4 camera_projection = create_projection(width, height);
     glm::vec3 up = {0, 1, 0};
 
     // ----------------------------
     // ==== Load sound effects ====
     // ----------------------------
     // Load walking sounds
+    auto load_sound = [](sf::SoundBuffer& buffer, const fs::path& path)
+    {
+        if (auto asset = AssetPack::find(path))
+        {
+            return buffer.loadFromMemory(asset->data(), asset->size());
+        }
+        return buffer.loadFromFile(path.string());
+    };
+
     sf::SoundBuffer walk0;
-    walk0.loadFromFile("assets/sounds/sfx_step_grass_l.ogg");
+    load_sound(walk0, "assets/sounds/sfx_step_grass_l.ogg");
 
     sf::SoundBuffer walk1;
-    walk1.loadFromFile("assets/sounds/sfx_step_grass_r.ogg");
+    load_sound(walk1, "assets/sounds/sfx_step_grass_r.ogg");
 
     std::size_t sound_idx = 0;
     std::array<sf::Sound, 2> walk_sounds;
@@ -356,7 +552,15 @@ int main()
     auto create_looping_bg =
         [](sf::Music& background_sfx, const std::string path, int volume, int offset)
     {
-        background_sfx.openFromFile(path);
+        // Music streams from the pack's mapping, which is never unmapped
+        if (auto asset = AssetPack::find(path))
+        {
+            background_sfx.openFromMemory(asset->data(), asset->size());
+        }
+        else
+        {
+            background_sfx.openFromFile(path);
+        }
         background_sfx.setLoop(true);
         background_sfx.setVolume(volume);
         background_sfx.setPlayingOffset(sf::seconds(offset));
@@ -367,56 +571,113 @@ int main()
     sf::Music ambient_night1;
     sf::Music ambient_night2;
     sf::Music spookysphere;
-    create_looping_bg(ambient_night1, "assets/sounds/crickets.ogg", 50, 0);
-    create_looping_bg(ambient_night2, "assets/sounds/crickets.ogg", 50, 5);
-    create_looping_bg(spookysphere, "assets/sounds/Atmosphere_003(Loop).wav", 10, 0);
+    if (!options.headless)
+    {
+        create_looping_bg(ambient_night1, "assets/sounds/crickets.ogg", 50, 0);
+        create_looping_bg(ambient_night2, "assets/sounds/crickets.ogg", 50, 5);
+        create_looping_bg(spookysphere, "assets/sounds/Atmosphere_003(Loop).wav", 10, 0);
+    }
+
+    // ------------------------------------
+    // ==== Start the simulation thread ====
+    // ------------------------------------
+    SimulationState initial_state;
+    initial_state.camera = camera_transform;
+    SimulationThread simulation(initial_state, scene.lights);
+    simulation.start();
 
     // -------------------
     // ==== Main Loop ====
     // -------------------
     Settings settings;
+    settings.deferred = options.deferred;
+    settings.shadows = !options.no_shadows;
+
+    std::vector<float> frame_times;
+    sf::Clock frame_clock;
+    std::uint64_t last_governed_frame = 0;
+    std::uint64_t last_prepass_sample = 0;
+    GLsizei render_width = 0;
+    GLsizei render_height = 0;
+    GLuint final_colour = 0;
+
+    // Interpolated into every frame, reusing the memory of its lights
+    SimulationState state;
+    auto is_running = [&]()
+    {
+        return window ? window->isOpen()
+                      : static_cast<int>(frame_times.size()) < options.frames;
+    };
 
-    TimeStep<60> time_step;
-    sf::Clock game_time;
-    sf::Clock delta_clock;
-    while (window.isOpen())
+    Profiler::set_thread_name("Render");
+    GLStats::set_enabled(options.gl_stats);
+    if (!options.trace_path.empty())
     {
-        auto game_time_now = game_time.getElapsedTime();
-        GUI::begin_frame();
-        sf::Event e;
-        while (window.pollEvent(e))
-        {
-            GUI::event(window, e);
-            if (e.type == sf::Event::Closed)
-                window.close();
-            else if (e.type == sf::Event::KeyReleased)
-                if (e.key.code == sf::Keyboard::Escape)
-                    window.close();
-                else if (e.key.code == sf::Keyboard::L)
-                    mouse_locked = !mouse_locked;
-        }
-        if (!window.isOpen())
+        Profiler::start_capture(options.frames);
+    }
+
+    while (is_running())
+    {
+        Profiler::begin_frame();
+        glm::vec3 translate{0.0f};
+        if (window)
         {
-            break;
-        }
-        // ImGui::SFML::Update()
+            PROFILE_ZONE("Input");
+            GUI::begin_frame();
+            sf::Event e;
+            while (window->pollEvent(e))
+            {
+                GUI::event(*window, e);
+                if (e.type == sf::Event::Closed)
+                {
+                    window->close();
+                }
+                else if (e.type == sf::Event::KeyReleased)
+                {
+                    if (e.key.code == sf::Keyboard::Escape)
+                        window->close();
+                    else if (e.key.code == sf::Keyboard::L)
+                        mouse_locked = !mouse_locked;
+                }
+                else if (e.type == sf::Event::Resized && e.size.width > 0 && e.size.height > 0)
+                {
+                    // Minimising sends a 0x0 size, which is ignored. The render targets at the
+                    // old size are freed by the pool once they go unused
+                    width = e.size.width;
+                    height = e.size.height;
+                    camera_projection = create_projection(width, height);
+                }
+            }
+            if (!window->isOpen())
+            {
+                break;
+            }
+            // ImGui::SFML::Update()
 
-        // ---------------
-        // ==== Input ====
-        // ---------------
-        auto SPEED = 5.0f;
-        auto translate = get_keyboard_input(camera_transform, true) * SPEED;
+            // ---------------
+            // ==== Input ====
+            // ---------------
+            auto SPEED = 5.0f;
+            translate = get_keyboard_input(camera_transform, true) * SPEED;
 
-        if (!mouse_locked)
-        {
-            window.setMouseCursorVisible(false);
-            get_mouse_move_input(camera_transform, window);
-        }
-        else
-        {
-            window.setMouseCursorVisible(true);
+            if (!mouse_locked)
+            {
+                window->setMouseCursorVisible(false);
+                get_mouse_move_input(camera_transform, *window);
+            }
+            else
+            {
+                window->setMouseCursorVisible(true);
+            }
         }
 
+        // Hand the input over to the simulation thread and grab the latest state it has
+        // published, blended between ticks. The rotation is kept from the local input rather
+        // than the snapshot so the mouse look does not lag behind by a tick
+        simulation.set_input({translate, camera_transform.rotation});
+        simulation.interpolate_state(state);
+        camera_transform.position = state.camera.position;
+
         // ------------------------
         // ==== Sound handling ====
         // ------------------------
@@ -436,25 +697,11 @@ int main()
             }
         }
 
-        // ----------------------------------
-        // ==== Update w/ Fixed timestep ====
-        // ----------------------------------
-        time_step.update(
-            [&](auto dt)
-            {
-                camera_transform.position += translate * dt.asSeconds();
-
-                light_transform.position.x +=
-                    glm::sin(game_time_now.asSeconds() * 0.55f) * dt.asSeconds() * 3.0f;
-                light_transform.position.z +=
-                    glm::cos(game_time_now.asSeconds() * 0.55f) * dt.asSeconds() * 3.0f;
-
-                //   settings.spot_light.cutoff -= 0.01;
-            });
-
         // -------------------------------
         // ==== Transform Calculations ====
         // -------------------------------
+        std::optional<Profiler::CPUZoneScope> transforms_zone("Transforms");
+
         // View/ Camera matrix
         glm::mat4 view_matrix{1.0f};
         auto x_rot = glm::radians(camera_transform.rotation.x);
@@ -468,47 +715,284 @@ int main()
 
         view_matrix = glm::lookAt(camera_transform.position, centre, up);
 
+        // The flashlight is held off to the side, so the shadows it casts can be seen
+        glm::vec3 right = glm::normalize(glm::cross(front, up));
+        glm::vec3 flashlight_position = camera_transform.position + right * 0.3f - up * 0.2f;
+
         // Model matrices
-        auto create_model_matrix = [](const Transform& transform)
+        // Rotate each billboard to face the camera
+        thread_pool.parallel_for(
+            scene.people.size(), 4096,
+            [&](std::size_t begin, std::size_t end)
+            {
+                PROFILE_ZONE("Billboard matrices");
+                for (auto i = begin; i < end; i++)
+                {
+                    auto& transform = scene.people[i];
+                    auto pi = static_cast<float>(std::numbers::pi);
+                    auto xd = transform.position.x - camera_transform.position.x;
+                    auto yd = transform.position.z - camera_transform.position.z;
+
+                    auto r = std::atan2(xd, yd) + pi;
+
+                    glm::mat4 billboard_mat{1.0f};
+                    billboard_mat = glm::translate(billboard_mat, transform.position);
+                    billboard_mat = glm::rotate(billboard_mat, r, {0, 1, 0});
+                    billboard_mats[i] = billboard_mat;
+                }
+            });
+
+        for (std::size_t i = 0; i < scene.lights.size(); i++)
         {
-            glm::mat4 mat{1.0f};
-            mat = glm::translate(mat, transform.position);
-            mat = glm::rotate(mat, glm::radians(transform.rotation.x), {1, 0, 0});
-            mat = glm::rotate(mat, glm::radians(transform.rotation.y), {0, 1, 0});
-            mat = glm::rotate(mat, glm::radians(transform.rotation.z), {0, 0, 1});
+            light_mats[i] = glm::translate(glm::mat4{1.0f}, state.lights[i].position);
 
-            return mat;
+            cluster_lights[i].position = state.lights[i].position;
+            cluster_lights[i].intensity = state.lights[i].intensity;
+            cluster_lights[i].colour = scene.lights[i].colour;
+        }
+        for (auto& light : cluster_lights)
+        {
+            light.range = settings.point_light.range;
+        }
+        transforms_zone.reset();
+
+        // The deferred path lights with volumes around each light instead
+        if (!settings.deferred)
+        {
+            PROFILE_ZONE("Cluster lights");
+            light_clusters.build(cluster_lights, view_matrix, camera_projection, thread_pool);
+        }
+
+        // -----------------------------------
+        // ==== Stream the per-frame data ====
+        // -----------------------------------
+        stream_buffer.begin_frame();
+        std::optional<Profiler::CPUZoneScope> upload_zone("Upload uniforms");
+
+        CameraBlock camera_block;
+        camera_block.projection_matrix = camera_projection;
+        camera_block.view_matrix = view_matrix;
+        camera_block.eye_position = camera_transform.position;
+        auto camera_data =
+            stream_buffer.bind_data(GL_UNIFORM_BUFFER, 0, &camera_block, sizeof(camera_block));
+
+        // Every cluster is written each frame, the empty ones make sure the shader never reads
+        // the indices or lights when there are none (or they did not fit). The deferred path
+        // only reads the lights
+        auto light_data =
+            stream_buffer.bind_data(GL_SHADER_STORAGE_BUFFER, 2, cluster_lights.data(),
+                                    sizeof(ClusterLight) * cluster_lights.size());
+        if (!settings.deferred)
+        {
+            auto& light_indices = light_clusters.light_indices();
+            auto light_index_data =
+                stream_buffer.bind_data(GL_SHADER_STORAGE_BUFFER, 4, light_indices.data(),
+                                        sizeof(std::uint32_t) * light_indices.size());
+            if (light_data.valid() && light_index_data.valid())
+            {
+                auto& clusters = light_clusters.clusters();
+                stream_buffer.bind_data(GL_SHADER_STORAGE_BUFFER, 3, clusters.data(),
+                                        sizeof(LightClusters::Cluster) * clusters.size());
+            }
+            else
+            {
+                static const std::vector<LightClusters::Cluster> empty_clusters(
+                    LightClusters::CLUSTER_COUNT);
+                stream_buffer.bind_data(GL_SHADER_STORAGE_BUFFER, 3, empty_clusters.data(),
+                                        sizeof(LightClusters::Cluster) * empty_clusters.size());
+            }
+        }
+
+        // Writes the model matrices of each draw into the instance buffer once, so the depth
+        // pre-pass and the scene pass can both bind them
+        struct Instances
+        {
+            StreamAllocation allocation;
+            GLsizei count = 0;
         };
+        auto stream_instances = [&](const glm::mat4* matrices, std::size_t count)
+        {
+            Instances instances;
+            instances.allocation = stream_buffer.write_data(GL_SHADER_STORAGE_BUFFER, matrices,
+                                                            sizeof(glm::mat4) * count);
+            instances.count = instances.allocation.valid() ? static_cast<GLsizei>(count) : 0;
+            return instances;
+        };
+        auto terrain_instances = stream_instances(terrain_mats.data(), 1);
+        auto box_instances = stream_instances(box_mats.data(), box_mats.size());
+        auto model_instances = stream_instances(model_mats.data(), model_mats.size());
+        auto billboard_instances = stream_instances(billboard_mats.data(), billboard_mats.size());
+        auto light_instances = stream_instances(light_mats.data(), light_mats.size());
+
+        // Binds the instances of a draw, returning how many instances to draw (0 if the stream
+        // buffer ran out of space)
+        auto bind_instances = [&](const Instances& instances)
+        {
+            stream_buffer.bind(GL_SHADER_STORAGE_BUFFER, 1, instances.allocation);
+            return instances.count;
+        };
+
+        // -----------------------------------
+        // ==== Cull the shadow casters ====
+        // -----------------------------------
+        // Each view of a light only draws the casters that touch it. The terrain, boxes and
+        // models never move, so they are only drawn when the light's cache is redrawn, and the
+        // billboards that turn to face the camera are drawn over the cache every frame
+        struct ShadowViewCasters
+        {
+            StreamAllocation camera;
+            Instances terrain;
+            Instances boxes;
+            Instances models;
+            Instances billboards;
+        };
+        struct ShadowCasters
+        {
+            std::vector<ShadowViewCasters> views;
+            bool redraw_cache = false;
+
+            // The cache is only kept if everything fit in the stream buffer
+            bool cache_complete = true;
+        };
+        std::vector<std::vector<glm::mat4>> shadow_visible;
+        auto cull_shadow_casters = [&](ShadowMap& map, const glm::vec3& light_position)
+        {
+            ShadowCasters casters;
+            casters.views.resize(map.view_count());
+            casters.redraw_cache = !map.cache_valid();
+            for (std::size_t view = 0; view < casters.views.size(); view++)
+            {
+                CameraBlock light_camera;
+                light_camera.projection_matrix = map.view_projection(view);
+                light_camera.eye_position = light_position;
+                casters.views[view].camera = stream_buffer.write_data(
+                    GL_UNIFORM_BUFFER, &light_camera, sizeof(light_camera));
+                casters.cache_complete &= casters.views[view].camera.valid();
+            }
 
-        auto terrain_mat = create_model_matrix(terrain_transform);
-        auto light_mat = create_model_matrix(light_transform);
+            auto cull = [&](const std::vector<glm::mat4>& model_matrices,
+                            const BoundingSphere& bounds, bool is_static,
+                            Instances ShadowViewCasters::*group)
+            {
+                shadow_visible.clear();
+                map.cull(model_matrices, bounds, is_static, shadow_visible);
+                for (std::size_t view = 0; view < casters.views.size(); view++)
+                {
+                    auto& visible = shadow_visible[view];
+                    auto& instances = casters.views[view].*group;
+                    instances = stream_instances(visible.data(), visible.size());
+                    casters.cache_complete &= instances.count == std::ssize(visible);
+                }
+            };
+            if (casters.redraw_cache)
+            {
+                cull(terrain_mats, terrain_bounds, true, &ShadowViewCasters::terrain);
+                cull(box_mats, box_bounds, true, &ShadowViewCasters::boxes);
+                cull(model_mats, model_bounds, true, &ShadowViewCasters::models);
+            }
+            cull(billboard_mats, billboard_bounds, false, &ShadowViewCasters::billboards);
+            return casters;
+        };
 
-        std::vector<glm::mat4> box_mats;
-        for (auto& box_transform : box_transforms)
+        ShadowCasters spot_casters;
+        ShadowCasters point_casters;
+        int shadow_light = -1;
+        if (settings.shadows)
         {
-            box_mats.push_back(create_model_matrix(box_transform));
+            PROFILE_ZONE("Cull shadow casters");
+            spot_shadow_map.set_views({spot_light_view_projection(
+                flashlight_position, front, settings.spot_light.cutoff, FLASHLIGHT_RANGE)});
+            spot_casters = cull_shadow_casters(spot_shadow_map, flashlight_position);
+
+            // The point light nearest the camera gets the point light shadow map
+            float nearest = std::numeric_limits<float>::max();
+            for (std::size_t i = 0; i < scene.lights.size(); i++)
+            {
+                auto offset = cluster_lights[i].position - camera_transform.position;
+                if (glm::dot(offset, offset) < nearest)
+                {
+                    nearest = glm::dot(offset, offset);
+                    shadow_light = static_cast<int>(i);
+                }
+            }
+            if (shadow_light >= 0)
+            {
+                auto& position = cluster_lights[shadow_light].position;
+                auto faces = point_light_view_projections(position, settings.point_light.range,
+                                                          POINT_SHADOW_TILE_SIZE);
+                point_shadow_map.set_views({faces.begin(), faces.end()});
+                point_casters = cull_shadow_casters(point_shadow_map, position);
+            }
+
+            moonlight_shadow_map.set_views(view_matrix, camera_projection,
+                                           settings.dir_light.direction);
+            moonlight_shadow_map.cull(terrain_mats, terrain_bounds, true, cascade_casters.terrain);
+            moonlight_shadow_map.cull(box_mats, box_bounds, true, cascade_casters.boxes);
+            moonlight_shadow_map.cull(model_mats, model_bounds, true, cascade_casters.models);
+            moonlight_shadow_map.cull(billboard_mats, billboard_bounds, false,
+                                      cascade_casters.billboards);
         }
 
-        // -----------------------
-        // ==== Render to FBO ====
-        // -----------------------
-        // Set the framebuffer as the render target and clear
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        // The cascades that are drawn again are drawn together. Each draw has the instances of
+        // every cascade being drawn one after the other, and the vertex shader finds the
+        // cascade of an instance from where each cascade's instances end
+        struct LayeredInstances
+        {
+            Instances instances;
+            std::array<GLint, CascadedShadowMap::MAX_CASCADES> ends{};
+        };
+        struct MoonlightCasters
+        {
+            std::array<bool, CascadedShadowMap::MAX_CASCADES> redraw{};
+            bool redraw_any = false;
 
-        // Set the shader states
-        //......................
-        scene_shader.bind();
-        scene_shader.set_uniform("projection_matrix", camera_projection);
-        scene_shader.set_uniform("view_matrix", view_matrix);
+            // The cascades are only kept if everything fit in the stream buffer
+            bool complete = true;
 
-        scene_shader.set_uniform("eye_position", camera_transform.position);
+            LayeredInstances terrain;
+            LayeredInstances boxes;
+            LayeredInstances models;
+            LayeredInstances billboards;
+        };
+        MoonlightCasters moonlight_casters;
+        std::vector<glm::mat4> layered_matrices;
+        auto stream_layered = [&](const std::vector<std::vector<glm::mat4>>& visible)
+        {
+            LayeredInstances layered;
+            layered_matrices.clear();
+            for (int cascade = 0; cascade < CascadedShadowMap::MAX_CASCADES; cascade++)
+            {
+                if (moonlight_casters.redraw[cascade])
+                {
+                    auto& instances = visible[cascade];
+                    layered_matrices.insert(layered_matrices.end(), instances.begin(),
+                                            instances.end());
+                }
+                layered.ends[cascade] = static_cast<GLint>(layered_matrices.size());
+            }
+            layered.instances = stream_instances(layered_matrices.data(), layered_matrices.size());
+            moonlight_casters.complete &=
+                layered.instances.count == std::ssize(layered_matrices);
+            return layered;
+        };
+        if (settings.shadows)
+        {
+            for (int cascade = 0; cascade < moonlight_shadow_map.cascade_count(); cascade++)
+            {
+                moonlight_casters.redraw[cascade] = moonlight_shadow_map.needs_redraw(cascade);
+                moonlight_casters.redraw_any |= moonlight_casters.redraw[cascade];
+            }
+            if (moonlight_casters.redraw_any)
+            {
+                moonlight_casters.terrain = stream_layered(cascade_casters.terrain);
+                moonlight_casters.boxes = stream_layered(cascade_casters.boxes);
+                moonlight_casters.models = stream_layered(cascade_casters.models);
+                moonlight_casters.billboards = stream_layered(cascade_casters.billboards);
+            }
+        }
 
-        scene_shader.set_uniform("material.diffuse0", 0);
-        scene_shader.set_uniform("material.specular0", 1);
+        // Set the shader states
+        //......................
         scene_shader.set_uniform("material.shininess", settings.material_shine);
         // clang-format off
 
@@ -528,145 +1012,843 @@ int main()
             shader.set_uniform(uniform + ".att.exponant",   attenuation.exponant);
         };
 
-        // Set the directional light shader uniforms
-        scene_shader.set_uniform("dir_light.direction", settings.dir_light.direction);
-        upload_base_light(scene_shader,                 settings.dir_light, "dir_light");
+        // The deferred lighting shader has the same light uniforms as the scene shader
+        auto upload_lights = [&](Shader& shader)
+        {
+            // Set the directional light shader uniforms
+            shader.set_uniform("dir_light.direction",   settings.dir_light.direction);
+            upload_base_light(shader,                   settings.dir_light, "dir_light");
+
+            // Set the point light shader uniforms, shared by every light in the light list
+            upload_base_light(shader,                   settings.point_light, "point_light");
+            upload_attenuation(shader,                  settings.point_light.att, "point_light");
+
+            // Set the spot light shader uniforms
+            shader.set_uniform("spot_light.cutoff",     glm::cos(glm::radians(settings.spot_light.cutoff)));
+            shader.set_uniform("spot_light.position",   flashlight_position);
+            shader.set_uniform("spot_light.direction",  front);
+            upload_base_light(shader,                   settings.spot_light, "spot_light");
+            upload_attenuation(shader,                  settings.spot_light.att, "spot_light");
+        };
 
-        // Set the point light shader uniforms
-        scene_shader.set_uniform("point_light.position", light_transform.position);
-        upload_base_light(scene_shader,                     settings.point_light, "point_light");
-        upload_attenuation(scene_shader,                    settings.point_light.att, "point_light");
+        // clang-format on
 
-        // Set the spot light shader uniforms
-        scene_shader.set_uniform("spot_light.cutoff",       glm::cos(glm::radians(settings.spot_light.cutoff)));
-        scene_shader.set_uniform("spot_light.position",     camera_transform.position);
-        scene_shader.set_uniform("spot_light.direction",    front);
-        upload_base_light(scene_shader,                     settings.spot_light, "spot_light");
-        upload_attenuation(scene_shader,                    settings.spot_light.att, "spot_light");
+        auto upload_shadows = [&](Shader& shader)
+        {
+            shader.set_uniform("spot_shadow", settings.shadows);
+            if (settings.shadows)
+            {
+                shader.set_uniform("spot_shadow_matrix", spot_shadow_map.sample_matrix(0));
+                shader.set_uniform("spot_shadow_offset",
+                                   spot_shadow_map.texel_size(0) * SHADOW_NORMAL_OFFSET);
+            }
 
-        // clang-format on
+            shader.set_uniform("shadow_light", shadow_light);
+            if (shadow_light >= 0)
+            {
+                for (std::size_t face = 0; face < point_shadow_map.view_count(); face++)
+                {
+                    shader.set_uniform("point_shadow_matrices[" + std::to_string(face) + "]",
+                                       point_shadow_map.sample_matrix(face));
+                }
+                shader.set_uniform("point_shadow_offset",
+                                   point_shadow_map.texel_size(0) * SHADOW_NORMAL_OFFSET);
+            }
 
-        scene_shader.set_uniform("is_light", false);
+            auto cascades = settings.shadows ? moonlight_shadow_map.cascade_count() : 0;
+            shader.set_uniform("cascade_count", cascades);
+            for (int cascade = 0; cascade < cascades; cascade++)
+            {
+                auto index = "[" + std::to_string(cascade) + "]";
+                shader.set_uniform("cascade_matrices" + index,
+                                   moonlight_shadow_map.sample_matrix(cascade));
+                shader.set_uniform("cascade_splits" + index,
+                                   moonlight_shadow_map.split_distance(cascade));
+                shader.set_uniform("cascade_offsets" + index,
+                                   moonlight_shadow_map.texel_size(cascade) *
+                                       SHADOW_NORMAL_OFFSET);
+            }
+        };
 
-        // Set the terrain trasform and render
-        if (settings.grass)
+        if (settings.deferred)
         {
-            glBindTextureUnit(0, grass_texture);
-            glBindTextureUnit(1, grass_specular);
+            upload_lights(deferred_shader);
+            upload_shadows(deferred_shader);
+            deferred_shader.set_uniform("shininess", settings.material_shine);
         }
         else
         {
-            glBindTextureUnit(0, crate_texture);
-            glBindTextureUnit(1, crate_specular_texture);
+            upload_lights(scene_shader);
+            upload_shadows(scene_shader);
+            scene_shader.set_uniform("cluster_depth_scale_bias",
+                                     light_clusters.depth_slice_scale_bias());
         }
+        scene_shader.set_uniform("is_light", false);
+        upload_zone.reset();
+
+        // Points the material at its textures' layers of the texture arrays, so changing the
+        // material binds nothing
+        auto set_texture_layer = [&](Shader& shader, const std::string& name, TextureHandle handle)
+        {
+            auto& layer = texture_loader.layer(handle);
+            shader.set_uniform(name + ".array", layer.array);
+            shader.set_uniform(name + ".layer", layer.layer);
+        };
+        auto set_material = [&](Shader& shader, TextureHandle texture)
+        {
+            set_texture_layer(shader, "material.diffuse", texture);
+        };
 
-        scene_shader.set_uniform("model_matrix", terrain_mat);
-        glBindVertexArray(terrain_vertex_array.vao);
-        glDrawElements(GL_TRIANGLES, terrain_mesh.indices.size(), GL_UNSIGNED_INT, nullptr);
+        // Draws a mesh with the first of its diffuse textures
+        auto draw_model = [&](const Mesh& mesh, Shader& shader, GLsizei instances)
+        {
+            auto texture = std::ranges::find(mesh.textures, "diffuse", &Texture::type);
+            if (texture != mesh.textures.end())
+            {
+                set_material(shader, texture->handle);
+            }
+            // draw mesh
+            glBindVertexArray(mesh.vertex_array.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0,
+                                    instances);
+            glBindVertexArray(0);
+        };
 
-        // Set the box transforms and render
-        glBindTextureUnit(0, crate_texture);
-        glBindTextureUnit(1, crate_specular_texture);
-        glBindVertexArray(box_vertex_array.vao);
-        for (auto& box_matrix : box_mats)
+        // ---------------------------------
+        // ==== Build the frame's passes ====
+        // ---------------------------------
+        // The scene only renders to the scaled area of its targets, the blit to the window
+        // upscales it
+        render_width = render_scale.scaled(width);
+        render_height = render_scale.scaled(height);
+
+        // -----------------------------
+        // ==== Stream the textures ====
+        // -----------------------------
+        // Each texture asks for the levels its nearest instance in view needs, from how many
+        // pixels the whole texture would cover there
         {
-            scene_shader.set_uniform("model_matrix", box_matrix);
-            glDrawElements(GL_TRIANGLES, box_mesh.indices.size(), GL_UNSIGNED_INT, nullptr);
+            PROFILE_ZONE("Texture requests");
+            Frustum view_frustum(camera_projection * view_matrix);
+            auto pixels_per_unit = camera_projection[1][1] * render_height / 2.0f;
+
+            // `texture_size` is how far the whole texture stretches over the mesh
+            auto request = [&](TextureHandle texture, float texture_size,
+                               const std::vector<glm::mat4>& model_matrices,
+                               const BoundingSphere& bounds)
+            {
+                float nearest = std::numeric_limits<float>::max();
+                for (auto& model_matrix : model_matrices)
+                {
+                    auto centre = glm::vec3{model_matrix * glm::vec4{bounds.centre, 1.0f}};
+                    if (view_frustum.intersects_sphere(centre, bounds.radius))
+                    {
+                        auto distance = glm::distance(centre, camera_transform.position);
+                        nearest = std::min(nearest, distance - bounds.radius);
+                    }
+                }
+                if (nearest == std::numeric_limits<float>::max())
+                {
+                    return;
+                }
+
+                // Nothing is drawn closer than the near plane
+                auto screen_size = texture_size * pixels_per_unit / std::max(nearest, 1.0f);
+                texture_arrays.request(texture_loader.layer(texture), screen_size);
+            };
+
+            // The terrain repeats its texture every unit
+            if (settings.grass)
+            {
+                request(grass_texture, 1.0f, terrain_mats, terrain_bounds);
+            }
+            else
+            {
+                request(crate_texture, 1.0f, terrain_mats, terrain_bounds);
+            }
+            request(crate_texture, 2.0f, box_mats, box_bounds);
+            request(billboard_atlas.texture(), 2.0f / billboard_atlas.rect(0).size.y,
+                    billboard_mats, billboard_bounds);
+            for (auto& mesh : backpack.meshes)
+            {
+                for (auto& texture : mesh.textures)
+                {
+                    request(texture.handle, model_bounds.radius * 2.0f, model_mats, model_bounds);
+                }
+            }
         }
+        texture_arrays.stream(static_cast<std::size_t>(texture_budget) * 1024 * 1024);
+
+        RenderTargetDesc colour_desc{render_scale.allocated(width),
+                                     render_scale.allocated(height), GL_RGB8};
+        RenderTargetDesc depth_desc = colour_desc;
+        depth_desc.format = GL_DEPTH24_STENCIL8;
+
+        render_graph.begin_frame();
+        auto backbuffer = render_graph.import_backbuffer("Backbuffer", width, height);
 
-        // Draws a mesh by loop the textures to bind, and then rendering
-        auto draw_model = [](const Mesh& mesh, Shader& shader)
+        // Draws everything in the scene. The depth pre-pass only needs the geometry, so it skips
+        // the textures and material uniforms
+        auto draw_scene = [&](SceneDraw mode, Shader& shader)
         {
-            GLuint diffuse_id = 0;
-            GLuint specular_id = 0;
-            for (int i = 0; i < mesh.textures.size(); i++)
+            bool textured = mode != SceneDraw::Depth;
+            if (textured)
+            {
+                texture_arrays.bind(0);
+            }
+
+            // Set the terrain trasform and render
+            if (textured && settings.grass)
+            {
+                set_material(shader, grass_texture);
+            }
+            else if (textured)
+            {
+                set_material(shader, crate_texture);
+            }
+
             {
-                std::string number;
-                std::string name = mesh.textures[i].type;
-                if (name == "diffuse")
-                    number = std::to_string(diffuse_id++);
-                else if (name == "specular")
-                    number = std::to_string(specular_id++);
+                PROFILE_GPU_ZONE("Draw terrain");
+                glBindVertexArray(terrain_vertex_array.vao);
+                glDrawElementsInstanced(GL_TRIANGLES, terrain_mesh.indices.size(), GL_UNSIGNED_INT,
+                                        nullptr, bind_instances(terrain_instances));
+            }
 
-                auto uni = "material." + name + number;
-                shader.set_uniform(uni, i);
+            // Set the box transforms and render
+            {
+                PROFILE_GPU_ZONE("Draw boxes");
+                if (textured)
+                {
+                    set_material(shader, crate_texture);
+                }
+                glBindVertexArray(box_vertex_array.vao);
+                glDrawElementsInstanced(GL_TRIANGLES, box_mesh.indices.size(), GL_UNSIGNED_INT,
+                                        nullptr, bind_instances(box_instances));
+            }
 
-                glBindTextureUnit(i, mesh.textures[i].id);
+            // Draw every instance of the model loaded from assimp
+            {
+                PROFILE_GPU_ZONE("Draw models");
+                auto model_count = bind_instances(model_instances);
+                for (auto& mesh : backpack.meshes)
+                {
+                    if (!textured)
+                    {
+                        glBindVertexArray(mesh.vertex_array.vao);
+                        glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT,
+                                                nullptr, model_count);
+                    }
+                    else
+                    {
+                        draw_model(mesh, shader, model_count);
+                    }
+                }
             }
-            // draw mesh
-            glBindVertexArray(mesh.vertex_array.vao);
-            glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
+
+            // Draw billboards
+            {
+                PROFILE_GPU_ZONE("Draw billboards");
+                if (textured)
+                {
+                    set_material(shader, billboard_atlas.texture());
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, billboard_sprite_buffer);
+                    shader.set_uniform("sprites", true);
+                }
+                glBindVertexArray(billboard_vertex_array.vao);
+                glDrawElementsInstanced(GL_TRIANGLES, billboard_mesh.indices.size(),
+                                        GL_UNSIGNED_INT, nullptr,
+                                        bind_instances(billboard_instances));
+                if (textured)
+                {
+                    shader.set_uniform("sprites", false);
+                }
+            }
+        };
+
+        // The lights are drawn unlit, so the deferred path draws them with the scene shader
+        // after the lighting
+        auto draw_lights = [&](SceneDraw mode)
+        {
+            PROFILE_GPU_ZONE("Draw lights");
+            if (mode != SceneDraw::Depth)
+            {
+                texture_arrays.bind(0);
+                set_material(scene_shader, billboard_atlas.texture());
+                scene_shader.set_uniform("is_light", true);
+            }
+            glBindVertexArray(light_vertex_array.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, light_mesh.indices.size(), GL_UNSIGNED_INT,
+                                    nullptr, bind_instances(light_instances));
         };
 
-        // Draw a model loaded from assimp
-        glm::mat4 mesh_matrix{1.0f};
-        mesh_matrix = glm::translate(mesh_matrix, {30.0f, 5.0f, 30.0f});
-        // mesh_matrix = glm::scale(mesh_matrix, {0.02f, 0.02f, 0.02f});
-        // mesh_matrix = glm::scale(mesh_matrix, {10.0f, 10.0f, 10.0f});
-        scene_shader.set_uniform("model_matrix", mesh_matrix);
-        for (auto& mesh : backpack.meshes)
+        // Draws the casters of every view of a light into the view's tile, either the static
+        // ones for the cache or the moving ones
+        auto draw_shadow_casters = [&](ShadowMap& map, const ShadowCasters& casters, bool cache)
         {
-            draw_model(mesh, scene_shader);
+            auto draw_instances =
+                [&](GLuint vao, std::size_t index_count, const Instances& instances)
+            {
+                if (instances.count > 0)
+                {
+                    glBindVertexArray(vao);
+                    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(index_count),
+                                            GL_UNSIGNED_INT, nullptr, bind_instances(instances));
+                }
+            };
+
+            // The billboards are single sided, and need to cast shadows from either side
+            glEnable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+            depth_shader.bind();
+            for (std::size_t view = 0; view < casters.views.size(); view++)
+            {
+                auto& view_casters = casters.views[view];
+                if (!view_casters.camera.valid())
+                {
+                    continue;
+                }
+                auto viewport = map.viewport(view);
+                glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+                stream_buffer.bind(GL_UNIFORM_BUFFER, 0, view_casters.camera);
+                if (cache)
+                {
+                    draw_instances(terrain_vertex_array.vao, terrain_mesh.indices.size(),
+                                   view_casters.terrain);
+                    draw_instances(box_vertex_array.vao, box_mesh.indices.size(),
+                                   view_casters.boxes);
+                    for (auto& mesh : backpack.meshes)
+                    {
+                        draw_instances(mesh.vertex_array.vao, mesh.indices.size(),
+                                       view_casters.models);
+                    }
+                }
+                else
+                {
+                    draw_instances(billboard_vertex_array.vao, billboard_mesh.indices.size(),
+                                   view_casters.billboards);
+                }
+            }
+            stream_buffer.bind(GL_UNIFORM_BUFFER, 0, camera_data);
+        };
+
+        // The cache pass only runs when the light has moved, the other pass copies the cache
+        // into the map and draws the moving casters over it
+        auto add_shadow_passes = [&](const char* pass, const char* cache_pass, ShadowMap& map,
+                                     const ShadowCasters& casters)
+        {
+            // The passes are named after the textures they write
+            auto shadow_map = render_graph.import_texture(pass, map.texture(), map.desc());
+            auto cache = render_graph.import_texture(cache_pass, map.cache_texture(), map.desc());
+            if (casters.redraw_cache)
+            {
+                render_graph.add_pass(
+                    cache_pass, [&](RenderGraph::Builder& builder) { builder.write(cache); },
+                    [&draw_shadow_casters, &map, &casters](const RenderGraph::Resources&)
+                    {
+                        glClear(GL_DEPTH_BUFFER_BIT);
+                        draw_shadow_casters(map, casters, true);
+                        if (casters.cache_complete)
+                        {
+                            map.validate_cache();
+                        }
+                    });
+            }
+            render_graph.add_pass(
+                pass,
+                [&](RenderGraph::Builder& builder)
+                {
+                    builder.read(cache);
+                    builder.write(shadow_map);
+                },
+                [&draw_shadow_casters, &map, &casters, cache,
+                 shadow_map](const RenderGraph::Resources& resources)
+                {
+                    auto& desc = map.desc();
+                    glCopyImageSubData(resources.texture(cache), GL_TEXTURE_2D, 0, 0, 0, 0,
+                                       resources.texture(shadow_map), GL_TEXTURE_2D, 0, 0, 0, 0,
+                                       desc.width, desc.height, 1);
+                    draw_shadow_casters(map, casters, false);
+                });
+            return shadow_map;
+        };
+
+        RenderResource spot_shadow;
+        RenderResource point_shadow;
+        if (settings.shadows)
+        {
+            spot_shadow = add_shadow_passes("Flashlight shadow", "Flashlight shadow cache",
+                                            spot_shadow_map, spot_casters);
+        }
+        if (shadow_light >= 0)
+        {
+            point_shadow = add_shadow_passes("Point light shadow", "Point light shadow cache",
+                                             point_shadow_map, point_casters);
         }
 
-        // Draw billboards
-        glBindTextureUnit(0, person_texture);
-        glBindTextureUnit(1, person_specular);
-        glBindVertexArray(billboard_vertex_array.vao);
-        for (auto& transform : people_transforms)
+        // Every cascade that changed is drawn in the one pass, the others keep what they had
+        RenderResource moonlight_shadow;
+        if (settings.shadows)
         {
+            moonlight_shadow = render_graph.import_texture(
+                "Moonlight shadow", moonlight_shadow_map.texture(), moonlight_shadow_map.desc());
+        }
+        if (moonlight_casters.redraw_any)
+        {
+            render_graph.add_pass(
+                "Moonlight shadow",
+                [&](RenderGraph::Builder& builder) { builder.write(moonlight_shadow); },
+                [&](const RenderGraph::Resources& resources)
+                {
+                    auto size = moonlight_shadow_map.desc().width;
+                    glViewport(0, 0, size, size);
+
+                    // A clear would clear every layer, so only the redrawn layers are cleared
+                    float clear_depth = 1.0f;
+                    auto cascades = moonlight_shadow_map.cascade_count();
+                    for (int cascade = 0; cascade < cascades; cascade++)
+                    {
+                        if (moonlight_casters.redraw[cascade])
+                        {
+                            glClearTexSubImage(resources.texture(moonlight_shadow), 0, 0, 0,
+                                               cascade, size, size, 1, GL_DEPTH_COMPONENT,
+                                               GL_FLOAT, &clear_depth);
+                        }
+                    }
+
+                    glEnable(GL_DEPTH_TEST);
+                    glDisable(GL_CULL_FACE);
+                    cascade_shadow_shader.bind();
+                    for (int cascade = 0; cascade < cascades; cascade++)
+                    {
+                        cascade_shadow_shader.set_uniform(
+                            "cascade_matrices[" + std::to_string(cascade) + "]",
+                            moonlight_shadow_map.view_projection(cascade));
+                    }
+
+                    auto draw_layered =
+                        [&](GLuint vao, std::size_t index_count, const LayeredInstances& layered)
+                    {
+                        if (layered.instances.count == 0)
+                        {
+                            return;
+                        }
+                        for (int i = 0; i < CascadedShadowMap::MAX_CASCADES - 1; i++)
+                        {
+                            cascade_shadow_shader.set_uniform(
+                                "cascade_ends[" + std::to_string(i) + "]", layered.ends[i]);
+                        }
+                        glBindVertexArray(vao);
+                        glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(index_count),
+                                                GL_UNSIGNED_INT, nullptr,
+                                                bind_instances(layered.instances));
+                    };
+                    draw_layered(terrain_vertex_array.vao, terrain_mesh.indices.size(),
+                                 moonlight_casters.terrain);
+                    draw_layered(box_vertex_array.vao, box_mesh.indices.size(),
+                                 moonlight_casters.boxes);
+                    for (auto& mesh : backpack.meshes)
+                    {
+                        draw_layered(mesh.vertex_array.vao, mesh.indices.size(),
+                                     moonlight_casters.models);
+                    }
+                    draw_layered(billboard_vertex_array.vao, billboard_mesh.indices.size(),
+                                 moonlight_casters.billboards);
+
+                    for (int cascade = 0; cascade < cascades; cascade++)
+                    {
+                        if (moonlight_casters.redraw[cascade] && moonlight_casters.complete)
+                        {
+                            moonlight_shadow_map.validate_cascade(cascade);
+                        }
+                    }
+                });
+        }
 
-            // Draw billboard
-            auto pi = static_cast<float>(std::numbers::pi);
-            auto xd = transform.position.x - camera_transform.position.x;
-            auto yd = transform.position.z - camera_transform.position.z;
+        auto read_shadow_maps = [&](RenderGraph::Builder& builder)
+        {
+            builder.read(spot_shadow);
+            builder.read(point_shadow);
+            builder.read(moonlight_shadow);
+        };
+        auto bind_shadow_maps = [&](const RenderGraph::Resources& resources)
+        {
+            if (spot_shadow.valid())
+            {
+                glBindTextureUnit(9, resources.texture(spot_shadow));
+            }
+            if (point_shadow.valid())
+            {
+                glBindTextureUnit(10, resources.texture(point_shadow));
+            }
+            if (moonlight_shadow.valid())
+            {
+                glBindTextureUnit(8, resources.texture(moonlight_shadow));
+            }
+        };
 
-            auto r = std::atan2(xd, yd) + pi;
+        // The pre-pass fills in the depth of the nearest surface of every pixel, so the scene
+        // pass only shades the fragments that end up visible. Only the forward path has one, the
+        // G-buffer pass is cheap enough to not need it
+        bool depth_prepass =
+            !settings.deferred && prepass_tuner.use_prepass(Profiler::current_frame());
+        RenderResource scene_depth;
+        if (depth_prepass)
+        {
+            render_graph.add_pass(
+                "Depth pre-pass",
+                [&](RenderGraph::Builder& builder)
+                { scene_depth = builder.create("Scene depth", depth_desc); },
+                [&](const RenderGraph::Resources&)
+                {
+                    glViewport(0, 0, render_width, render_height);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                    glEnable(GL_DEPTH_TEST);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_BACK);
+
+                    depth_shader.bind();
+                    draw_scene(SceneDraw::Depth, depth_shader);
+                    draw_lights(SceneDraw::Depth);
+                });
+        }
 
-            glm::mat4 billboard_mat{1.0f};
-            billboard_mat = glm::translate(billboard_mat, transform.position);
-            billboard_mat = glm::rotate(billboard_mat, r, {0, 1, 0});
+        RenderResource scene_colour;
+
+        // The G-buffer of the deferred path, the position comes from the depth so is not stored
+        RenderTargetDesc albedo_desc = colour_desc;
+        albedo_desc.format = GL_RGBA8;
+        RenderTargetDesc normal_desc = colour_desc;
+        normal_desc.format = GL_RG16;
+        RenderResource gbuffer_albedo;
+        RenderResource gbuffer_normal;
+        RenderResource lighting_depth;
+        if (settings.deferred)
+        {
+            render_graph.add_pass(
+                "G-buffer",
+                [&](RenderGraph::Builder& builder)
+                {
+                    gbuffer_albedo = builder.create("G-buffer albedo", albedo_desc);
+                    gbuffer_normal = builder.create("G-buffer normal", normal_desc);
+                    scene_depth = builder.create("Scene depth", depth_desc);
+                },
+                [&](const RenderGraph::Resources&)
+                {
+                    glViewport(0, 0, render_width, render_height);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    glEnable(GL_DEPTH_TEST);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_BACK);
+
+                    gbuffer_shader.bind();
+                    draw_scene(SceneDraw::GBuffer, gbuffer_shader);
+                });
+
+            // Each light only shades the pixels inside its volume. The volumes are tested
+            // against a copy of the scene depth, as the depth is also read by the shader
+            render_graph.add_pass(
+                "Deferred lighting",
+                [&](RenderGraph::Builder& builder)
+                {
+                    builder.read(gbuffer_albedo);
+                    builder.read(gbuffer_normal);
+                    builder.read(scene_depth);
+                    read_shadow_maps(builder);
+                    scene_colour = builder.create("Scene colour", colour_desc);
+                    lighting_depth = builder.create("Lighting depth", depth_desc);
+                },
+                [&](const RenderGraph::Resources& resources)
+                {
+                    glViewport(0, 0, render_width, render_height);
+                    glCopyImageSubData(resources.texture(scene_depth), GL_TEXTURE_2D, 0, 0, 0, 0,
+                                       resources.texture(lighting_depth), GL_TEXTURE_2D, 0, 0, 0,
+                                       0, render_width, render_height, 1);
+                    glClear(GL_COLOR_BUFFER_BIT);
+
+                    glBindTextureUnit(0, resources.texture(gbuffer_albedo));
+                    glBindTextureUnit(1, resources.texture(gbuffer_normal));
+                    glBindTextureUnit(2, resources.texture(scene_depth));
+                    bind_shadow_maps(resources);
+
+                    deferred_shader.bind();
+                    deferred_shader.set_uniform("inverse_view_projection",
+                                                glm::inverse(camera_projection * view_matrix));
+                    deferred_shader.set_uniform("viewport_size",
+                                                glm::vec2(render_width, render_height));
+
+                    // Every light adds to what is already there
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE);
+                    glDepthMask(GL_FALSE);
+
+                    // The directional light and the flashlight reach every pixel
+                    {
+                        PROFILE_GPU_ZONE("Screen lights");
+                        glDisable(GL_DEPTH_TEST);
+                        deferred_shader.set_uniform("volume_type", 0);
+                        glBindVertexArray(fbo_vbo);
+                        glDrawArrays(GL_TRIANGLES, 0, 3);
+                    }
+
+                    // The back faces of the volumes only pass where the surface is in front of
+                    // them, which is every pixel the volume covers whether or not the camera is
+                    // inside it. Clamping keeps the back faces past the far plane
+                    glEnable(GL_DEPTH_TEST);
+                    glEnable(GL_DEPTH_CLAMP);
+                    glDepthFunc(GL_GEQUAL);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_FRONT);
+
+                    auto point_count =
+                        light_data.valid() ? static_cast<GLsizei>(scene.lights.size()) : 0;
+                    auto spot_count =
+                        light_data.valid() ? static_cast<GLsizei>(scene.spot_lights.size()) : 0;
+                    {
+                        PROFILE_GPU_ZONE("Point light volumes");
+                        deferred_shader.set_uniform("volume_type", 1);
+                        deferred_shader.set_uniform("first_light", 0);
+                        glBindVertexArray(sphere_vertex_array.vao);
+                        glDrawElementsInstanced(GL_TRIANGLES, sphere_mesh.indices.size(),
+                                                GL_UNSIGNED_INT, nullptr, point_count);
+                    }
+                    {
+                        PROFILE_GPU_ZONE("Spot light volumes");
+                        deferred_shader.set_uniform("volume_type", 2);
+                        deferred_shader.set_uniform("first_light", point_count);
+                        glBindVertexArray(cone_vertex_array.vao);
+                        glDrawElementsInstanced(GL_TRIANGLES, cone_mesh.indices.size(),
+                                                GL_UNSIGNED_INT, nullptr, spot_count);
+                    }
+
+                    glDisable(GL_BLEND);
+                    glDisable(GL_DEPTH_CLAMP);
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                    glCullFace(GL_BACK);
+
+                    scene_shader.bind();
+                    draw_lights(SceneDraw::Forward);
+                });
+        }
+        else
+        {
+            render_graph.add_pass(
+                "Scene",
+                [&](RenderGraph::Builder& builder)
+                {
+                    scene_colour = builder.create("Scene colour", colour_desc);
+                    read_shadow_maps(builder);
+                    if (depth_prepass)
+                    {
+                        builder.write(scene_depth);
+                    }
+                    else
+                    {
+                        scene_depth = builder.create("Scene depth", depth_desc);
+                    }
+                },
+                [&](const RenderGraph::Resources& resources)
+                {
+                    glViewport(0, 0, render_width, render_height);
+                    glEnable(GL_DEPTH_TEST);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_BACK);
+                    bind_shadow_maps(resources);
+
+                    // After the pre-pass only fragments exactly at the stored depth pass the
+                    // test, and the depth is already final so is not written again
+                    if (depth_prepass)
+                    {
+                        glClear(GL_COLOR_BUFFER_BIT);
+                        glDepthFunc(GL_EQUAL);
+                        glDepthMask(GL_FALSE);
+                    }
+                    else
+                    {
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    }
+
+                    scene_shader.bind();
+                    scene_shader.set_uniform("cluster_viewport_size",
+                                             glm::vec2(render_width, render_height));
+                    draw_scene(SceneDraw::Forward, scene_shader);
+                    draw_lights(SceneDraw::Forward);
+
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                });
+        }
 
-            scene_shader.set_uniform("model_matrix", billboard_mat);
-            glDrawElements(GL_TRIANGLES, billboard_mesh.indices.size(), GL_UNSIGNED_INT,
-                           nullptr);
+        if (window)
+        {
+            render_graph.add_pass(
+                "FBO blit",
+                [&](RenderGraph::Builder& builder)
+                {
+                    builder.read(scene_colour);
+                    builder.write(backbuffer);
+                },
+                [&](const RenderGraph::Resources& resources)
+                {
+                    glViewport(0, 0, width, height);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                    // Bind the FBOs texture which will texture the screen quad
+                    glBindTextureUnit(0, resources.texture(scene_colour));
+                    glBindVertexArray(fbo_vbo);
+                    fbo_shader.bind();
+
+                    glm::vec2 target_size(colour_desc.width, colour_desc.height);
+                    glm::vec2 rendered_size(render_width, render_height);
+                    fbo_shader.set_uniform("uv_scale", rendered_size / target_size);
+                    fbo_shader.set_uniform("uv_max", (rendered_size - 0.5f) / target_size);
+
+                    // Render
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                });
+
+            render_graph.add_pass(
+                "ImGui",
+                [&](RenderGraph::Builder& builder)
+                {
+                    builder.write(backbuffer);
+                    builder.side_effect();
+                },
+                [&](const RenderGraph::Resources&)
+                {
+                    // ImGui::ShowDemoWindow();
+                    GUI::debug_window(camera_transform.position, camera_transform.rotation,
+                                      settings);
+                    GUI::stream_buffer_stats(stream_buffer.stats());
+                    GUI::light_cluster_stats(light_clusters.stats());
+                    GUI::shadow_map_stats(spot_shadow_map.stats(), point_shadow_map.stats());
+                    GUI::cascade_shadow_stats(moonlight_shadow_map.stats());
+                    GUI::render_scale_settings(render_scale, render_width, render_height);
+                    GUI::depth_prepass_settings(prepass_tuner, depth_prepass);
+                    GUI::render_target_stats(render_targets.stats());
+                    GUI::texture_streaming_settings(texture_arrays.stats(), upload_ring.stats(),
+                                                    texture_budget);
+                    GUI::render_graph_stats(render_graph);
+                    GUI::profiler_stats();
+                    GUI::gl_stats();
+
+                    GUI::render();
+                });
+        }
+        else
+        {
+            // Nothing reads the scene in headless mode, so it has to be kept to not be culled
+            render_graph.export_texture(scene_colour);
         }
 
-        // Set the light trasform and render
-        scene_shader.set_uniform("is_light", true);
-        scene_shader.set_uniform("model_matrix", light_mat);
-        glBindVertexArray(light_vertex_array.vao);
-        glDrawElements(GL_TRIANGLES, light_mesh.indices.size(), GL_UNSIGNED_INT, nullptr);
+        // ---------------------------
+        // ==== Render the passes ====
+        // ---------------------------
+        if (render_graph.compile())
+        {
+            render_graph.execute(render_targets);
+        }
+        final_colour = render_graph.texture(scene_colour);
 
-        // --------------------------
-        // ==== Render to window ====
-        // --------------------------
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Everything that reads this frame's streamed data and targets has been submitted
+        stream_buffer.end_frame();
+        render_targets.end_frame();
+        GLCapture::end_frame();
+        if (window)
+        {
+            PROFILE_ZONE("Present");
+            window->display();
+        }
+        else
+        {
+            // Nothing throttles the headless loop, so wait for the GPU to make the frame time
+            // cover the whole frame rather than just the time taken to submit it
+            PROFILE_ZONE("Present");
+            glFinish();
+            frame_times.push_back(frame_clock.restart().asSeconds() * 1000.0f);
+        }
+        Profiler::end_frame();
 
-        // Bind the FBOs texture which will texture the screen quad
-        glBindTextureUnit(0, fbo_texture);
-        glBindVertexArray(fbo_vbo);
-        fbo_shader.bind();
+        // Pick the render scale of the next frame. Vsync pins the windowed frame time to the
+        // refresh rate, so that goes by the GPU time of the most recent frame the profiler has
+        // resolved instead
+        if (window)
+        {
+            auto& history = Profiler::history();
+            auto itr = std::find_if(history.rbegin(), history.rend(),
+                                    [](const ProfilerFrame& frame) { return frame.gpu_resolved; });
+            if (itr != history.rend() && itr->frame != last_governed_frame)
+            {
+                last_governed_frame = itr->frame;
+                render_scale.update(itr->gpu_ms);
+            }
+        }
+        else
+        {
+            render_scale.update(frame_times.back());
+        }
 
-        // Render
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // Give the pre-pass tuner the scene GPU time of every frame resolved since the last
+        for (auto& frame : Profiler::history())
+        {
+            if (frame.gpu_resolved && frame.frame > last_prepass_sample)
+            {
+                last_prepass_sample = frame.frame;
+                prepass_tuner.add_sample(frame.frame, frame.zone_ms("Depth pre-pass", true) +
+                                                          frame.zone_ms("Scene", true));
+            }
+        }
+    }
 
-        // --------------------------
-        // ==== End Frame ====
-        // --------------------------
-        // ImGui::ShowDemoWindow();
-        GUI::debug_window(camera_transform.position, camera_transform.rotation, settings);
+    // Writes the capture if the loop ended before all of its frames were captured
+    GLCapture::stop();
 
-        GUI::render();
-        window.display();
+    // ---------------------------------
+    // ==== Write benchmark results ====
+    // ---------------------------------
+    if (options.headless)
+    {
+        write_frame_stats(options.stats_path, frame_times);
+        if (!options.image_path.empty())
+        {
+            save_texture_to_image(final_colour, render_width, render_height,
+                                  options.image_path);
+        }
+        if (options.gl_stats)
+        {
+            auto& calls = GLStats::last_frame().total;
+            std::cout << "GL calls in the last frame:\n";
+            for (std::size_t i = 0; i < GLCallCounters::TYPES; i++)
+            {
+                auto type = static_cast<GLCallType>(i);
+                std::cout << "  " << to_string(type) << ": " << calls.count(type) << " ("
+                          << calls.redundant_count(type) << " redundant)\n";
+            }
+        }
+    }
+    if (!options.trace_path.empty() || !options.graph_path.empty())
+    {
+        Profiler::flush_gpu();
+    }
+    if (!options.trace_path.empty())
+    {
+        Profiler::export_chrome_trace(options.trace_path);
+    }
+    if (!options.graph_path.empty())
+    {
+        render_graph.write_graphviz(options.graph_path);
     }
 
     // --------------------------
     // ==== Graceful Cleanup ====
     // --------------------------
-    GUI::shutdown();
+    simulation.stop();
+    Profiler::shutdown();
+    GLStats::set_enabled(false);
+    if (window)
+    {
+        GUI::shutdown();
+    }
 
     // Delete all vertex arrays
     auto cleanup_vertex_array = [](VertexArray& vertex_array)
@@ -676,26 +1858,15 @@ int main()
         glDeleteVertexArrays(1, &vertex_array.vao);
     };
     cleanup_vertex_array(billboard_vertex_array);
+    glDeleteBuffers(1, &billboard_sprite_buffer);
     cleanup_vertex_array(terrain_vertex_array);
     cleanup_vertex_array(light_vertex_array);
     cleanup_vertex_array(box_vertex_array);
+    cleanup_vertex_array(sphere_vertex_array);
+    cleanup_vertex_array(cone_vertex_array);
 
     for (auto& mesh : backpack.meshes)
     {
         cleanup_vertex_array(mesh.vertex_array);
     }
-
-    // Delete all textures
-    glDeleteTextures(1, &person_texture);
-    glDeleteTextures(1, &person_specular);
-
-    glDeleteTextures(1, &crate_texture);
-    glDeleteTextures(1, &crate_specular_texture);
-
-    glDeleteTextures(1, &grass_texture);
-    glDeleteTextures(1, &grass_specular);
-
-    // Delete all framebuffers...
-    glDeleteFramebuffers(1, &fbo);
-    glDeleteFramebuffers(1, &fbo_texture);
 }
\ No newline at end of file